@@ -0,0 +1,82 @@
+#include "Arena.h"
+#include <algorithm>
+
+namespace
+{
+    // 領域が足りないときの確保先（確保した量を数える）
+    class CountingResource : public std::pmr::memory_resource
+    {
+    public:
+        size_t Bytes = 0;
+
+    private:
+        void *do_allocate(const size_t bytes, const size_t alignment) override
+        {
+            Bytes += bytes;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+        void do_deallocate(void *p, const size_t bytes, const size_t alignment) override
+        {
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+        {
+            return this == &other;
+        }
+    };
+}
+
+struct GenerationArena::State
+{
+    explicit State(const size_t capacity)
+        : Buffer(new std::byte[capacity]),
+          Resource(Buffer.get(), capacity, &Upstream)
+    {
+    }
+
+    std::unique_ptr<std::byte[]> Buffer;
+    CountingResource Upstream;
+    // Buffer と Upstream を参照するので最後に構築する
+    std::pmr::monotonic_buffer_resource Resource;
+};
+
+GenerationArena::GenerationArena(const size_t capacity) : capacity(std::max<size_t>(capacity, 1024)) {}
+
+GenerationArena::GenerationArena(const GenerationArena &other) : capacity(other.capacity) {}
+
+GenerationArena &GenerationArena::operator=(const GenerationArena &other)
+{
+    if (this != &other && capacity != other.capacity)
+    {
+        capacity = other.capacity;
+        state.reset();
+    }
+    return *this;
+}
+
+GenerationArena::GenerationArena(GenerationArena &&other) noexcept = default;
+GenerationArena &GenerationArena::operator=(GenerationArena &&other) noexcept = default;
+GenerationArena::~GenerationArena() = default;
+
+std::pmr::memory_resource *GenerationArena::Resource()
+{
+    if (!state)
+        state = std::make_unique<State>(capacity);
+    return &state->Resource;
+}
+
+void GenerationArena::Reset()
+{
+    if (!state)
+        return;
+    if (state->Upstream.Bytes == 0)
+    {
+        // 最初の領域に収まった（確保し直さない）
+        state->Resource.release();
+        return;
+    }
+    // 追加で確保した分を合わせた大きさで作り直す
+    capacity += state->Upstream.Bytes;
+    state.reset();
+    state = std::make_unique<State>(capacity);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+/**
+ * @brief 世代ごとに使い捨てる一時領域（std::pmr のメモリリソース）
+ *
+ * @note 段階の中だけで使う一時的なコンテナ（std::pmr::vector, std::pmr::map など）の確保先にする。解放は何もせず、Reset でまとめて捨てる。
+ * @note 領域が足りずに追加で確保した分は、次の Reset で1つの領域にまとめ直す。同じ規模の世代が続けば、確保は最初の数世代だけになる。
+ * @note スレッドセーフではない（持ち主の LanguageSystem を処理するスレッドだけが使う）。
+ */
+class GenerationArena
+{
+public:
+    /**
+     * @brief 一時領域を作る（領域は最初に Resource を呼んだときに確保する）
+     *
+     * @param capacity 最初の領域の大きさ（バイト）
+     */
+    explicit GenerationArena(size_t capacity = 64 * 1024);
+
+    // 複製は中身を共有せず、同じ大きさの空の領域を持つ（分岐した言語系は別のスレッドで進めるため）
+    GenerationArena(const GenerationArena &other);
+    GenerationArena &operator=(const GenerationArena &other);
+    GenerationArena(GenerationArena &&other) noexcept;
+    GenerationArena &operator=(GenerationArena &&other) noexcept;
+    ~GenerationArena();
+
+    /**
+     * @brief 確保先のメモリリソース
+     *
+     * @return Reset まで有効なメモリリソース
+     */
+    std::pmr::memory_resource *Resource();
+
+    /**
+     * @brief 確保した領域をすべて捨てる（この領域から確保したコンテナはすべて破棄済みであること）
+     *
+     */
+    void Reset();
+
+    /**
+     * @brief 今の領域の大きさ
+     *
+     * @return バイト数
+     */
+    size_t Capacity() const { return capacity; }
+
+private:
+    struct State;
+
+    size_t capacity;
+    std::unique_ptr<State> state;
+};
@@ -0,0 +1,263 @@
+#include "Binary.h"
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // 書き込んだ内容をディスクまで書き出す（fclose の前に呼ぶ）
+    bool syncFile(std::FILE *file)
+    {
+        if (std::fflush(file) != 0)
+            return false;
+#ifdef _WIN32
+        return FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(file)))) != 0;
+#else
+        return ::fsync(::fileno(file)) == 0;
+#endif
+    }
+
+    // 一時ファイルでファイルを置き換え、置き換えたこと自体もディスクまで書き出す
+    bool replaceFile(const std::string &temporary, const std::string &filename)
+    {
+#ifdef _WIN32
+        // MOVEFILE_WRITE_THROUGH は置き換えがディスクに書き出されるまで戻らない
+        return MoveFileExA(temporary.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+        if (std::rename(temporary.c_str(), filename.c_str()) != 0)
+            return false;
+        // ディレクトリの項目を書き出さないと、電源断の後に置き換え前へ戻ることがある
+        auto directory = std::filesystem::path(filename).parent_path();
+        if (directory.empty())
+            directory = ".";
+        const int fd = ::open(directory.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        const bool synced = ::fsync(fd) == 0;
+        ::close(fd);
+        return synced;
+#endif
+    }
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        Close();
+        std::swap(data, other.data);
+        std::swap(size, other.size);
+        std::swap(opened, other.opened);
+#ifdef _WIN32
+        std::swap(fileHandle, other.fileHandle);
+        std::swap(mappingHandle, other.mappingHandle);
+#endif
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const std::string &filename)
+{
+    Close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize))
+    {
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    size = (size_t)fileSize.QuadPart;
+    opened = true;
+    if (size == 0)
+        return true;
+    mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle == nullptr)
+    {
+        Close();
+        return false;
+    }
+    data = static_cast<const char *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (data == nullptr)
+    {
+        Close();
+        return false;
+    }
+    return true;
+#else
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    size = (size_t)st.st_size;
+    opened = true;
+    if (size > 0)
+    {
+        void *mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            ::close(fd);
+            opened = false;
+            size = 0;
+            return false;
+        }
+        data = static_cast<const char *>(mapped);
+    }
+    // マップ後はファイル記述子を閉じてよい
+    ::close(fd);
+    return true;
+#endif
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+    if (data != nullptr)
+        UnmapViewOfFile(data);
+    if (mappingHandle != nullptr)
+        CloseHandle(mappingHandle);
+    if (fileHandle != nullptr)
+        CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    if (data != nullptr)
+        ::munmap(const_cast<char *>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+    opened = false;
+}
+
+uint32_t BinaryStringTable::Add(const std::string &str)
+{
+    auto it = indices.find(str);
+    if (it != indices.end())
+    {
+        return it->second;
+    }
+    const uint32_t index = (uint32_t)indices.size();
+    indices.emplace(str, index);
+    chars += str;
+    offsetTable.push_back((uint32_t)chars.size());
+    return index;
+}
+
+void BinaryStringTable::Write(BinaryWriter &writer, BinaryBlock &offsets, BinaryBlock &charBlock) const
+{
+    offsets = writer.WriteBlock(offsetTable);
+    charBlock = writer.WriteBlock(chars.data(), chars.size());
+}
+
+BinaryStringView::BinaryStringView(const BinaryReader &reader, const BinaryBlock &offsets, const BinaryBlock &chars)
+    : Offsets(reader.Block<uint32_t>(offsets)), Chars(reader.Block<char>(chars))
+{
+}
+
+std::string_view BinaryStringView::Get(const uint32_t index) const
+{
+    if ((size_t)index + 1 >= Offsets.size())
+    {
+        return {};
+    }
+    const uint32_t begin = Offsets[index];
+    const uint32_t end = Offsets[index + 1];
+    if (begin > end || end > Chars.size())
+    {
+        return {};
+    }
+    return {Chars.data() + begin, end - begin};
+}
+
+void writeBinaryTable(BinaryWriter &writer, BinaryStringTable &strings, const std::vector<std::vector<std::string>> &table, BinaryBlock &rows, BinaryBlock &cells)
+{
+    std::vector<uint32_t> rowOffsets = {0};
+    std::vector<uint32_t> cellIndices;
+    for (const auto &row : table)
+    {
+        for (const auto &cell : row)
+        {
+            cellIndices.push_back(strings.Add(cell));
+        }
+        rowOffsets.push_back((uint32_t)cellIndices.size());
+    }
+    rows = writer.WriteBlock(rowOffsets);
+    cells = writer.WriteBlock(cellIndices);
+}
+
+bool readBinaryTable(const BinaryReader &reader, const BinaryStringView &strings, const BinaryBlock &rowBlock, const BinaryBlock &cellBlock, std::vector<std::vector<std::string>> &table)
+{
+    const auto rows = reader.Block<uint32_t>(rowBlock);
+    const auto cells = reader.Block<uint32_t>(cellBlock);
+    table.clear();
+    for (size_t r = 0; r + 1 < rows.size(); ++r)
+    {
+        if (rows[r] > rows[r + 1] || rows[r + 1] > cells.size())
+            return false;
+        std::vector<std::string> row;
+        row.reserve(rows[r + 1] - rows[r]);
+        for (uint32_t c = rows[r]; c < rows[r + 1]; ++c)
+        {
+            row.emplace_back(strings.Get(cells[c]));
+        }
+        table.push_back(std::move(row));
+    }
+    return true;
+}
+
+bool writeBinaryFile(const std::string &filename, const char *data, const size_t size)
+{
+    const std::string temporary = filename + ".tmp";
+    std::FILE *file = std::fopen(temporary.c_str(), "wb");
+    if (file == nullptr)
+    {
+        std::cerr << "Error: ファイルを開けませんでした: " << temporary << std::endl;
+        return false;
+    }
+    const bool written = (size == 0 || std::fwrite(data, 1, size, file) == size) && syncFile(file);
+    const bool closed = std::fclose(file) == 0;
+    if (!written || !closed)
+    {
+        std::cerr << "Error: ファイルを書き込めませんでした: " << temporary << std::endl;
+        std::remove(temporary.c_str());
+        return false;
+    }
+
+    if (!replaceFile(temporary, filename))
+    {
+        std::cerr << "Error: ファイルを置き換えられませんでした: " << filename << std::endl;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
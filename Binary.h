@@ -0,0 +1,296 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief バイナリファイル内のブロック（配列）の位置
+ *
+ */
+struct BinaryBlock
+{
+    // 先頭からのバイト位置（8バイト境界）
+    uint64_t Offset = 0;
+    // 要素数
+    uint64_t Count = 0;
+};
+
+/**
+ * @brief 読み込み専用のメモリマップトファイル
+ *
+ */
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    ~MappedFile();
+
+    /**
+     * @brief ファイルをマップする
+     *
+     * @param filename ファイルパス
+     * @return 成功したら true
+     */
+    bool Open(const std::string &filename);
+
+    /**
+     * @brief マップを解除する
+     *
+     */
+    void Close();
+
+    const char *Data() const { return data; }
+    size_t Size() const { return size; }
+    bool IsOpen() const { return opened; }
+
+private:
+    const char *data = nullptr;
+    size_t size = 0;
+    bool opened = false;
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+};
+
+/**
+ * @brief 8バイト境界に揃えたブロックを追記していくバッファ
+ *
+ */
+class BinaryWriter
+{
+public:
+    std::vector<char> Buffer;
+
+    /**
+     * @brief 値をそのまま追記する（位置合わせなし）
+     *
+     * @return 書き込んだバイト位置
+     */
+    template <typename T>
+    size_t Write(const T &value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const size_t offset = Buffer.size();
+        Buffer.resize(offset + sizeof(T));
+        std::memcpy(Buffer.data() + offset, &value, sizeof(T));
+        return offset;
+    }
+
+    /**
+     * @brief 配列をブロックとして追記する
+     *
+     * @return ブロック位置
+     */
+    template <typename T>
+    BinaryBlock WriteBlock(const T *values, const size_t count)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        Align();
+        BinaryBlock block{Buffer.size(), count};
+        if (count > 0)
+        {
+            Buffer.resize(Buffer.size() + sizeof(T) * count);
+            std::memcpy(Buffer.data() + block.Offset, values, sizeof(T) * count);
+        }
+        return block;
+    }
+
+    template <typename T>
+    BinaryBlock WriteBlock(const std::vector<T> &values)
+    {
+        return WriteBlock(values.data(), values.size());
+    }
+
+    /**
+     * @brief 書き込み済みの値を上書きする
+     *
+     * @param offset バイト位置
+     * @param value 値
+     */
+    template <typename T>
+    void Overwrite(const size_t offset, const T &value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        std::memcpy(Buffer.data() + offset, &value, sizeof(T));
+    }
+
+    /**
+     * @brief 8バイト境界まで0で埋める
+     *
+     */
+    void Align()
+    {
+        Buffer.resize((Buffer.size() + 7) & ~size_t(7), 0);
+    }
+};
+
+/**
+ * @brief 文字列表（重複を除いて番号を振る）
+ *
+ * @note 書き出すと uint32 のオフセット表（要素数 + 1）と文字列本体の2ブロックになる。
+ */
+class BinaryStringTable
+{
+public:
+    /**
+     * @brief 文字列を登録する
+     *
+     * @return 文字列番号
+     */
+    uint32_t Add(const std::string &str);
+
+    /**
+     * @brief 書き出す
+     *
+     * @param writer 書き込み先
+     * @param offsets オフセット表のブロック
+     * @param chars 文字列本体のブロック
+     */
+    void Write(BinaryWriter &writer, BinaryBlock &offsets, BinaryBlock &chars) const;
+
+private:
+    std::unordered_map<std::string, uint32_t> indices;
+    std::vector<uint32_t> offsetTable = {0};
+    std::string chars;
+};
+
+/**
+ * @brief バイナリ領域からブロックを読み出す
+ *
+ * @note 範囲外や位置ずれのあるブロックは空として扱う。
+ */
+class BinaryReader
+{
+public:
+    BinaryReader() = default;
+    BinaryReader(const char *data, const size_t size) : data(data), size(size) {}
+
+    /**
+     * @brief 先頭から値を読む
+     *
+     * @param offset バイト位置
+     * @param value 読み込み先
+     * @return 範囲内なら true
+     */
+    template <typename T>
+    bool Read(const size_t offset, T &value) const
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (offset > size || size - offset < sizeof(T))
+            return false;
+        std::memcpy(&value, data + offset, sizeof(T));
+        return true;
+    }
+
+    /**
+     * @brief ブロックを配列として参照する（コピーなし）
+     *
+     */
+    template <typename T>
+    std::span<const T> Block(const BinaryBlock &block) const
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (block.Count == 0 || block.Offset % alignof(T) != 0 || block.Offset > size ||
+            (size - block.Offset) / sizeof(T) < block.Count)
+        {
+            return {};
+        }
+        return {reinterpret_cast<const T *>(data + block.Offset), (size_t)block.Count};
+    }
+
+    /**
+     * @brief ブロックが範囲内にあるか
+     *
+     */
+    template <typename T>
+    bool IsValid(const BinaryBlock &block) const
+    {
+        return block.Count == 0 || Block<T>(block).size() == block.Count;
+    }
+
+    const char *Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    const char *data = nullptr;
+    size_t size = 0;
+};
+
+/**
+ * @brief 文字列表の読み出し
+ *
+ */
+struct BinaryStringView
+{
+    std::span<const uint32_t> Offsets;
+    std::span<const char> Chars;
+
+    BinaryStringView() = default;
+    BinaryStringView(const BinaryReader &reader, const BinaryBlock &offsets, const BinaryBlock &chars);
+
+    /**
+     * @brief 文字列を取得
+     *
+     * @param index 文字列番号
+     * @return 文字列（範囲外なら空）
+     */
+    std::string_view Get(const uint32_t index) const;
+
+    size_t Size() const { return Offsets.empty() ? 0 : Offsets.size() - 1; }
+};
+
+/**
+ * @brief 範囲 [begin, begin + count) が size 以内か
+ *
+ */
+inline bool isInBinaryRange(const uint64_t begin, const uint64_t count, const size_t size)
+{
+    return begin <= size && count <= size - begin;
+}
+
+/**
+ * @brief 2次元の文字列表を書き出す
+ *
+ * @param writer 書き込み先
+ * @param strings 文字列表
+ * @param table 2次元の文字列表
+ * @param rows 行ごとのセル開始位置のブロック
+ * @param cells セルの文字列番号のブロック
+ */
+void writeBinaryTable(BinaryWriter &writer, BinaryStringTable &strings, const std::vector<std::vector<std::string>> &table, BinaryBlock &rows, BinaryBlock &cells);
+
+/**
+ * @brief 2次元の文字列表を読み込む
+ *
+ * @param reader 読み込み元
+ * @param strings 文字列表
+ * @param rows 行ごとのセル開始位置のブロック
+ * @param cells セルの文字列番号のブロック
+ * @param table 読み込み先
+ * @return 壊れていなければ true
+ */
+bool readBinaryTable(const BinaryReader &reader, const BinaryStringView &strings, const BinaryBlock &rows, const BinaryBlock &cells, std::vector<std::vector<std::string>> &table);
+
+/**
+ * @brief バッファをファイルに書き出す
+ *
+ * @param filename ファイルパス
+ * @param data データ
+ * @param size バイト数
+ * @return 成功したら true
+ *
+ * @note 一時ファイルに書いてから置き換えるため、途中で中断しても既存のファイルは壊れない。
+ * @note 置き換える前に中身を、置き換えた後にディレクトリをディスクまで書き出す（クラッシュや電源断の後に空や途中のファイルが残らない）。
+ */
+bool writeBinaryFile(const std::string &filename, const char *data, const size_t size);
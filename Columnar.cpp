@@ -0,0 +1,251 @@
+#include "Columnar.h"
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
+
+namespace
+{
+    constexpr char COLUMNAR_MAGIC[8] = {'T', 'P', 'C', 'O', 'L', 'S', '\0', '\0'};
+    constexpr uint32_t COLUMNAR_VERSION = 1;
+
+    // ヘッダー（ファイル先頭）
+    struct ColumnarHeader
+    {
+        char Magic[8];
+        uint32_t Version;
+        int32_t Section;
+        // 文字列表
+        BinaryBlock StringOffsets;
+        BinaryBlock StringChars;
+        // 音素表
+        BinaryBlock PhoneticsRows;
+        BinaryBlock PhoneticsCells;
+        // 場所（場所名の文字列番号）
+        BinaryBlock Places;
+        // 言語ごとの場所ID・影響度・単語の始まりの位置（言語数 + 1、先頭は祖語の単語の数）
+        BinaryBlock LanguagePlaces;
+        BinaryBlock LanguageStrengths;
+        BinaryBlock LanguageWordOffsets;
+        // 単語（祖語、言語の順）
+        BinaryBlock WordIDs;
+        BinaryBlock WordProtoIDs;
+        BinaryBlock WordSoundOffsets;
+        BinaryBlock Sounds;
+        BinaryBlock WordMeaningOffsets;
+        BinaryBlock MeaningKeys;
+        BinaryBlock MeaningWeights;
+    };
+
+    // 音素列を文字列表の鍵にする
+    std::string soundsKey(const std::vector<Phonetics> &sounds)
+    {
+        return std::string(reinterpret_cast<const char *>(sounds.data()), sounds.size() * sizeof(Phonetics));
+    }
+
+    // 単語の列を作るための作業領域
+    struct WordColumns
+    {
+        std::vector<int32_t> IDs;
+        std::vector<int32_t> ProtoIDs;
+        std::vector<uint64_t> SoundOffsets = {0};
+        std::vector<Phonetics> Sounds;
+        std::vector<uint64_t> MeaningOffsets = {0};
+        std::vector<uint32_t> MeaningKeys;
+        std::vector<double> MeaningWeights;
+
+        void Add(BinaryStringTable &strings, const std::unordered_map<std::string, int32_t> &protoIDs, const Language &language)
+        {
+            for (const auto &[id, word] : language.Words)
+            {
+                IDs.push_back(id);
+                auto it = protoIDs.find(soundsKey(word.NearestProtoWord));
+                ProtoIDs.push_back(it == protoIDs.end() ? -1 : it->second);
+                Sounds.insert(Sounds.end(), word.Sounds.begin(), word.Sounds.end());
+                SoundOffsets.push_back(Sounds.size());
+                for (const auto &[key, value] : word.Meanings)
+                {
+                    MeaningKeys.push_back(strings.Add(key));
+                    MeaningWeights.push_back(value);
+                }
+                MeaningOffsets.push_back(MeaningKeys.size());
+            }
+        }
+    };
+
+    // オフセットの列が単調に増え、最後が要素数になっているか
+    bool isValidOffsets(std::span<const uint64_t> offsets, const size_t count)
+    {
+        if (offsets.empty() || offsets.front() != 0 || offsets.back() != count)
+            return false;
+        for (size_t i = 1; i < offsets.size(); ++i)
+        {
+            if (offsets[i] < offsets[i - 1])
+                return false;
+        }
+        return true;
+    }
+}
+
+bool LanguageSystem::ExportColumnar(const std::string &filename) const
+{
+    BinaryWriter writer;
+    BinaryStringTable strings;
+    ColumnarHeader header{};
+    std::memcpy(header.Magic, COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC));
+    header.Version = COLUMNAR_VERSION;
+    header.Section = Section;
+    writer.Write(header);
+
+    // 1. 音素表と場所
+    writeBinaryTable(writer, strings, PhoneticsMap, header.PhoneticsRows, header.PhoneticsCells);
+    std::vector<uint32_t> places;
+    places.reserve(Graph.Places.size());
+    for (const auto &place : Graph.Places)
+    {
+        places.push_back(strings.Add(place));
+    }
+    header.Places = writer.WriteBlock(places);
+
+    // 2. 言語
+    std::vector<uint32_t> languagePlaces;
+    std::vector<double> languageStrengths;
+    std::vector<uint64_t> languageWordOffsets;
+    languagePlaces.reserve(LanguageMap.size());
+    languageStrengths.reserve(LanguageMap.size());
+    languageWordOffsets.reserve(LanguageMap.size() + 1);
+
+    // 3. 単語（音素列が同じ祖語の単語は、ID の小さい方に対応付ける）
+    std::unordered_map<std::string, int32_t> protoIDs;
+    for (const auto &[id, word] : ProtoLanguage.Words)
+    {
+        protoIDs.emplace(soundsKey(word.Sounds), id);
+    }
+    WordColumns words;
+    words.Add(strings, protoIDs, ProtoLanguage);
+    languageWordOffsets.push_back(words.IDs.size());
+    for (const auto &[place, language] : LanguageMap)
+    {
+        languagePlaces.push_back((uint32_t)Graph.FindPlace(place));
+        languageStrengths.push_back(language.Strength);
+        words.Add(strings, protoIDs, language);
+        languageWordOffsets.push_back(words.IDs.size());
+    }
+    header.LanguagePlaces = writer.WriteBlock(languagePlaces);
+    header.LanguageStrengths = writer.WriteBlock(languageStrengths);
+    header.LanguageWordOffsets = writer.WriteBlock(languageWordOffsets);
+    header.WordIDs = writer.WriteBlock(words.IDs);
+    header.WordProtoIDs = writer.WriteBlock(words.ProtoIDs);
+    header.WordSoundOffsets = writer.WriteBlock(words.SoundOffsets);
+    header.Sounds = writer.WriteBlock(words.Sounds);
+    header.WordMeaningOffsets = writer.WriteBlock(words.MeaningOffsets);
+    header.MeaningKeys = writer.WriteBlock(words.MeaningKeys);
+    header.MeaningWeights = writer.WriteBlock(words.MeaningWeights);
+
+    // 4. 文字列表（最後にまとめて書く）
+    strings.Write(writer, header.StringOffsets, header.StringChars);
+    writer.Align();
+    writer.Overwrite(0, header);
+    return writeBinaryFile(filename, writer.Buffer.data(), writer.Buffer.size());
+}
+
+bool ColumnarResult::Open(const std::string &filename)
+{
+    if (!file.Open(filename))
+    {
+        std::cerr << "Error: ファイルを開けませんでした: " << filename << std::endl;
+        return false;
+    }
+    BinaryReader reader(file.Data(), file.Size());
+    ColumnarHeader header;
+    if (!reader.Read(0, header) || std::memcmp(header.Magic, COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC)) != 0)
+    {
+        std::cerr << "Error: 列形式の結果ファイルではありません: " << filename << std::endl;
+        file.Close();
+        return false;
+    }
+    if (header.Version != COLUMNAR_VERSION)
+    {
+        std::cerr << "Error: 未対応の結果ファイルのバージョンです: " << header.Version << std::endl;
+        file.Close();
+        return false;
+    }
+
+    strings = BinaryStringView(reader, header.StringOffsets, header.StringChars);
+    places = reader.Block<uint32_t>(header.Places);
+    languagePlaces = reader.Block<uint32_t>(header.LanguagePlaces);
+    languageStrengths = reader.Block<double>(header.LanguageStrengths);
+    languageWordOffsets = reader.Block<uint64_t>(header.LanguageWordOffsets);
+    wordIDs = reader.Block<int32_t>(header.WordIDs);
+    wordProtoIDs = reader.Block<int32_t>(header.WordProtoIDs);
+    wordSoundOffsets = reader.Block<uint64_t>(header.WordSoundOffsets);
+    sounds = reader.Block<Phonetics>(header.Sounds);
+    wordMeaningOffsets = reader.Block<uint64_t>(header.WordMeaningOffsets);
+    meaningKeys = reader.Block<uint32_t>(header.MeaningKeys);
+    meaningWeights = reader.Block<double>(header.MeaningWeights);
+
+    const size_t wordCount = wordIDs.size();
+    bool isValid = strings.Size() + 1 == header.StringOffsets.Count &&
+                   reader.IsValid<char>(header.StringChars) &&
+                   places.size() == header.Places.Count &&
+                   languagePlaces.size() == header.LanguagePlaces.Count &&
+                   languageStrengths.size() == languagePlaces.size() &&
+                   languageWordOffsets.size() == languagePlaces.size() + 1 &&
+                   wordIDs.size() == header.WordIDs.Count &&
+                   wordProtoIDs.size() == wordCount &&
+                   sounds.size() == header.Sounds.Count &&
+                   meaningKeys.size() == header.MeaningKeys.Count &&
+                   meaningWeights.size() == meaningKeys.size() &&
+                   wordSoundOffsets.size() == wordCount + 1 &&
+                   wordMeaningOffsets.size() == wordCount + 1 &&
+                   isValidOffsets(wordSoundOffsets, sounds.size()) &&
+                   isValidOffsets(wordMeaningOffsets, meaningKeys.size()) &&
+                   languageWordOffsets.back() == wordCount &&
+                   readBinaryTable(reader, strings, header.PhoneticsRows, header.PhoneticsCells, PhoneticsMap);
+    for (size_t i = 0; isValid && i < languagePlaces.size(); ++i)
+    {
+        isValid = languagePlaces[i] < places.size() && languageWordOffsets[i] <= languageWordOffsets[i + 1];
+    }
+    // 文字列番号は文字列表の中を指す
+    const size_t stringCount = strings.Size();
+    isValid = isValid &&
+              std::all_of(places.begin(), places.end(), [&](const uint32_t index)
+                          { return index < stringCount; }) &&
+              std::all_of(meaningKeys.begin(), meaningKeys.end(), [&](const uint32_t index)
+                          { return index < stringCount; });
+    if (!isValid)
+    {
+        std::cerr << "Error: 結果ファイルが壊れています: " << filename << std::endl;
+        file.Close();
+        return false;
+    }
+    Section = header.Section;
+    return true;
+}
+
+ColumnarWords ColumnarResult::ProtoWords() const
+{
+    return words(0, languageWordOffsets.front());
+}
+
+ColumnarWords ColumnarResult::LanguageWords(const size_t language) const
+{
+    return words(languageWordOffsets[language], languageWordOffsets[language + 1]);
+}
+
+ColumnarWords ColumnarResult::Words() const
+{
+    return words(languageWordOffsets.front(), languageWordOffsets.back());
+}
+
+ColumnarWords ColumnarResult::words(const uint64_t begin, const uint64_t end) const
+{
+    ColumnarWords result;
+    result.IDs = wordIDs.subspan(begin, end - begin);
+    result.ProtoIDs = wordProtoIDs.subspan(begin, end - begin);
+    result.SoundOffsets = wordSoundOffsets.subspan(begin, end - begin + 1);
+    result.MeaningOffsets = wordMeaningOffsets.subspan(begin, end - begin + 1);
+    result.AllSounds = sounds;
+    result.AllMeaningKeys = meaningKeys;
+    result.AllMeaningWeights = meaningWeights;
+    return result;
+}
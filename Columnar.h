@@ -0,0 +1,100 @@
+#pragma once
+#include "Binary.h"
+#include "Language.h"
+
+/**
+ * @brief 列形式の結果ファイルの読み込み
+ *
+ * @note ファイルをメモリマップし、場所・言語・単語の列はコピーせずに参照する。
+ * @note 列は固定長で、可変長の音素列と意味はオフセットの列で区切る。
+ */
+class ColumnarResult
+{
+public:
+    // 最後の時代
+    int Section = 0;
+    // 音素表（音素の番号から文字列に戻すため）
+    std::vector<std::vector<std::string>> PhoneticsMap;
+
+    /**
+     * @brief ファイルを開く
+     *
+     * @param filename ファイルパス
+     * @return 成功したら true
+     */
+    bool Open(const std::string &filename);
+
+    /**
+     * @brief 場所の数
+     *
+     */
+    size_t PlaceCount() const { return places.size(); }
+
+    /**
+     * @brief 場所名
+     *
+     * @param place 場所ID
+     */
+    std::string_view Place(const size_t place) const { return strings.Get(places[place]); }
+
+    /**
+     * @brief 文字列表の文字列（意味など）
+     *
+     * @param index 文字列番号
+     */
+    std::string_view String(const uint32_t index) const { return strings.Get(index); }
+
+    /**
+     * @brief 言語の数（祖語は含まない）
+     *
+     */
+    size_t LanguageCount() const { return languagePlaces.size(); }
+
+    /**
+     * @brief 言語ごとの場所ID
+     *
+     */
+    std::span<const uint32_t> LanguagePlaces() const { return languagePlaces; }
+
+    /**
+     * @brief 言語ごとの影響度
+     *
+     */
+    std::span<const double> LanguageStrengths() const { return languageStrengths; }
+
+    /**
+     * @brief 祖語の単語
+     *
+     */
+    ColumnarWords ProtoWords() const;
+
+    /**
+     * @brief 言語の単語
+     *
+     * @param language 言語の番号
+     */
+    ColumnarWords LanguageWords(const size_t language) const;
+
+    /**
+     * @brief すべての言語の単語（言語の順に並ぶ、祖語は含まない）
+     *
+     */
+    ColumnarWords Words() const;
+
+private:
+    ColumnarWords words(const uint64_t begin, const uint64_t end) const;
+
+    MappedFile file;
+    BinaryStringView strings;
+    std::span<const uint32_t> places;
+    std::span<const uint32_t> languagePlaces;
+    std::span<const double> languageStrengths;
+    std::span<const uint64_t> languageWordOffsets;
+    std::span<const int32_t> wordIDs;
+    std::span<const int32_t> wordProtoIDs;
+    std::span<const uint64_t> wordSoundOffsets;
+    std::span<const Phonetics> sounds;
+    std::span<const uint64_t> wordMeaningOffsets;
+    std::span<const uint32_t> meaningKeys;
+    std::span<const double> meaningWeights;
+};
@@ -0,0 +1,299 @@
+#include "Compaction.h"
+#include "DifferenceLog.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+    // 単語の状態のうち、後の差分か保つ状態から参照されるもの
+    enum WordUse : uint8_t
+    {
+        SoundsUsed = 1,
+        MeaningsUsed = 2,
+        // 単語があるか（ないことも含む）
+        ExistenceUsed = 4,
+        AllUsed = SoundsUsed | MeaningsUsed | ExistenceUsed,
+    };
+
+    // 場所ごとの参照状況（単語は既定値と、単語ごとの上書き）
+    struct PlaceUse
+    {
+        bool Strength = true;
+        uint8_t Default = AllUsed;
+        std::unordered_map<int, uint8_t> Words;
+
+        uint8_t Get(const int wordID) const
+        {
+            auto it = Words.find(wordID);
+            return it == Words.end() ? Default : it->second;
+        }
+
+        void Set(const int wordID, const uint8_t use)
+        {
+            Words[wordID] = use;
+        }
+
+        void Reset(const uint8_t use)
+        {
+            Default = use;
+            Words.clear();
+        }
+    };
+
+    // 元の再生での差分の効果
+    enum RecordEffect : uint8_t
+    {
+        // 状態を変えた
+        Effective = 1,
+        // 複合語の参照単語があった（1つ目、2つ目）
+        PartExists = 2,
+    };
+
+    bool isValidPlace(const int place, const size_t places)
+    {
+        return place >= 0 && (size_t)place < places;
+    }
+
+    // 圧縮を1回行う
+    std::vector<LanguageDifference> compactOnce(
+        const std::vector<LanguageDifference> &diffs,
+        const size_t places,
+        const std::vector<int> &retainedSections)
+    {
+        // 1. 前から、単語があるかだけを追って、差分が元の再生で効果を持ったかを調べる
+        std::vector<uint8_t> effects(diffs.size(), 0);
+        std::vector<std::unordered_set<int>> existing(places);
+        for (size_t i = 0; i < diffs.size(); ++i)
+        {
+            const auto &diff = diffs[i];
+            if (!isValidPlace(diff.Place, places))
+                continue;
+            auto &words = existing[diff.Place];
+            const bool hasSource = isValidPlace(diff.Source.Place, places);
+            bool isEffective = true;
+            switch (diff.Type)
+            {
+            case LanguageDifferenceType::AddWord:
+                words.insert(diff.WordID);
+                break;
+            case LanguageDifferenceType::ChangeStrength:
+                break;
+            case LanguageDifferenceType::ChangeSound:
+            case LanguageDifferenceType::ChangeMeaning:
+                isEffective = words.count(diff.WordID) != 0;
+                break;
+            case LanguageDifferenceType::BorrowWord:
+                isEffective = hasSource && existing[diff.Source.Place].count(diff.Source.WordID) != 0 && words.count(diff.WordID) != 0;
+                break;
+            case LanguageDifferenceType::AddCompoundWord:
+                for (int p = 0; p < diff.PartCount; ++p)
+                {
+                    if (words.count(diff.Parts[p]) != 0)
+                        effects[i] |= PartExists << p;
+                }
+                words.insert(diff.WordID);
+                break;
+            case LanguageDifferenceType::Remove:
+                isEffective = words.erase(diff.WordID) != 0;
+                break;
+            case LanguageDifferenceType::CopyLanguage:
+                isEffective = hasSource && diff.Source.Place != diff.Place;
+                if (isEffective)
+                    words = existing[diff.Source.Place];
+                break;
+            }
+            if (isEffective)
+                effects[i] |= Effective;
+        }
+
+        // 2. 後ろから、差分が書いた状態が後で参照されるかを調べる
+        std::vector<int> barriers = retainedSections;
+        std::sort(barriers.begin(), barriers.end(), std::greater<int>());
+        size_t nextBarrier = 0;
+        std::vector<PlaceUse> uses(places);
+        std::vector<bool> isKept(diffs.size(), false);
+        for (size_t i = diffs.size(); i-- > 0;)
+        {
+            const auto &diff = diffs[i];
+            // 保つ時代の終わりでは、すべての状態が参照される
+            while (nextBarrier < barriers.size() && diff.Section <= barriers[nextBarrier])
+            {
+                uses.assign(places, PlaceUse());
+                nextBarrier++;
+            }
+            if ((effects[i] & Effective) == 0)
+                continue;
+
+            auto &use = uses[diff.Place];
+            const uint8_t wordUse = use.Get(diff.WordID);
+            bool keep = true;
+            switch (diff.Type)
+            {
+            case LanguageDifferenceType::AddWord:
+                use.Set(diff.WordID, 0);
+                break;
+            case LanguageDifferenceType::ChangeStrength:
+                keep = use.Strength;
+                use.Strength = false;
+                break;
+            case LanguageDifferenceType::ChangeSound:
+                // 音素列を読んで書き換える
+                keep = (wordUse & SoundsUsed) != 0;
+                if (keep)
+                    use.Set(diff.WordID, wordUse | ExistenceUsed);
+                break;
+            case LanguageDifferenceType::ChangeMeaning:
+                keep = (wordUse & MeaningsUsed) != 0;
+                if (keep)
+                    use.Set(diff.WordID, (wordUse & ~MeaningsUsed) | ExistenceUsed);
+                break;
+            case LanguageDifferenceType::BorrowWord:
+            {
+                keep = (wordUse & SoundsUsed) != 0;
+                if (keep)
+                {
+                    use.Set(diff.WordID, (wordUse & ~SoundsUsed) | ExistenceUsed);
+                    auto &source = uses[diff.Source.Place];
+                    source.Set(diff.Source.WordID, source.Get(diff.Source.WordID) | SoundsUsed | ExistenceUsed);
+                }
+                break;
+            }
+            case LanguageDifferenceType::AddCompoundWord:
+                keep = wordUse != 0;
+                use.Set(diff.WordID, 0);
+                if (keep)
+                {
+                    for (int p = 0; p < diff.PartCount; ++p)
+                    {
+                        const uint8_t partUse = (effects[i] & (PartExists << p)) ? AllUsed : ExistenceUsed;
+                        use.Set(diff.Parts[p], use.Get(diff.Parts[p]) | partUse);
+                    }
+                }
+                break;
+            case LanguageDifferenceType::Remove:
+                keep = (wordUse & ExistenceUsed) != 0;
+                use.Set(diff.WordID, 0);
+                break;
+            case LanguageDifferenceType::CopyLanguage:
+            {
+                use.Reset(0);
+                use.Strength = false;
+                auto &source = uses[diff.Source.Place];
+                source.Reset(AllUsed);
+                source.Strength = true;
+                break;
+            }
+            }
+            isKept[i] = keep;
+        }
+
+        std::vector<LanguageDifference> result;
+        result.reserve(std::count(isKept.begin(), isKept.end(), true));
+        for (size_t i = 0; i < diffs.size(); ++i)
+        {
+            if (isKept[i])
+                result.push_back(diffs[i]);
+        }
+        return result;
+    }
+}
+
+std::vector<LanguageDifference> compactDifferences(
+    const std::vector<LanguageDifference> &diffs,
+    const size_t places,
+    const std::vector<int> &retainedSections)
+{
+    // 取り除いた差分の作った単語を消していた差分などが何もしなくなるので、減らなくなるまで繰り返す
+    auto result = compactOnce(diffs, places, retainedSections);
+    while (true)
+    {
+        auto next = compactOnce(result, places, retainedSections);
+        if (next.size() == result.size())
+            return result;
+        result = std::move(next);
+    }
+}
+
+void LanguageSystem::CompactDifferences(const std::vector<int> &retainedSections)
+{
+    std::vector<LanguageDifference> diffs;
+    diffs.reserve(CountDifferences());
+    ForEachDifference([&](const LanguageDifference &diff)
+                      { diffs.push_back(diff); });
+    BaseDifference.reset();
+    languageDifference = compactDifferences(diffs, Graph.Places.size(), retainedSections);
+}
+
+bool compactDifferenceLog(const std::string &input, const std::string &output)
+{
+    // 入力と同じファイルにも書けるよう、一時ファイルに書いてから置き換える
+    const std::string temporary = output + ".tmp";
+    if (BinaryDifferenceLog::IsBinaryLog(input))
+    {
+        BinaryDifferenceLog log;
+        if (!log.Open(input))
+            return false;
+        std::vector<LanguageDifference> diffs;
+        diffs.reserve(log.RecordCount());
+        bool isValid = true;
+        if (!log.ForEachRecord([&](const DifferenceRecordView &view)
+                               {
+                                   auto diff = view.ToDifference();
+                                   if (diff)
+                                       diffs.push_back(std::move(*diff));
+                                   else
+                                       isValid = false; }) ||
+            !isValid)
+        {
+            std::cerr << "Error: 差分ログが壊れています: " << input << std::endl;
+            return false;
+        }
+        const auto keyframeSections = log.KeyframeSections();
+        const auto compacted = compactDifferences(diffs, log.Graph.Places.size(), keyframeSections);
+
+        LanguageSystem metadata;
+        metadata.Map = log.Map;
+        metadata.PhoneticsMap = log.PhoneticsMap;
+        metadata.Graph = log.Graph;
+        BinaryDifferenceLogWriter writer;
+        writer.KeyframeInterval = -1;
+        if (!writer.Open(temporary, metadata))
+            return false;
+        // キーフレームは、その時代の差分を書き終えた位置に写す
+        size_t keyframe = 0;
+        for (const auto &diff : compacted)
+        {
+            for (; keyframe < keyframeSections.size() && keyframeSections[keyframe] < diff.Section; ++keyframe)
+            {
+                writer.WriteKeyframe(keyframeSections[keyframe], log.Keyframe(keyframe));
+            }
+            writer.Write(diff);
+        }
+        for (; keyframe < keyframeSections.size(); ++keyframe)
+        {
+            writer.WriteKeyframe(keyframeSections[keyframe], log.Keyframe(keyframe));
+        }
+        if (!writer.Close())
+            return false;
+    }
+    else
+    {
+        LanguageSystem system;
+        if (!system.ImportYaml(input))
+            return false;
+        system.CompactDifferences();
+        system.Export(temporary);
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, output, error);
+    if (error)
+    {
+        std::cerr << "Error: ファイルを置き換えられませんでした: " << output << std::endl;
+        return false;
+    }
+    return true;
+}
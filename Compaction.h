@@ -0,0 +1,29 @@
+#pragma once
+#include "Language.h"
+
+/**
+ * @brief 差分を圧縮する（再生した結果に影響しない差分を取り除く）
+ *
+ * @param diffs 差分（古い順）
+ * @param places 場所の数
+ * @param retainedSections 状態を保つ時代（その時代までの差分を再生した状態も変わらないようにする）
+ * @return 圧縮した差分（古い順、ReplayEngine で再生すると元の差分と同じ状態になる）
+ *
+ * @note 後で上書きされる影響度・音素列・意味の変化、削除される単語への変化、元の再生で何もしなかった差分を取り除く。
+ * @note 単語追加（祖語）と言語の複写は常に残す。
+ */
+std::vector<LanguageDifference> compactDifferences(
+    const std::vector<LanguageDifference> &diffs,
+    const size_t places,
+    const std::vector<int> &retainedSections = {});
+
+/**
+ * @brief 差分ログのファイルを圧縮する
+ *
+ * @param input 入力ファイルパス（YAML、またはバイナリ形式の差分ログ）
+ * @param output 出力ファイルパス（入力と同じ形式、入力と同じでもよい）
+ * @return 成功したら true
+ *
+ * @note バイナリ形式のキーフレームはそのまま残し、その時代の状態も変わらないように圧縮する。
+ */
+bool compactDifferenceLog(const std::string &input, const std::string &output);
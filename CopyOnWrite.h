@@ -0,0 +1,261 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 書き込み時にコピーする（copy-on-write）連想配列
+ *
+ * @note コピーは O(1) で中身を共有する。非 const のメンバ関数を呼ぶと、共有中であれば中身を複製してから変更する。
+ * @note 読むだけのループでは std::as_const を使い、不要な複製を避ける。
+ */
+template <typename Key, typename Value>
+class CopyOnWriteMap
+{
+public:
+    using Container = std::map<Key, Value>;
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = typename Container::value_type;
+    using iterator = typename Container::iterator;
+    using const_iterator = typename Container::const_iterator;
+    using reverse_iterator = typename Container::reverse_iterator;
+    using const_reverse_iterator = typename Container::const_reverse_iterator;
+
+    CopyOnWriteMap() = default;
+    CopyOnWriteMap(std::initializer_list<value_type> values) : container(std::make_shared<Container>(values)) {}
+
+    // 読み込み（共有したまま）
+    const_iterator begin() const { return Get().begin(); }
+    const_iterator end() const { return Get().end(); }
+    const_reverse_iterator rbegin() const { return Get().rbegin(); }
+    const_reverse_iterator rend() const { return Get().rend(); }
+    const_iterator find(const Key &key) const { return Get().find(key); }
+    size_t count(const Key &key) const { return Get().count(key); }
+    size_t size() const { return container ? container->size() : 0; }
+    bool empty() const { return size() == 0; }
+
+    // 書き込み（共有を解除する）
+    iterator begin() { return Mutable().begin(); }
+    iterator end() { return Mutable().end(); }
+    reverse_iterator rbegin() { return Mutable().rbegin(); }
+    reverse_iterator rend() { return Mutable().rend(); }
+    iterator find(const Key &key) { return Mutable().find(key); }
+    Value &operator[](const Key &key) { return Mutable()[key]; }
+    size_t erase(const Key &key) { return Mutable().erase(key); }
+    iterator erase(iterator it) { return Mutable().erase(it); }
+    void clear() { container.reset(); }
+
+    template <typename... Args>
+    iterator emplace_hint(const_iterator hint, Args &&...args)
+    {
+        return Mutable().emplace_hint(hint, std::forward<Args>(args)...);
+    }
+
+    bool operator==(const CopyOnWriteMap &other) const
+    {
+        return container == other.container || Get() == other.Get();
+    }
+
+    /**
+     * @brief 他と中身を共有しているか
+     *
+     */
+    bool IsShared() const { return container && container.use_count() > 1; }
+
+    /**
+     * @brief 読み込み用の中身
+     *
+     */
+    const Container &Get() const
+    {
+        static const Container emptyContainer;
+        return container ? *container : emptyContainer;
+    }
+
+    /**
+     * @brief 書き込み用の中身（共有中なら複製する）
+     *
+     */
+    Container &Mutable()
+    {
+        if (!container)
+        {
+            container = std::make_shared<Container>();
+        }
+        else if (container.use_count() > 1)
+        {
+            container = std::make_shared<Container>(*container);
+        }
+        else
+        {
+            // 他スレッドが共有を解除した後の書き込みを順序付ける
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return *container;
+    }
+
+private:
+    std::shared_ptr<Container> container;
+};
+
+/**
+ * @brief 書き込み時にコピーする（copy-on-write）連想配列（キーの昇順に並べた配列に連続して置く）
+ *
+ * @note CopyOnWriteMap と同じ使い方ができる。要素は1つの配列に並ぶので、走査は先頭からの線形走査、検索は二分探索になり、破棄は配列1つの解放で済む。
+ * @note 末尾（最大のキーより大きいキー）への追加は O(1)、途中への追加と削除は後ろの要素をずらす。
+ * @note std::map と違い、追加と削除で他の要素への参照・イテレータは無効になる。また、非 const の走査ではキーも書き換えられるので変更しないこと。
+ */
+template <typename Key, typename Value>
+class CopyOnWriteFlatMap
+{
+public:
+    using Container = std::vector<std::pair<Key, Value>>;
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = typename Container::value_type;
+    using iterator = typename Container::iterator;
+    using const_iterator = typename Container::const_iterator;
+    using reverse_iterator = typename Container::reverse_iterator;
+    using const_reverse_iterator = typename Container::const_reverse_iterator;
+
+    CopyOnWriteFlatMap() = default;
+    CopyOnWriteFlatMap(std::initializer_list<value_type> values)
+    {
+        for (const auto &value : values)
+        {
+            (*this)[value.first] = value.second;
+        }
+    }
+
+    // 読み込み（共有したまま）
+    const_iterator begin() const { return Get().begin(); }
+    const_iterator end() const { return Get().end(); }
+    const_reverse_iterator rbegin() const { return Get().rbegin(); }
+    const_reverse_iterator rend() const { return Get().rend(); }
+    const_iterator find(const Key &key) const
+    {
+        const auto &entries = Get();
+        auto it = lowerBound(entries, key);
+        return (it != entries.end() && it->first == key) ? it : entries.end();
+    }
+    size_t count(const Key &key) const { return find(key) != end() ? 1 : 0; }
+    size_t size() const { return container ? container->size() : 0; }
+    bool empty() const { return size() == 0; }
+
+    // 書き込み（共有を解除する）
+    iterator begin() { return Mutable().begin(); }
+    iterator end() { return Mutable().end(); }
+    reverse_iterator rbegin() { return Mutable().rbegin(); }
+    reverse_iterator rend() { return Mutable().rend(); }
+    iterator find(const Key &key)
+    {
+        auto &entries = Mutable();
+        auto it = lowerBound(entries, key);
+        return (it != entries.end() && it->first == key) ? it : entries.end();
+    }
+    Value &operator[](const Key &key) { return emplace(key).first->second; }
+    size_t erase(const Key &key)
+    {
+        // 無いキーのために共有を解除しない
+        if (std::as_const(*this).find(key) == Get().end())
+            return 0;
+        erase(find(key));
+        return 1;
+    }
+    iterator erase(iterator it) { return Mutable().erase(it); }
+    void clear() { container.reset(); }
+
+    /**
+     * @brief 要素を追加する（キーがあれば何もしない）
+     *
+     * @param key キー
+     * @param args 値の構築に渡す引数
+     * @return 要素の位置と、追加したか
+     */
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(const Key &key, Args &&...args)
+    {
+        auto &entries = Mutable();
+        // キーの昇順に追加することが多いので、末尾を先に調べる
+        if (entries.empty() || entries.back().first < key)
+        {
+            entries.emplace_back(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+            return {entries.end() - 1, true};
+        }
+        auto it = lowerBound(entries, key);
+        if (it != entries.end() && it->first == key)
+            return {it, false};
+        it = entries.emplace(it, std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+        return {it, true};
+    }
+
+    template <typename... Args>
+    iterator emplace_hint(const_iterator, const Key &key, Args &&...args)
+    {
+        return emplace(key, std::forward<Args>(args)...).first;
+    }
+
+    /**
+     * @brief 要素数を予約する
+     *
+     * @param n 要素数
+     */
+    void reserve(const size_t n) { Mutable().reserve(n); }
+
+    bool operator==(const CopyOnWriteFlatMap &other) const
+    {
+        return container == other.container || Get() == other.Get();
+    }
+
+    /**
+     * @brief 他と中身を共有しているか
+     *
+     */
+    bool IsShared() const { return container && container.use_count() > 1; }
+
+    /**
+     * @brief 読み込み用の中身
+     *
+     */
+    const Container &Get() const
+    {
+        static const Container emptyContainer;
+        return container ? *container : emptyContainer;
+    }
+
+    /**
+     * @brief 書き込み用の中身（共有中なら複製する）
+     *
+     */
+    Container &Mutable()
+    {
+        if (!container)
+        {
+            container = std::make_shared<Container>();
+        }
+        else if (container.use_count() > 1)
+        {
+            container = std::make_shared<Container>(*container);
+        }
+        else
+        {
+            // 他スレッドが共有を解除した後の書き込みを順序付ける
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return *container;
+    }
+
+private:
+    template <typename Entries>
+    static auto lowerBound(Entries &entries, const Key &key)
+    {
+        return std::lower_bound(entries.begin(), entries.end(), key, [](const value_type &entry, const Key &k)
+                                { return entry.first < k; });
+    }
+
+    std::shared_ptr<Container> container;
+};
@@ -0,0 +1,1118 @@
+#include "DifferenceLog.h"
+#include "Replay.h"
+#include "Profile.h"
+#include "Snapshot.h"
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+
+namespace
+{
+    constexpr char DIFFERENCE_LOG_MAGIC[8] = {'T', 'P', 'D', 'L', 'O', 'G', '\0', '\0'};
+    constexpr uint32_t DIFFERENCE_LOG_VERSION = 2;
+
+    // ヘッダー（ファイル先頭）
+    struct DifferenceLogHeader
+    {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t Padding;
+        // 文字列表
+        BinaryBlock StringOffsets;
+        BinaryBlock StringChars;
+        // 格子地図
+        BinaryBlock MapRows;
+        BinaryBlock MapCells;
+        // 音素表
+        BinaryBlock PhoneticsRows;
+        BinaryBlock PhoneticsCells;
+        // 地理
+        BinaryBlock Places;
+        BinaryBlock Edges;
+        // 最初のレコードのバイト位置
+        uint64_t RecordsBegin;
+    };
+
+    // フッター（ファイル末尾）
+    struct DifferenceLogFooter
+    {
+        // レコード列の終わりのバイト位置
+        uint64_t RecordsEnd;
+        uint64_t RecordCount;
+        // 時代の索引
+        BinaryBlock Sections;
+        // キーフレームの索引
+        BinaryBlock Keyframes;
+        char Magic[8];
+    };
+
+    size_t alignedSize(const size_t size)
+    {
+        return (size + 7) & ~size_t(7);
+    }
+
+    void appendValue(std::vector<char> &buffer, const void *value, const size_t size)
+    {
+        const char *bytes = static_cast<const char *>(value);
+        buffer.insert(buffer.end(), bytes, bytes + size);
+    }
+
+    /**
+     * @brief YAML の差分ログを行単位で読む
+     *
+     * @note ファイルの中身を std::string_view で参照し、行や値ごとの文字列は作らない。
+     * @note 読めなかったときは最初の誤りの行と列（1始まり）を覚えておく。
+     */
+    class YamlLogScanner
+    {
+    public:
+        YamlLogScanner(const char *data, const size_t size) : text(data, size) {}
+
+        // 読み残しの行があるか
+        bool HasLine() const { return position < text.size(); }
+
+        // 次の行の行番号
+        size_t Line() const { return line; }
+
+        // 次の行が expected なら進める
+        bool AcceptLine(std::string_view expected)
+        {
+            std::string_view rest;
+            return Accept(expected, rest, true);
+        }
+
+        // 次の行が prefix で始まれば、残りを value に入れて進める
+        bool Accept(std::string_view prefix, std::string_view &value, const bool isWholeLine = false)
+        {
+            const auto current = peekLine();
+            if (!current.starts_with(prefix) || (isWholeLine && current.size() != prefix.size()))
+                return false;
+            value = current.substr(prefix.size());
+            valueLine = line;
+            valueColumn = prefix.size() + 1;
+            advance(current);
+            return true;
+        }
+
+        bool ExpectLine(std::string_view expected)
+        {
+            return AcceptLine(expected) || Fail(line, 1, "\"" + std::string(expected) + "\" が必要です");
+        }
+
+        bool Expect(std::string_view prefix, std::string_view &value)
+        {
+            return Accept(prefix, value) || Fail(line, 1, "\"" + std::string(prefix) + "\" が必要です");
+        }
+
+        template <typename T>
+        bool ExpectNumber(std::string_view prefix, T &value)
+        {
+            std::string_view text;
+            return Expect(prefix, text) && ParseNumber(text, value);
+        }
+
+        // 直前に読んだ値を数値に変換する（値の全体が数値であること）
+        template <typename T>
+        bool ParseNumber(std::string_view text, T &value)
+        {
+            const auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+            if (result.ec != std::errc() || result.ptr != text.data() + text.size() || text.empty())
+                return Fail(valueLine, valueColumn + (result.ec == std::errc() ? result.ptr - text.data() : 0), "数値ではありません");
+            return true;
+        }
+
+        // 直前に読んだ値 "[a, b, c]" を要素に分ける（空の要素も位置を保って残す）
+        bool ParseList(std::string_view text, std::vector<std::string_view> &items)
+        {
+            items.clear();
+            if (text.size() < 2 || text.front() != '[' || text.back() != ']')
+                return Fail(valueLine, valueColumn, "[ ] で囲まれた配列ではありません");
+            text = text.substr(1, text.size() - 2);
+            if (text.empty())
+                return true;
+            size_t begin = 0;
+            while (true)
+            {
+                const size_t end = std::min(text.find(',', begin), text.size());
+                auto item = text.substr(begin, end - begin);
+                while (!item.empty() && item.front() == ' ')
+                    item.remove_prefix(1);
+                while (!item.empty() && item.back() == ' ')
+                    item.remove_suffix(1);
+                items.push_back(item);
+                if (end == text.size())
+                    return true;
+                begin = end + 1;
+            }
+        }
+
+        bool Fail(const size_t errorLine, const size_t errorColumn, std::string message)
+        {
+            if (error.empty())
+            {
+                error = std::move(message);
+                this->errorLine = errorLine;
+                this->errorColumn = errorColumn;
+            }
+            return false;
+        }
+
+        // 値の位置で失敗する
+        bool FailAtValue(std::string message)
+        {
+            return Fail(valueLine, valueColumn, std::move(message));
+        }
+
+        void Report(const std::string &filename) const
+        {
+            std::cerr << "Error: 差分ログを読み込めません: " << filename << " (" << errorLine << "行 " << errorColumn << "列) " << error << std::endl;
+        }
+
+    private:
+        // 次の行（改行を除く、進めない）
+        std::string_view peekLine() const
+        {
+            if (position >= text.size())
+                return {};
+            const size_t end = std::min(text.find('\n', position), text.size());
+            auto current = text.substr(position, end - position);
+            if (!current.empty() && current.back() == '\r')
+                current.remove_suffix(1);
+            return current;
+        }
+
+        void advance(std::string_view current)
+        {
+            position = current.data() + current.size() - text.data();
+            if (position < text.size() && text[position] == '\r')
+                position++;
+            if (position < text.size())
+                position++;
+            line++;
+        }
+
+        std::string_view text;
+        size_t position = 0;
+        size_t line = 1;
+        size_t valueLine = 0;
+        size_t valueColumn = 0;
+        std::string error;
+        size_t errorLine = 0;
+        size_t errorColumn = 0;
+    };
+}
+
+void DifferenceSink::trackSpread(const LanguageDifference &diff)
+{
+    lastSection = std::max(lastSection, diff.Section);
+    if (diff.Type == LanguageDifferenceType::CopyLanguage || (diff.Type == LanguageDifferenceType::AddWord && !hasRoot))
+    {
+        hasRoot = hasRoot || diff.Type == LanguageDifferenceType::AddWord;
+        spreadDifferences.push_back(diff);
+    }
+}
+
+ChunkedFileWriter::~ChunkedFileWriter()
+{
+    Close();
+}
+
+bool ChunkedFileWriter::Open(const std::string &filename, const bool isBinary)
+{
+    Close();
+    file = std::fopen(filename.c_str(), isBinary ? "wb" : "w");
+    if (file == nullptr)
+    {
+        std::cerr << "Error: ファイルを開けませんでした: " << filename << std::endl;
+        return false;
+    }
+    size = 0;
+    chunk.reserve(CHUNK_SIZE);
+    closing = false;
+    failed = false;
+    thread = std::thread(&ChunkedFileWriter::run, this);
+    return true;
+}
+
+void ChunkedFileWriter::Append(const char *data, const size_t count)
+{
+    if (chunk.size() + count > CHUNK_SIZE && !chunk.empty())
+    {
+        flushChunk();
+    }
+    chunk.insert(chunk.end(), data, data + count);
+    size += count;
+}
+
+bool ChunkedFileWriter::Close()
+{
+    if (file == nullptr)
+        return true;
+
+    flushChunk();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    condition.notify_all();
+    thread.join();
+
+    const bool closed = std::fclose(file) == 0;
+    file = nullptr;
+    pending.clear();
+    freeChunks.clear();
+    chunk = std::vector<char>();
+    if (failed || !closed)
+    {
+        std::cerr << "Error: ファイルを書き込めませんでした" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void ChunkedFileWriter::flushChunk()
+{
+    if (chunk.empty())
+        return;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    // 書き出しが追いつくまで待つ（メモリ使用量を一定に保つ）
+    condition.wait(lock, [&]()
+                   { return pending.size() < MAX_PENDING_CHUNKS; });
+    pending.push_back(std::move(chunk));
+    if (freeChunks.empty())
+    {
+        chunk = std::vector<char>();
+        chunk.reserve(CHUNK_SIZE);
+    }
+    else
+    {
+        chunk = std::move(freeChunks.back());
+        freeChunks.pop_back();
+    }
+    lock.unlock();
+    condition.notify_all();
+}
+
+void ChunkedFileWriter::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        condition.wait(lock, [&]()
+                       { return !pending.empty() || closing; });
+        if (pending.empty())
+            break;
+
+        auto buffer = std::move(pending.front());
+        pending.pop_front();
+        lock.unlock();
+        bool written;
+        {
+            ProfileScope profile(ProfileStage::WriteLog);
+            written = std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+        }
+        lock.lock();
+
+        if (!written)
+            failed = true;
+        buffer.clear();
+        freeChunks.push_back(std::move(buffer));
+        condition.notify_all();
+    }
+}
+
+bool DifferenceLogWriter::Open(const std::string &filename, const LanguageSystem &system)
+{
+    // Export と同じ改行にするためテキストモードで開く
+    if (!output.Open(filename, false))
+        return false;
+    places = system.Graph.Places;
+
+    // 1. Map
+    output.Append("Map:\n");
+    appendTable(system.Map);
+
+    // 2. Graph（辺リスト形式の地理のみ）
+    if (system.Map.empty() && !system.Graph.Edges.empty())
+    {
+        output.Append("Graph:\n");
+        for (const auto &edge : system.Graph.Edges)
+        {
+            output.Append("  - [");
+            output.Append(places[edge.From]);
+            output.Append(", ");
+            output.Append(places[edge.To]);
+            output.Append(", ");
+            appendDouble(edge.Weight);
+            output.Append("]\n");
+        }
+    }
+
+    // 3. PhoneticsMap
+    output.Append("PhoneticsMap:\n");
+    appendTable(system.PhoneticsMap);
+
+    // 4. LanguageDifferences
+    output.Append("LanguageDifferences:\n");
+    return true;
+}
+
+void DifferenceLogWriter::Write(const LanguageDifference &diff)
+{
+    if (!output.IsOpen())
+        return;
+    trackSpread(diff);
+
+    const auto placeName = [&](const int place) -> std::string_view
+    {
+        return (place >= 0 && place < (int)places.size()) ? std::string_view(places[place]) : std::string_view();
+    };
+    const auto appendItem = [&](const auto &value)
+    {
+        output.Append("      - ");
+        if constexpr (std::is_arithmetic_v<std::decay_t<decltype(value)>>)
+            appendInt(value);
+        else
+            output.Append(value);
+        output.Append("\n");
+    };
+
+    output.Append("  - Section: ");
+    appendInt(diff.Section);
+    output.Append("\n    Type: ");
+    appendInt(static_cast<int>(diff.Type));
+    output.Append("\n");
+
+    // 従来の形式（地理は名前、パラメータは配列）で書き出す
+    output.Append("    IntParam:\n");
+    if (diff.Type == LanguageDifferenceType::BorrowWord)
+        appendItem(diff.Source.WordID);
+    if (diff.Type != LanguageDifferenceType::ChangeStrength && diff.Type != LanguageDifferenceType::CopyLanguage)
+        appendItem(diff.WordID);
+    if (diff.Type == LanguageDifferenceType::AddCompoundWord)
+    {
+        for (int i = 0; i < diff.PartCount; ++i)
+            appendItem(diff.Parts[i]);
+    }
+
+    output.Append("    DoubleParam:\n");
+    if (diff.Type == LanguageDifferenceType::ChangeStrength)
+    {
+        output.Append("      - ");
+        appendDouble(diff.Strength);
+        output.Append("\n");
+    }
+
+    output.Append("    StringParam:\n");
+    if (diff.Type == LanguageDifferenceType::BorrowWord || diff.Type == LanguageDifferenceType::CopyLanguage)
+        appendItem(placeName(diff.Source.Place));
+    appendItem(placeName(diff.Place));
+    if (diff.Type == LanguageDifferenceType::AddWord)
+        appendItem(std::string_view(diff.GetWordForm()));
+
+    const auto soundChange = diff.GetSoundChange();
+    output.Append("    SoundChange:\n      Before:\n        Place: ");
+    appendInt(soundChange.beforePhon.Place);
+    output.Append("\n        Mannar: ");
+    appendInt(soundChange.beforePhon.Mannar);
+    output.Append("\n      After:\n        Place: ");
+    appendInt(soundChange.AfterPhone.Place);
+    output.Append("\n        Mannar: ");
+    appendInt(soundChange.AfterPhone.Mannar);
+    output.Append("\n      Condition: ");
+    appendInt(static_cast<int>(soundChange.Condition));
+    output.Append("\n      IsRemove: ");
+    appendInt(soundChange.IsRemove ? 1 : 0);
+    output.Append("\n");
+
+    output.Append("    MeaningChange:\n");
+    for (const auto &[key, value] : diff.GetMeaning())
+    {
+        output.Append("      - Key: ");
+        output.Append(key);
+        output.Append("\n        Value: ");
+        appendDouble(value);
+        output.Append("\n");
+    }
+}
+
+bool DifferenceLogWriter::Close()
+{
+    return output.Close();
+}
+
+void DifferenceLogWriter::appendInt(const long long value)
+{
+    char buffer[24];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    output.Append(buffer, result.ptr - buffer);
+}
+
+void DifferenceLogWriter::appendDouble(const double value)
+{
+    // std::ostream の既定（%g、有効数字6桁）と同じ書式
+    char buffer[32];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::general, 6);
+    output.Append(buffer, result.ptr - buffer);
+}
+
+void DifferenceLogWriter::appendTable(const std::vector<std::vector<std::string>> &table)
+{
+    for (const auto &row : table)
+    {
+        output.Append("  - [");
+        for (size_t i = 0; i < row.size(); ++i)
+        {
+            output.Append(row[i]);
+            if (i != row.size() - 1)
+                output.Append(", ");
+        }
+        output.Append("]\n");
+    }
+}
+
+DifferenceRecord DifferenceRecord::Create(const LanguageDifference &diff)
+{
+    DifferenceRecord record{};
+    record.Type = diff.Type;
+    record.SoundCondition = diff.SoundCondition;
+    record.SoundIsRemove = diff.SoundIsRemove;
+    record.PartCount = diff.PartCount;
+    record.Section = diff.Section;
+    record.Place = diff.Place;
+    record.WordID = diff.WordID;
+    if (!diff.HasPayload())
+    {
+        std::memcpy(&record.Data, &diff.Strength, sizeof(record.Data));
+    }
+    return record;
+}
+
+bool DifferenceRecord::Restore(const size_t places, LanguageDifference &diff) const
+{
+    if (Type > LanguageDifferenceType::CopyLanguage || PartCount > LanguageDifference::MAX_PARTS ||
+        Place < 0 || (size_t)Place >= places)
+        return false;
+    diff = LanguageDifference();
+    diff.Type = static_cast<LanguageDifferenceType>(Type);
+    diff.SoundCondition = SoundCondition;
+    diff.SoundIsRemove = SoundIsRemove;
+    diff.PartCount = PartCount;
+    diff.Section = Section;
+    diff.Place = Place;
+    diff.WordID = WordID;
+    if (!diff.HasPayload())
+    {
+        std::memcpy(&diff.Strength, &Data, sizeof(Data));
+        if ((diff.Type == LanguageDifferenceType::BorrowWord || diff.Type == LanguageDifferenceType::CopyLanguage) &&
+            (diff.Source.Place < 0 || (size_t)diff.Source.Place >= places))
+            return false;
+    }
+    return true;
+}
+
+bool DifferenceRecordView::ForEachMeaning(const std::function<void(std::string_view, double)> &func) const
+{
+    // 意味は (uint32 キーの長さ, キー, double 値) の並び（位置合わせなし）
+    size_t position = 0;
+    for (uint32_t i = 0; i < MeaningCount; ++i)
+    {
+        uint32_t keySize;
+        double value;
+        if (Meanings.size() - position < sizeof(keySize))
+            return false;
+        std::memcpy(&keySize, Meanings.data() + position, sizeof(keySize));
+        position += sizeof(keySize);
+        if (Meanings.size() - position < (size_t)keySize + sizeof(value))
+            return false;
+        const std::string_view key(Meanings.data() + position, keySize);
+        position += keySize;
+        std::memcpy(&value, Meanings.data() + position, sizeof(value));
+        position += sizeof(value);
+        func(key, value);
+    }
+    return true;
+}
+
+std::optional<LanguageDifference> DifferenceRecordView::ToDifference() const
+{
+    LanguageDifference diff;
+    if (Record == nullptr || !Record->Restore(PlaceCount, diff))
+        return std::nullopt;
+    if (diff.HasPayload())
+    {
+        diff.Payload = new DifferencePayload;
+        diff.Payload->WordForm = WordForm;
+        if (!ForEachMeaning([&](std::string_view key, const double value)
+                            { diff.Payload->Meanings.emplace(key, value); }))
+            return std::nullopt;
+    }
+    return diff;
+}
+
+bool BinaryDifferenceLogWriter::Open(const std::string &filename, const LanguageSystem &system)
+{
+    if (!output.Open(filename, true))
+        return false;
+
+    // ヘッダーとメタデータは先にまとめて組み立てる
+    BinaryWriter writer;
+    BinaryStringTable strings;
+    DifferenceLogHeader header{};
+    std::memcpy(header.Magic, DIFFERENCE_LOG_MAGIC, sizeof(DIFFERENCE_LOG_MAGIC));
+    header.Version = DIFFERENCE_LOG_VERSION;
+    writer.Write(header);
+
+    writeBinaryTable(writer, strings, system.Map, header.MapRows, header.MapCells);
+    writeBinaryTable(writer, strings, system.PhoneticsMap, header.PhoneticsRows, header.PhoneticsCells);
+    std::vector<uint32_t> places;
+    places.reserve(system.Graph.Places.size());
+    for (const auto &place : system.Graph.Places)
+    {
+        places.push_back(strings.Add(place));
+    }
+    header.Places = writer.WriteBlock(places);
+    header.Edges = writer.WriteBlock(system.Graph.Edges);
+    strings.Write(writer, header.StringOffsets, header.StringChars);
+    writer.Align();
+    header.RecordsBegin = writer.Buffer.size();
+    writer.Overwrite(0, header);
+
+    output.Append(writer.Buffer.data(), writer.Buffer.size());
+    recordsBegin = header.RecordsBegin;
+    recordCount = 0;
+    sections.clear();
+    keyframes.clear();
+    keyframeEnd = recordsBegin;
+    return true;
+}
+
+void BinaryDifferenceLogWriter::Write(const LanguageDifference &diff)
+{
+    if (!output.IsOpen())
+        return;
+    trackSpread(diff);
+
+    // 時代が変わったら索引を追加する
+    if (sections.empty() || sections.back().Section != diff.Section)
+    {
+        sections.push_back({diff.Section, 0, output.Size(), 0});
+    }
+    sections.back().Count++;
+    recordCount++;
+
+    auto record = DifferenceRecord::Create(diff);
+    if (!diff.HasPayload())
+    {
+        output.Append(reinterpret_cast<const char *>(&record), sizeof(record));
+        return;
+    }
+
+    // 可変長データ: uint32 語形の長さ, uint32 意味の数, 語形, 意味の並び, 8バイト境界までの詰め物
+    payload.clear();
+    const auto &wordForm = diff.GetWordForm();
+    const auto &meanings = diff.GetMeaning();
+    const uint32_t wordFormSize = (uint32_t)wordForm.size();
+    const uint32_t meaningCount = (uint32_t)meanings.size();
+    appendValue(payload, &wordFormSize, sizeof(wordFormSize));
+    appendValue(payload, &meaningCount, sizeof(meaningCount));
+    payload.insert(payload.end(), wordForm.begin(), wordForm.end());
+    for (const auto &[key, value] : meanings)
+    {
+        const uint32_t keySize = (uint32_t)key.size();
+        appendValue(payload, &keySize, sizeof(keySize));
+        payload.insert(payload.end(), key.begin(), key.end());
+        appendValue(payload, &value, sizeof(value));
+    }
+    payload.resize(alignedSize(payload.size()), 0);
+
+    record.Data = payload.size();
+    output.Append(reinterpret_cast<const char *>(&record), sizeof(record));
+    output.Append(payload.data(), payload.size());
+}
+
+void BinaryDifferenceLogWriter::EndSection(const LanguageSystem &system)
+{
+    if (!output.IsOpen() || KeyframeInterval < 0)
+        return;
+
+    // 最初の時代は必ず書き、以降は間隔か差分のバイト数で決める
+    bool isKeyframe = keyframes.empty();
+    if (!isKeyframe && KeyframeInterval > 0)
+        isKeyframe = system.Section - keyframes.back().Section >= KeyframeInterval;
+    else if (!isKeyframe)
+        isKeyframe = (double)(output.Size() - keyframeEnd) >= (double)keyframes.back().Size * KeyframeRatio;
+    if (!isKeyframe)
+        return;
+
+    WriteKeyframe(system.Section, encodeSnapshot(system, false));
+}
+
+void BinaryDifferenceLogWriter::WriteKeyframe(const int section, std::span<const char> snapshot)
+{
+    if (!output.IsOpen())
+        return;
+
+    // レコードと同じく8バイト境界に揃える
+    static constexpr char padding[8] = {};
+    const size_t size = alignedSize(snapshot.size());
+    keyframes.push_back({section, 0, output.Size(), size});
+    output.Append(snapshot.data(), snapshot.size());
+    output.Append(padding, size - snapshot.size());
+    keyframeEnd = output.Size();
+}
+
+bool BinaryDifferenceLogWriter::Close()
+{
+    if (!output.IsOpen())
+        return true;
+
+    // 索引とフッター
+    DifferenceLogFooter footer{};
+    footer.RecordsEnd = output.Size();
+    footer.RecordCount = recordCount;
+    footer.Sections = {output.Size(), sections.size()};
+    footer.Keyframes = {output.Size() + sections.size() * sizeof(DifferenceLogSection), keyframes.size()};
+    std::memcpy(footer.Magic, DIFFERENCE_LOG_MAGIC, sizeof(DIFFERENCE_LOG_MAGIC));
+    output.Append(reinterpret_cast<const char *>(sections.data()), sections.size() * sizeof(DifferenceLogSection));
+    output.Append(reinterpret_cast<const char *>(keyframes.data()), keyframes.size() * sizeof(DifferenceLogKeyframe));
+    output.Append(reinterpret_cast<const char *>(&footer), sizeof(footer));
+    sections.clear();
+    keyframes.clear();
+    return output.Close();
+}
+
+bool BinaryDifferenceLog::IsBinaryLog(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    char magic[8] = {};
+    file.read(magic, sizeof(magic));
+    return file && std::memcmp(magic, DIFFERENCE_LOG_MAGIC, sizeof(magic)) == 0;
+}
+
+bool BinaryDifferenceLog::Open(const std::string &filename)
+{
+    if (!file.Open(filename))
+    {
+        std::cerr << "Error: ファイルを開けませんでした: " << filename << std::endl;
+        return false;
+    }
+
+    const BinaryReader reader(file.Data(), file.Size());
+    auto fail = [&]()
+    {
+        std::cerr << "Error: 差分ログが壊れています: " << filename << std::endl;
+        file.Close();
+        return false;
+    };
+
+    DifferenceLogHeader header;
+    DifferenceLogFooter footer;
+    if (!reader.Read(0, header) || std::memcmp(header.Magic, DIFFERENCE_LOG_MAGIC, sizeof(DIFFERENCE_LOG_MAGIC)) != 0 ||
+        file.Size() < sizeof(footer) || !reader.Read(file.Size() - sizeof(footer), footer) ||
+        std::memcmp(footer.Magic, DIFFERENCE_LOG_MAGIC, sizeof(DIFFERENCE_LOG_MAGIC)) != 0)
+        return fail();
+    if (header.Version != DIFFERENCE_LOG_VERSION)
+    {
+        std::cerr << "Error: 未対応の差分ログのバージョンです: " << header.Version << std::endl;
+        file.Close();
+        return false;
+    }
+
+    // メタデータ
+    const BinaryStringView strings(reader, header.StringOffsets, header.StringChars);
+    const auto placeIndices = reader.Block<uint32_t>(header.Places);
+    const auto edges = reader.Block<GeographyEdge>(header.Edges);
+    sections = reader.Block<DifferenceLogSection>(footer.Sections);
+    keyframes = reader.Block<DifferenceLogKeyframe>(footer.Keyframes);
+    if (strings.Size() + 1 != header.StringOffsets.Count ||
+        placeIndices.size() != header.Places.Count ||
+        edges.size() != header.Edges.Count ||
+        sections.size() != footer.Sections.Count ||
+        keyframes.size() != footer.Keyframes.Count ||
+        header.RecordsBegin > footer.RecordsEnd || footer.RecordsEnd > file.Size() ||
+        !readBinaryTable(reader, strings, header.MapRows, header.MapCells, Map) ||
+        !readBinaryTable(reader, strings, header.PhoneticsRows, header.PhoneticsCells, PhoneticsMap))
+        return fail();
+
+    Graph = Geography();
+    for (const auto index : placeIndices)
+    {
+        Graph.Places.emplace_back(strings.Get(index));
+    }
+    for (const auto &edge : edges)
+    {
+        if (edge.From < 0 || edge.To < 0 || edge.From >= (int)placeIndices.size() || edge.To >= (int)placeIndices.size())
+            return fail();
+    }
+    Graph.Edges.assign(edges.begin(), edges.end());
+    Graph.Build();
+    for (const auto &keyframe : keyframes)
+    {
+        if (keyframe.Offset < header.RecordsBegin || keyframe.Offset > footer.RecordsEnd ||
+            keyframe.Size > footer.RecordsEnd - keyframe.Offset)
+            return fail();
+    }
+
+    recordsBegin = header.RecordsBegin;
+    recordsEnd = footer.RecordsEnd;
+    recordCount = footer.RecordCount;
+    return true;
+}
+
+std::vector<int> BinaryDifferenceLog::Sections() const
+{
+    std::vector<int> result;
+    result.reserve(sections.size());
+    for (const auto &section : sections)
+    {
+        result.push_back(section.Section);
+    }
+    return result;
+}
+
+std::vector<int> BinaryDifferenceLog::KeyframeSections() const
+{
+    std::vector<int> result;
+    result.reserve(keyframes.size());
+    for (const auto &keyframe : keyframes)
+    {
+        result.push_back(keyframe.Section);
+    }
+    return result;
+}
+
+std::span<const char> BinaryDifferenceLog::Keyframe(const size_t index) const
+{
+    if (index >= keyframes.size())
+        return {};
+    return std::span<const char>(file.Data() + keyframes[index].Offset, keyframes[index].Size);
+}
+
+bool BinaryDifferenceLog::ForEachRecord(const std::function<void(const DifferenceRecordView &)> &func) const
+{
+    // キーフレームがレコードの間にあるので、時代ごとに読む
+    for (const auto &section : sections)
+    {
+        if (!readRecords(section.Offset, section.Count, func))
+            return false;
+    }
+    return true;
+}
+
+bool BinaryDifferenceLog::ForEachRecord(const int firstSection, const int lastSection, const std::function<void(const DifferenceRecordView &)> &func) const
+{
+    auto first = std::lower_bound(sections.begin(), sections.end(), firstSection, [](const DifferenceLogSection &section, const int value)
+                                  { return section.Section < value; });
+    for (auto it = first; it != sections.end() && it->Section <= lastSection; ++it)
+    {
+        if (!readRecords(it->Offset, it->Count, func))
+            return false;
+    }
+    return true;
+}
+
+bool BinaryDifferenceLog::Reconstruct(const int section, LanguageSystem &system) const
+{
+    // 一旦別の語族に復元する
+    LanguageSystem result;
+    int firstSection = std::numeric_limits<int>::min();
+    auto keyframe = std::upper_bound(keyframes.begin(), keyframes.end(), section, [](const int value, const DifferenceLogKeyframe &keyframe)
+                                     { return value < keyframe.Section; });
+    if (keyframe != keyframes.begin())
+    {
+        --keyframe;
+        if (!decodeSnapshot(result, file.Data() + keyframe->Offset, keyframe->Size))
+            return false;
+        firstSection = keyframe->Section + 1;
+    }
+    else
+    {
+        // キーフレームがなければ最初から再生する
+        result.Map = Map;
+        result.PhoneticsMap = PhoneticsMap;
+        result.Graph = Map.empty() ? Graph : Geography::CreateFromGrid(Map);
+        for (const auto &place : result.Graph.Places)
+        {
+            result.LanguageMap[place].Strength = 0.0;
+        }
+    }
+
+    ReplayEngine engine(result);
+    bool isValid = true;
+    if (!ForEachRecord(firstSection, section, [&](const DifferenceRecordView &view)
+                       {
+                           const auto diff = view.ToDifference();
+                           if (diff)
+                               engine.Apply(*diff);
+                           else
+                               isValid = false; }) ||
+        !isValid)
+    {
+        std::cerr << "Error: 差分ログが壊れています" << std::endl;
+        return false;
+    }
+    result.Section = section;
+    system = std::move(result);
+    return true;
+}
+
+bool BinaryDifferenceLog::ReadRecord(const uint64_t offset, DifferenceRecordView &view) const
+{
+    return readRecords(offset, 1, [&](const DifferenceRecordView &record)
+                       { view = record; });
+}
+
+bool BinaryDifferenceLog::readRecords(uint64_t offset, uint64_t count, const std::function<void(const DifferenceRecordView &)> &func) const
+{
+    const char *data = file.Data();
+    const size_t places = Graph.Places.size();
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        if (offset < recordsBegin || offset % 8 != 0 || recordsEnd - offset < sizeof(DifferenceRecord))
+            return false;
+
+        DifferenceRecordView view;
+        view.Offset = offset;
+        view.Record = reinterpret_cast<const DifferenceRecord *>(data + offset);
+        view.PlaceCount = places;
+        offset += sizeof(DifferenceRecord);
+
+        LanguageDifference check;
+        if (!view.Record->Restore(places, check))
+            return false;
+        if (check.HasPayload())
+        {
+            const uint64_t payloadSize = view.Record->Data;
+            uint32_t wordFormSize;
+            if (payloadSize > recordsEnd - offset || payloadSize < 2 * sizeof(uint32_t))
+                return false;
+            std::memcpy(&wordFormSize, data + offset, sizeof(wordFormSize));
+            std::memcpy(&view.MeaningCount, data + offset + sizeof(uint32_t), sizeof(uint32_t));
+            if (wordFormSize > payloadSize - 2 * sizeof(uint32_t))
+                return false;
+            const char *wordForm = data + offset + 2 * sizeof(uint32_t);
+            view.WordForm = std::string_view(wordForm, wordFormSize);
+            view.Meanings = std::span<const char>(wordForm + wordFormSize, data + offset + payloadSize);
+            offset += payloadSize;
+        }
+        func(view);
+    }
+    return true;
+}
+
+void LanguageSystem::ExportBinary(const std::string &filename)
+{
+    BinaryDifferenceLogWriter writer;
+    if (!writer.Open(filename, *this))
+        return;
+    ForEachDifference([&](const LanguageDifference &diff)
+                      { writer.Write(diff); });
+    writer.Close();
+}
+
+bool LanguageSystem::ImportBinary(const std::string &filename)
+{
+    BinaryDifferenceLog log;
+    if (!log.Open(filename))
+        return false;
+
+    std::vector<LanguageDifference> differences;
+    differences.reserve(log.RecordCount());
+    bool isValid = true;
+    if (!log.ForEachRecord([&](const DifferenceRecordView &view)
+                           {
+                               auto diff = view.ToDifference();
+                               if (diff)
+                                   differences.push_back(std::move(*diff));
+                               else
+                                   isValid = false; }) ||
+        !isValid)
+    {
+        std::cerr << "Error: 差分ログが壊れています: " << filename << std::endl;
+        return false;
+    }
+
+    Map = std::move(log.Map);
+    PhoneticsMap = std::move(log.PhoneticsMap);
+    Graph = Map.empty() ? std::move(log.Graph) : Geography::CreateFromGrid(Map);
+    BaseDifference.reset();
+    languageDifference = std::move(differences);
+    return true;
+}
+
+bool LanguageSystem::ImportYaml(const std::string &filename)
+{
+    MappedFile file;
+    if (!file.Open(filename))
+    {
+        std::cerr << "Error: ファイルを開けませんでした: " << filename << std::endl;
+        return false;
+    }
+    YamlLogScanner scanner(file.Data(), file.Size());
+    auto fail = [&]()
+    {
+        scanner.Report(filename);
+        return false;
+    };
+
+    // 1. 地図・地理・音素表
+    std::vector<std::string_view> items;
+    std::string_view value;
+    const auto readTable = [&](std::vector<std::vector<std::string>> &table)
+    {
+        while (scanner.Accept("  - ", value))
+        {
+            if (!scanner.ParseList(value, items))
+                return false;
+            table.emplace_back(items.begin(), items.end());
+        }
+        return true;
+    };
+    std::vector<std::vector<std::string>> map;
+    std::vector<std::vector<std::string>> edgeList = {{"source", "target", "weight"}};
+    std::vector<std::vector<std::string>> phoneticsMap;
+    if (!scanner.ExpectLine("Map:") || !readTable(map))
+        return fail();
+    if (scanner.AcceptLine("Graph:") && !readTable(edgeList))
+        return fail();
+    if (!scanner.ExpectLine("PhoneticsMap:") || !readTable(phoneticsMap) ||
+        !scanner.ExpectLine("LanguageDifferences:"))
+        return fail();
+    auto graph = edgeList.size() > 1 ? Geography::CreateFromEdgeList(edgeList) : Geography::CreateFromGrid(map);
+
+    // 2. 差分（作業領域は使い回す）
+    std::vector<LanguageDifference> differences;
+    std::vector<int> ints;
+    std::vector<double> doubles;
+    std::vector<std::string_view> strings;
+    std::vector<size_t> stringLines;
+    while (scanner.HasLine())
+    {
+        const size_t recordLine = scanner.Line();
+        int section;
+        int type;
+        if (!scanner.ExpectNumber("  - Section: ", section) || !scanner.ExpectNumber("    Type: ", type))
+            return fail();
+        if (type < 0 || type > static_cast<int>(LanguageDifferenceType::CopyLanguage))
+        {
+            scanner.FailAtValue("未知の差分のタイプです");
+            return fail();
+        }
+
+        ints.clear();
+        doubles.clear();
+        strings.clear();
+        stringLines.clear();
+        if (!scanner.ExpectLine("    IntParam:"))
+            return fail();
+        while (scanner.Accept("      - ", value))
+        {
+            if (!scanner.ParseNumber(value, ints.emplace_back()))
+                return fail();
+        }
+        if (!scanner.ExpectLine("    DoubleParam:"))
+            return fail();
+        while (scanner.Accept("      - ", value))
+        {
+            if (!scanner.ParseNumber(value, doubles.emplace_back()))
+                return fail();
+        }
+        if (!scanner.ExpectLine("    StringParam:"))
+            return fail();
+        while (scanner.Accept("      - ", value))
+        {
+            stringLines.push_back(scanner.Line() - 1);
+            strings.push_back(value);
+        }
+
+        SoundChange soundChange;
+        int condition;
+        int isRemove;
+        if (!scanner.ExpectLine("    SoundChange:") ||
+            !scanner.ExpectLine("      Before:") ||
+            !scanner.ExpectNumber("        Place: ", soundChange.beforePhon.Place) ||
+            !scanner.ExpectNumber("        Mannar: ", soundChange.beforePhon.Mannar) ||
+            !scanner.ExpectLine("      After:") ||
+            !scanner.ExpectNumber("        Place: ", soundChange.AfterPhone.Place) ||
+            !scanner.ExpectNumber("        Mannar: ", soundChange.AfterPhone.Mannar) ||
+            !scanner.ExpectNumber("      Condition: ", condition) ||
+            !scanner.ExpectNumber("      IsRemove: ", isRemove))
+            return fail();
+        soundChange.Condition = static_cast<SoundChangeCondition>(condition);
+        soundChange.IsRemove = isRemove != 0;
+
+        Meaning meaning;
+        if (!scanner.ExpectLine("    MeaningChange:"))
+            return fail();
+        std::string_view key;
+        while (scanner.Accept("      - Key: ", key))
+        {
+            double weight;
+            if (!scanner.ExpectNumber("        Value: ", weight))
+                return fail();
+            meaning.insert_or_assign(std::string(key), weight);
+        }
+
+        // パラメータの数を確かめ、場所名を場所IDに解決する
+        const auto diffType = static_cast<LanguageDifferenceType>(type);
+        const bool hasSource = diffType == LanguageDifferenceType::BorrowWord || diffType == LanguageDifferenceType::CopyLanguage;
+        const size_t nPlaces = hasSource ? 2 : 1;
+        const size_t nInts = (diffType == LanguageDifferenceType::ChangeStrength || diffType == LanguageDifferenceType::CopyLanguage) ? 0 : nPlaces;
+        if (strings.size() < nPlaces || ints.size() < nInts ||
+            (diffType == LanguageDifferenceType::ChangeStrength && doubles.empty()))
+        {
+            scanner.Fail(recordLine, 1, "差分のパラメータが足りません");
+            return fail();
+        }
+        int places[2];
+        for (size_t i = 0; i < nPlaces; ++i)
+        {
+            places[i] = graph.FindPlace(strings[i]);
+            if (places[i] < 0)
+            {
+                scanner.Fail(stringLines[i], 9, "地図にない場所です: " + std::string(strings[i]));
+                return fail();
+            }
+        }
+
+        switch (diffType)
+        {
+        case LanguageDifferenceType::AddWord:
+            differences.push_back(LanguageDifference::CreateAddWord(places[0], section, ints[0], strings.size() > 1 ? std::string(strings[1]) : "", meaning));
+            break;
+        case LanguageDifferenceType::ChangeStrength:
+            differences.push_back(LanguageDifference::CreateChangeStrength(places[0], section, doubles[0]));
+            break;
+        case LanguageDifferenceType::ChangeSound:
+            differences.push_back(LanguageDifference::CreateChangeSound(places[0], section, ints[0], soundChange));
+            break;
+        case LanguageDifferenceType::ChangeMeaning:
+            differences.push_back(LanguageDifference::CreateChangeMeaning(places[0], section, ints[0], meaning));
+            break;
+        case LanguageDifferenceType::BorrowWord:
+            differences.push_back(LanguageDifference::CreateBorrowWord(places[0], places[1], section, ints[0], ints[1]));
+            break;
+        case LanguageDifferenceType::AddCompoundWord:
+            differences.push_back(LanguageDifference::CreateAddCompoundWord(places[0], section, ints[0], std::vector<int>(ints.begin() + 1, ints.end())));
+            break;
+        case LanguageDifferenceType::Remove:
+            differences.push_back(LanguageDifference::CreateRemoveWord(places[0], section, ints[0]));
+            break;
+        case LanguageDifferenceType::CopyLanguage:
+            differences.push_back(LanguageDifference::CreateCopyLanguage(places[0], places[1], section));
+            break;
+        }
+    }
+
+    Map = std::move(map);
+    PhoneticsMap = std::move(phoneticsMap);
+    Graph = std::move(graph);
+    BaseDifference.reset();
+    languageDifference = std::move(differences);
+    return true;
+}
@@ -0,0 +1,422 @@
+#pragma once
+#include "Language.h"
+#include "Binary.h"
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <thread>
+
+/**
+ * @brief 差分の出力先
+ *
+ * @note LanguageSystem::Sink に設定すると、差分が記録されるたびに Write が呼ばれる。
+ */
+class DifferenceSink
+{
+public:
+    virtual ~DifferenceSink() = default;
+
+    /**
+     * @brief 差分を1つ書き込む
+     *
+     * @param diff 差分
+     */
+    virtual void Write(const LanguageDifference &diff) = 0;
+
+    /**
+     * @brief 時代の終わりを知らせる
+     *
+     * @param system 時代の終わりの語族
+     *
+     * @note LanguageSystem::ToNextSection が時代を進める前に呼ぶ。
+     */
+    virtual void EndSection(const LanguageSystem &/*system*/) {}
+
+    /**
+     * @brief 残りを書き出して閉じる
+     *
+     * @return すべて書き込めたら true
+     */
+    virtual bool Close() = 0;
+
+    /**
+     * @brief 書き込んだ差分のうち、言語の広がりを表すもの（最初の AddWord と CopyLanguage、古い順）
+     *
+     * @note 差分をメモリに溜めない場合に、書き出したログを読み直さずに buildSpreadTree に渡すため。
+     */
+    const std::vector<LanguageDifference> &SpreadDifferences() const { return spreadDifferences; }
+
+    /**
+     * @brief 書き込んだ差分の最後の時代（まだ書き込んでいなければ 0）
+     */
+    int LastSection() const { return lastSection; }
+
+protected:
+    /**
+     * @brief 書き込む差分を見て、言語の広がりを表すものなら覚える
+     *
+     * @param diff 差分
+     */
+    void trackSpread(const LanguageDifference &diff);
+
+private:
+    std::vector<LanguageDifference> spreadDifferences;
+    bool hasRoot = false;
+    int lastSection = 0;
+};
+
+/**
+ * @brief 固定長のチャンクに溜めて別スレッドで書き出すファイル
+ *
+ * @note 書き出し待ちのチャンクが MAX_PENDING_CHUNKS 個を超えると、書き出しが追いつくまで Append が待つ。
+ */
+class ChunkedFileWriter
+{
+public:
+    // チャンクのバイト数
+    static constexpr size_t CHUNK_SIZE = 1 << 20;
+    // 書き出し待ちのチャンクの最大数
+    static constexpr size_t MAX_PENDING_CHUNKS = 4;
+
+    ChunkedFileWriter() = default;
+    ChunkedFileWriter(const ChunkedFileWriter &) = delete;
+    ChunkedFileWriter &operator=(const ChunkedFileWriter &) = delete;
+    ~ChunkedFileWriter();
+
+    /**
+     * @brief ファイルを開き、書き出しスレッドを起動する
+     *
+     * @param filename ファイルパス
+     * @param isBinary バイナリモードで開くか（false ならテキストモード）
+     * @return 成功したら true
+     */
+    bool Open(const std::string &filename, const bool isBinary);
+
+    /**
+     * @brief 追記する
+     *
+     */
+    void Append(const char *data, const size_t size);
+    void Append(std::string_view str) { Append(str.data(), str.size()); }
+
+    /**
+     * @brief 残りを書き出して閉じる
+     *
+     * @return すべて書き込めたら true
+     */
+    bool Close();
+
+    bool IsOpen() const { return file != nullptr; }
+
+    /**
+     * @brief 追記したバイト数の合計
+     *
+     */
+    uint64_t Size() const { return size; }
+
+private:
+    void flushChunk();
+    void run();
+
+    std::FILE *file = nullptr;
+    uint64_t size = 0;
+    std::vector<char> chunk;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<std::vector<char>> pending;
+    std::vector<std::vector<char>> freeChunks;
+    bool closing = false;
+    bool failed = false;
+};
+
+/**
+ * @brief 差分ログ（YAML）を逐次書き出す
+ *
+ * @note 書式は LanguageSystem::Export と同じ。
+ * @note std::to_chars で整形し、ChunkedFileWriter で書き出す。
+ */
+class DifferenceLogWriter : public DifferenceSink
+{
+public:
+    /**
+     * @brief ファイルを開き、地図・音素表・差分の見出しを書き込む
+     *
+     * @param filename ファイルパス
+     * @param system 語族（地図・地理・音素表を使う）
+     * @return 成功したら true
+     */
+    bool Open(const std::string &filename, const LanguageSystem &system);
+
+    void Write(const LanguageDifference &diff) override;
+
+    bool Close() override;
+
+private:
+    void appendInt(long long value);
+    void appendDouble(double value);
+    void appendTable(const std::vector<std::vector<std::string>> &table);
+
+    ChunkedFileWriter output;
+    std::vector<std::string> places;
+};
+
+/**
+ * @brief 差分の固定長レコード（バイナリログ・スナップショット共通）
+ *
+ * @note LanguageDifference と同じ24バイト。Data は共用体の中身で、可変長データを持つタイプでは形式ごとに意味が異なる。
+ */
+struct DifferenceRecord
+{
+    uint8_t Type;
+    uint8_t SoundCondition;
+    uint8_t SoundIsRemove;
+    uint8_t PartCount;
+    int32_t Section;
+    int32_t Place;
+    int32_t WordID;
+    uint64_t Data;
+
+    /**
+     * @brief 差分から作る（可変長データを持つタイプでは Data は 0）
+     *
+     */
+    static DifferenceRecord Create(const LanguageDifference &diff);
+
+    /**
+     * @brief 固定長部分を差分に戻す（可変長データは設定しない）
+     *
+     * @param places 場所の数（範囲外の場所を弾く）
+     * @param diff 戻し先
+     * @return 値が正しければ true
+     */
+    bool Restore(const size_t places, LanguageDifference &diff) const;
+};
+static_assert(sizeof(DifferenceRecord) == 24);
+
+/**
+ * @brief バイナリログのレコードの参照（コピーなし）
+ *
+ */
+struct DifferenceRecordView
+{
+    // ファイル内のバイト位置
+    uint64_t Offset = 0;
+    // 固定長部分
+    const DifferenceRecord *Record = nullptr;
+    // 語形（AddWord）
+    std::string_view WordForm;
+    // 意味の数（AddWord, ChangeMeaning）
+    uint32_t MeaningCount = 0;
+    // 意味の符号化データ
+    std::span<const char> Meanings;
+    // ログの場所の数（場所IDの検査に使う）
+    size_t PlaceCount = 0;
+
+    /**
+     * @brief 意味を順に走査する
+     *
+     * @param func (キー, 値) ごとに呼ぶ関数
+     * @return 意味がすべて読めたら true
+     */
+    bool ForEachMeaning(const std::function<void(std::string_view, double)> &func) const;
+
+    /**
+     * @brief 差分に変換する
+     *
+     * @return 差分（レコードが壊れていたら std::nullopt）
+     */
+    std::optional<LanguageDifference> ToDifference() const;
+};
+
+/**
+ * @brief バイナリログの時代の索引
+ *
+ */
+struct DifferenceLogSection
+{
+    // 時代
+    int32_t Section;
+    uint32_t Padding;
+    // 最初のレコードのバイト位置
+    uint64_t Offset;
+    // レコード数
+    uint64_t Count;
+};
+
+/**
+ * @brief バイナリログのキーフレームの索引
+ *
+ */
+struct DifferenceLogKeyframe
+{
+    // 時代（この時代の差分まで適用した状態）
+    int32_t Section;
+    uint32_t Padding;
+    // スナップショットのバイト位置
+    uint64_t Offset;
+    // スナップショットのバイト数
+    uint64_t Size;
+};
+
+/**
+ * @brief 差分ログ（バイナリ）を逐次書き出す
+ *
+ * @note 形式: ヘッダー、メタデータ（地図・音素表・地理）、レコード列、時代の索引、キーフレームの索引、フッター。
+ * @note レコードは DifferenceRecord で、AddWord と ChangeMeaning の直後には可変長データが続く（Data はそのバイト数）。
+ * @note 時代は古い順に記録されることを前提に、時代が変わるたびに索引を追加する。
+ * @note 時代の終わりには、その時点の全状態（差分なしのスナップショット）をキーフレームとしてレコード列の間に書くことがある。
+ */
+class BinaryDifferenceLogWriter : public DifferenceSink
+{
+public:
+    // キーフレームの間隔（時代数）。0 なら差分のバイト数から決め、負なら書かない
+    int KeyframeInterval = 0;
+    // 前のキーフレームからの差分がキーフレームの何倍になったら次を書くか（KeyframeInterval が 0 のとき）
+    double KeyframeRatio = 1.0;
+
+    /**
+     * @brief ファイルを開き、メタデータを書き込む
+     *
+     * @param filename ファイルパス
+     * @param system 語族（地図・地理・音素表を使う）
+     * @return 成功したら true
+     */
+    bool Open(const std::string &filename, const LanguageSystem &system);
+
+    void Write(const LanguageDifference &diff) override;
+
+    void EndSection(const LanguageSystem &system) override;
+
+    /**
+     * @brief キーフレームを書き込む
+     *
+     * @param section 時代（この時代の差分をすべて書いた後に呼ぶ）
+     * @param snapshot 差分を含まないスナップショット（encodeSnapshot）
+     */
+    void WriteKeyframe(const int section, std::span<const char> snapshot);
+
+    bool Close() override;
+
+private:
+    ChunkedFileWriter output;
+    std::vector<char> payload;
+    std::vector<DifferenceLogSection> sections;
+    std::vector<DifferenceLogKeyframe> keyframes;
+    // 最後のキーフレームの終わりのバイト位置
+    uint64_t keyframeEnd = 0;
+    uint64_t recordsBegin = 0;
+    uint64_t recordCount = 0;
+};
+
+/**
+ * @brief 差分ログ（バイナリ）の読み込み
+ *
+ * @note ファイルをメモリマップし、レコードはコピーせずに参照する。
+ */
+class BinaryDifferenceLog
+{
+public:
+    // 地図
+    std::vector<std::vector<std::string>> Map;
+    // 音素表
+    std::vector<std::vector<std::string>> PhoneticsMap;
+    // 地理（場所と辺のみ）
+    Geography Graph;
+
+    /**
+     * @brief ファイルがバイナリログか
+     *
+     */
+    static bool IsBinaryLog(const std::string &filename);
+
+    /**
+     * @brief ファイルを開く
+     *
+     * @param filename ファイルパス
+     * @return 成功したら true
+     */
+    bool Open(const std::string &filename);
+
+    /**
+     * @brief レコードの総数
+     *
+     */
+    uint64_t RecordCount() const { return recordCount; }
+
+    /**
+     * @brief 記録されている時代（古い順）
+     *
+     */
+    std::vector<int> Sections() const;
+
+    /**
+     * @brief キーフレームのある時代（古い順）
+     *
+     */
+    std::vector<int> KeyframeSections() const;
+
+    /**
+     * @brief キーフレームのスナップショット
+     *
+     * @param index キーフレームの番号（KeyframeSections と同じ順）
+     */
+    std::span<const char> Keyframe(const size_t index) const;
+
+    /**
+     * @brief すべてのレコードを古い順に走査する
+     *
+     * @param func レコードごとに呼ぶ関数
+     * @return ファイルが壊れていなければ true
+     */
+    bool ForEachRecord(const std::function<void(const DifferenceRecordView &)> &func) const;
+
+    /**
+     * @brief 時代の範囲のレコードを走査する
+     *
+     * @param firstSection 最初の時代
+     * @param lastSection 最後の時代（含む）
+     * @param func レコードごとに呼ぶ関数
+     * @return ファイルが壊れていなければ true
+     *
+     * @note 索引から開始位置を二分探索するため、途中の時代から直接読み始められる。
+     */
+    bool ForEachRecord(const int firstSection, const int lastSection, const std::function<void(const DifferenceRecordView &)> &func) const;
+
+    /**
+     * @brief ある時代の終わりの語族を復元する
+     *
+     * @param section 時代
+     * @param system 復元先
+     * @return 成功したら true（失敗したら復元先は変更しない）
+     *
+     * @note その時代以前で最も新しいキーフレームを読み込み、残りの時代の差分だけを再生する。
+     * @note 復元先の差分（languageDifference）は空になる。
+     */
+    bool Reconstruct(const int section, LanguageSystem &system) const;
+
+    /**
+     * @brief バイト位置を指定してレコードを1つ読む
+     *
+     * @param offset バイト位置（DifferenceRecordView::Offset）
+     * @param view 読み込み先
+     * @return 正しいレコードなら true
+     */
+    bool ReadRecord(const uint64_t offset, DifferenceRecordView &view) const;
+
+private:
+    bool readRecords(uint64_t offset, uint64_t count, const std::function<void(const DifferenceRecordView &)> &func) const;
+
+    MappedFile file;
+    std::span<const DifferenceLogSection> sections;
+    std::span<const DifferenceLogKeyframe> keyframes;
+    uint64_t recordsBegin = 0;
+    uint64_t recordsEnd = 0;
+    uint64_t recordCount = 0;
+};
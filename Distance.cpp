@@ -0,0 +1,443 @@
+#include "Distance.h"
+#include "Binary.h"
+#include "Profile.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <unordered_map>
+
+namespace
+{
+    constexpr char DISTANCE_MAGIC[8] = {'T', 'P', 'D', 'I', 'S', 'T', '\0', '\0'};
+    constexpr uint32_t DISTANCE_VERSION = 1;
+    // タイルの一辺の場所の数
+    constexpr size_t TILE_SIZE = 32;
+    // まとめて比較する単語の数
+    constexpr size_t LANES = 4;
+    // ビット並列で扱える単語の長さ
+    constexpr size_t MAX_BIT_LENGTH = 64;
+    // 単語がないことを表す長さ
+    constexpr uint32_t NO_WORD = std::numeric_limits<uint32_t>::max();
+
+    // ヘッダー（ファイル先頭）
+    struct DistanceHeader
+    {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t Count;
+        // 文字列表
+        BinaryBlock StringOffsets;
+        BinaryBlock StringChars;
+        // 場所（場所名の文字列番号）
+        BinaryBlock Places;
+        // 距離（行優先）
+        BinaryBlock Values;
+    };
+
+#if defined(__GNUC__)
+    // 単語ごとのビット列を並べたベクトル（ベクトル命令が使えればそのまま1命令になる）
+    typedef uint64_t LaneBits __attribute__((vector_size(LANES * sizeof(uint64_t))));
+#endif
+
+    // 言語ごと・祖語の単語ごとの派生語（音素を番号に置き換えたもの）
+    struct CognateTable
+    {
+        size_t Groups = 0;
+        // 音素の種類の数
+        size_t Alphabet = 0;
+        std::vector<uint16_t> Symbols;
+        // (言語, 祖語の単語) ごとの Symbols 内の始まりの位置と長さ（なければ NO_WORD）
+        std::vector<uint32_t> Begins;
+        std::vector<uint32_t> Lengths;
+
+        const uint16_t *Word(const size_t language, const size_t group) const
+        {
+            return Symbols.data() + Begins[language * Groups + group];
+        }
+
+        uint32_t Length(const size_t language, const size_t group) const
+        {
+            return Lengths[language * Groups + group];
+        }
+    };
+
+    // 音素列のハッシュ
+    struct SoundsHash
+    {
+        size_t operator()(const std::vector<Phonetics> &sounds) const
+        {
+            size_t hash = sounds.size();
+            for (const auto &sound : sounds)
+            {
+                hash = hash * 1000003u ^ ((size_t)(uint32_t)sound.Mannar << 16 ^ (uint32_t)sound.Place);
+            }
+            return hash;
+        }
+    };
+
+    CognateTable createCognateTable(const LanguageSystem &system, const std::vector<const Language *> &languages)
+    {
+        CognateTable table;
+        std::unordered_map<std::vector<Phonetics>, uint32_t, SoundsHash> groups;
+        for (const auto &[_, word] : system.ProtoLanguage.Words)
+        {
+            groups.emplace(word.Sounds, (uint32_t)groups.size());
+        }
+        table.Groups = groups.size();
+        table.Begins.assign(languages.size() * table.Groups, 0);
+        table.Lengths.assign(languages.size() * table.Groups, NO_WORD);
+
+        std::unordered_map<uint64_t, uint16_t> symbols;
+        for (size_t i = 0; i < languages.size(); ++i)
+        {
+            for (const auto &[_, word] : languages[i]->Words)
+            {
+                auto it = groups.find(word.NearestProtoWord);
+                if (it == groups.end())
+                    continue;
+                const size_t index = i * table.Groups + it->second;
+                // 単語ID が最も小さいものを使う
+                if (table.Lengths[index] != NO_WORD)
+                    continue;
+                table.Begins[index] = (uint32_t)table.Symbols.size();
+                table.Lengths[index] = (uint32_t)word.Sounds.size();
+                for (const auto &sound : word.Sounds)
+                {
+                    const uint64_t key = (uint64_t)(uint32_t)sound.Mannar << 32 | (uint32_t)sound.Place;
+                    table.Symbols.push_back(symbols.emplace(key, (uint16_t)symbols.size()).first->second);
+                }
+            }
+        }
+        table.Alphabet = symbols.size();
+        return table;
+    }
+
+    // 動的計画法による編集距離（長い単語用）
+    template <typename T>
+    int getEditDistanceByTable(const T *a, const size_t m, const T *b, const size_t n)
+    {
+        std::vector<int> row(n + 1);
+        for (size_t j = 0; j <= n; ++j)
+        {
+            row[j] = (int)j;
+        }
+        for (size_t i = 1; i <= m; ++i)
+        {
+            int diagonal = row[0];
+            row[0] = (int)i;
+            for (size_t j = 1; j <= n; ++j)
+            {
+                const int above = row[j];
+                row[j] = std::min({above + 1, row[j - 1] + 1, diagonal + (a[i - 1] == b[j - 1] ? 0 : 1)});
+                diagonal = above;
+            }
+        }
+        return row[n];
+    }
+
+    // ビット並列による編集距離（パターンは1〜64音素、peq は音素ごとのパターン内の位置のビット列）
+    int getEditDistanceByBits(const uint64_t *peq, const size_t m, const uint16_t *text, const size_t n)
+    {
+        const uint64_t last = 1ull << (m - 1);
+        uint64_t pv = ~0ull, mv = 0;
+        int score = (int)m;
+        for (size_t j = 0; j < n; ++j)
+        {
+            const uint64_t eq = peq[text[j]];
+            const uint64_t xv = eq | mv;
+            const uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+            uint64_t ph = mv | ~(xh | pv);
+            uint64_t mh = pv & xh;
+            score += (ph & last) != 0;
+            score -= (mh & last) != 0;
+            ph = (ph << 1) | 1;
+            mh <<= 1;
+            pv = mh | ~(xv | ph);
+            mv = ph & xv;
+        }
+        return score;
+    }
+
+    // 1つのパターンと LANES 個の単語の編集距離をまとめて求める
+    void getEditDistancesByBits(const uint64_t *peq, const size_t m, const uint16_t *const *texts, const uint32_t *lengths, const size_t count, int *scores)
+    {
+#if defined(__GNUC__)
+        const uint64_t last = 1ull << (m - 1);
+        LaneBits pv = ~LaneBits{}, mv = {}, score = {}, active;
+        uint32_t maxLength = 0;
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            score[l] = m;
+            maxLength = std::max(maxLength, l < count ? lengths[l] : 0);
+        }
+        for (uint32_t j = 0; j < maxLength; ++j)
+        {
+            // 単語の長さを過ぎたレーンは状態を変えない
+            LaneBits eq;
+            for (size_t l = 0; l < LANES; ++l)
+            {
+                const bool isActive = l < count && j < lengths[l];
+                eq[l] = isActive ? peq[texts[l][j]] : 0;
+                active[l] = isActive ? ~0ull : 0;
+            }
+            const LaneBits xv = eq | mv;
+            const LaneBits xh = (((eq & pv) + pv) ^ pv) | eq;
+            LaneBits ph = mv | ~(xh | pv);
+            LaneBits mh = pv & xh;
+            score += ((ph & last) >> (m - 1)) & active;
+            score -= ((mh & last) >> (m - 1)) & active;
+            ph = (ph << 1) | 1;
+            mh <<= 1;
+            pv = ((mh | ~(xv | ph)) & active) | (pv & ~active);
+            mv = ((ph & xv) & active) | (mv & ~active);
+        }
+        for (size_t l = 0; l < count; ++l)
+        {
+            scores[l] = (int)score[l];
+        }
+#else
+        for (size_t l = 0; l < count; ++l)
+        {
+            scores[l] = getEditDistanceByBits(peq, m, texts[l], lengths[l]);
+        }
+#endif
+    }
+
+    // タイル（行の場所の範囲 × 列の場所の範囲）の距離を求める
+    void computeTile(const CognateTable &table, const size_t rowBegin, const size_t rowEnd, const size_t columnBegin, const size_t columnEnd, std::vector<uint64_t> &peq, std::vector<double> &values, const size_t size)
+    {
+        const size_t width = columnEnd - columnBegin;
+        std::vector<double> sums((rowEnd - rowBegin) * width, 0.0);
+        std::vector<uint32_t> counts((rowEnd - rowBegin) * width, 0);
+        const uint16_t *texts[LANES];
+        uint32_t lengths[LANES];
+        size_t columns[LANES];
+        int scores[LANES];
+
+        for (size_t i = rowBegin; i < rowEnd; ++i)
+        {
+            double *sumRow = sums.data() + (i - rowBegin) * width;
+            uint32_t *countRow = counts.data() + (i - rowBegin) * width;
+            const size_t first = std::max(columnBegin, i + 1);
+            for (size_t g = 0; g < table.Groups; ++g)
+            {
+                const uint32_t m = table.Length(i, g);
+                if (m == NO_WORD)
+                    continue;
+                const uint16_t *pattern = table.Word(i, g);
+                const bool isBitParallel = m > 0 && m <= MAX_BIT_LENGTH;
+                if (isBitParallel)
+                {
+                    for (uint32_t k = 0; k < m; ++k)
+                    {
+                        peq[pattern[k]] |= 1ull << k;
+                    }
+                }
+
+                // 同じ祖語の単語の派生語がある列を LANES 個ずつまとめて比較する
+                auto flush = [&](const size_t count)
+                {
+                    if (isBitParallel)
+                        getEditDistancesByBits(peq.data(), m, texts, lengths, count, scores);
+                    else
+                    {
+                        for (size_t l = 0; l < count; ++l)
+                        {
+                            scores[l] = getEditDistanceByTable(pattern, m, texts[l], lengths[l]);
+                        }
+                    }
+                    for (size_t l = 0; l < count; ++l)
+                    {
+                        const uint32_t longer = std::max(m, lengths[l]);
+                        sumRow[columns[l] - columnBegin] += longer == 0 ? 0.0 : (double)scores[l] / longer;
+                        countRow[columns[l] - columnBegin]++;
+                    }
+                };
+                size_t count = 0;
+                for (size_t j = first; j < columnEnd; ++j)
+                {
+                    const uint32_t n = table.Length(j, g);
+                    if (n == NO_WORD)
+                        continue;
+                    texts[count] = table.Word(j, g);
+                    lengths[count] = n;
+                    columns[count] = j;
+                    if (++count == LANES)
+                    {
+                        flush(count);
+                        count = 0;
+                    }
+                }
+                if (count > 0)
+                    flush(count);
+
+                if (isBitParallel)
+                {
+                    for (uint32_t k = 0; k < m; ++k)
+                    {
+                        peq[pattern[k]] = 0;
+                    }
+                }
+            }
+            for (size_t j = first; j < columnEnd; ++j)
+            {
+                const size_t c = j - columnBegin;
+                const double value = countRow[c] == 0 ? std::numeric_limits<double>::quiet_NaN() : sumRow[c] / countRow[c];
+                values[i * size + j] = value;
+                values[j * size + i] = value;
+            }
+        }
+    }
+}
+
+int getEditDistance(std::span<const Phonetics> a, std::span<const Phonetics> b)
+{
+    if (a.empty() || a.size() > MAX_BIT_LENGTH)
+        return getEditDistanceByTable(a.data(), a.size(), b.data(), b.size());
+
+    // パターンに現れる音素だけに番号を振る（それ以外は番号 0 でどこにも一致しない）
+    std::vector<Phonetics> alphabet;
+    std::vector<uint64_t> peq(1, 0);
+    auto symbolOf = [&](const Phonetics &sound)
+    {
+        auto it = std::find(alphabet.begin(), alphabet.end(), sound);
+        return it == alphabet.end() ? 0 : (uint16_t)(it - alphabet.begin() + 1);
+    };
+    for (size_t k = 0; k < a.size(); ++k)
+    {
+        uint16_t symbol = symbolOf(a[k]);
+        if (symbol == 0)
+        {
+            alphabet.push_back(a[k]);
+            peq.push_back(0);
+            symbol = (uint16_t)alphabet.size();
+        }
+        peq[symbol] |= 1ull << k;
+    }
+    std::vector<uint16_t> text(b.size());
+    for (size_t j = 0; j < b.size(); ++j)
+    {
+        text[j] = symbolOf(b[j]);
+    }
+    return getEditDistanceByBits(peq.data(), a.size(), text.data(), text.size());
+}
+
+DistanceMatrix computeDistanceMatrix(const LanguageSystem &system, unsigned int threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    DistanceMatrix result;
+    std::vector<const Language *> languages;
+    for (const auto &[place, language] : system.LanguageMap)
+    {
+        result.Places.push_back(place);
+        languages.push_back(&language);
+    }
+    const size_t size = languages.size();
+    const CognateTable table = createCognateTable(system, languages);
+
+    // 対角は、比べる単語があれば 0
+    result.Values.assign(size * size, std::numeric_limits<double>::quiet_NaN());
+    for (size_t i = 0; i < size; ++i)
+    {
+        for (size_t g = 0; g < table.Groups; ++g)
+        {
+            if (table.Length(i, g) != NO_WORD)
+            {
+                result.Values[i * size + i] = 0.0;
+                break;
+            }
+        }
+    }
+
+    // 上三角のタイルを順に取って計算する
+    const size_t tiles = (size + TILE_SIZE - 1) / TILE_SIZE;
+    std::vector<std::pair<size_t, size_t>> tilePairs;
+    for (size_t ti = 0; ti < tiles; ++ti)
+    {
+        for (size_t tj = ti; tj < tiles; ++tj)
+        {
+            tilePairs.emplace_back(ti, tj);
+        }
+    }
+    std::atomic<size_t> next = 0;
+    auto run = [&]()
+    {
+        ProfileScope profile(ProfileStage::Worker);
+        std::vector<uint64_t> peq(table.Alphabet, 0);
+        for (size_t k = next++; k < tilePairs.size(); k = next++)
+        {
+            const auto [ti, tj] = tilePairs[k];
+            computeTile(table, ti * TILE_SIZE, std::min(size, (ti + 1) * TILE_SIZE), tj * TILE_SIZE, std::min(size, (tj + 1) * TILE_SIZE), peq, result.Values, size);
+        }
+    };
+    std::vector<std::thread> threads;
+    const size_t threadTotal = std::min<size_t>(threadCount, tilePairs.size());
+    for (size_t i = 1; i < threadTotal; ++i)
+    {
+        threads.emplace_back(run);
+    }
+    run();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    return result;
+}
+
+bool DistanceMatrix::ExportCSV(const std::string &filename) const
+{
+    std::ofstream file(filename.c_str());
+    if (!file.is_open())
+    {
+        std::cerr << "Error: ファイルを開けませんでした: " << filename << std::endl;
+        return false;
+    }
+    for (const auto &place : Places)
+    {
+        file << "," << place;
+    }
+    file << "\n";
+    for (size_t i = 0; i < Places.size(); ++i)
+    {
+        file << Places[i];
+        for (size_t j = 0; j < Places.size(); ++j)
+        {
+            // 比べられない組は空欄
+            file << ",";
+            if (!std::isnan(At(i, j)))
+                file << At(i, j);
+        }
+        file << "\n";
+    }
+    return true;
+}
+
+bool DistanceMatrix::ExportBinary(const std::string &filename) const
+{
+    BinaryWriter writer;
+    BinaryStringTable strings;
+    DistanceHeader header{};
+    std::memcpy(header.Magic, DISTANCE_MAGIC, sizeof(DISTANCE_MAGIC));
+    header.Version = DISTANCE_VERSION;
+    header.Count = (uint32_t)Places.size();
+    writer.Write(header);
+
+    std::vector<uint32_t> places;
+    places.reserve(Places.size());
+    for (const auto &place : Places)
+    {
+        places.push_back(strings.Add(place));
+    }
+    header.Places = writer.WriteBlock(places);
+    header.Values = writer.WriteBlock(Values);
+    strings.Write(writer, header.StringOffsets, header.StringChars);
+    writer.Align();
+    writer.Overwrite(0, header);
+    return writeBinaryFile(filename, writer.Buffer.data(), writer.Buffer.size());
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "Language.h"
+
+/**
+ * @brief 言語間の距離行列
+ *
+ */
+struct DistanceMatrix
+{
+    // 場所（行・列の順）
+    std::vector<std::string> Places;
+    // 距離（行優先、Places.size() × Places.size()、共通の同源語がなければ NaN）
+    std::vector<double> Values;
+
+    size_t Size() const { return Places.size(); }
+    double At(const size_t row, const size_t column) const { return Values[row * Places.size() + column]; }
+
+    /**
+     * @brief CSV に出力する
+     *
+     * @param filename 出力ファイル名
+     * @return 成功したら true
+     *
+     * @note 1行目と1列目が場所名。
+     */
+    bool ExportCSV(const std::string &filename) const;
+
+    /**
+     * @brief バイナリに出力する
+     *
+     * @param filename 出力ファイル名
+     * @return 成功したら true
+     *
+     * @note ヘッダー・場所名の文字列表・距離（double の行優先の配列）を8バイト境界に揃えて並べる（そのままマップして読める）。
+     */
+    bool ExportBinary(const std::string &filename) const;
+};
+
+/**
+ * @brief 2つの音素列の編集距離
+ *
+ * @param a 音素列
+ * @param b 音素列
+ * @return 挿入・削除・置換を1とした編集距離
+ */
+int getEditDistance(std::span<const Phonetics> a, std::span<const Phonetics> b);
+
+/**
+ * @brief 言語間の距離行列を求める
+ *
+ * @param system 語族
+ * @param threadCount スレッド数（0 ならハードウェアのスレッド数）
+ * @return 距離行列（場所は LanguageMap の順）
+ *
+ * @note 距離は、同じ祖語の単語（NearestProtoWord の音素列が同じ）から派生した単語どうしの、正規化した編集距離（長い方の長さで割る）の平均。
+ * @note 1つの祖語の単語から複数の派生語がある言語では、単語ID が最も小さいものを使う。
+ * @note 編集距離はビット並列（Myers/Hyyrö）で求め、1つの単語を4つの言語の単語とまとめて比較する（ベクトル命令が使えればそれで計算する）。
+ * @note 場所の組をタイルに分け、スレッドが順に取って計算する。
+ */
+DistanceMatrix computeDistanceMatrix(const LanguageSystem &system, unsigned int threadCount = 0);
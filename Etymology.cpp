@@ -0,0 +1,207 @@
+#include "Etymology.h"
+#include "DifferenceLog.h"
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+namespace
+{
+    // 由来をたどる必要のある単語の状態
+    enum EtymologyNeed : uint8_t
+    {
+        SoundsNeeded = 1,
+        MeaningsNeeded = 2,
+    };
+}
+
+std::optional<EtymologyIndex> EtymologyIndex::Build(std::shared_ptr<const BinaryDifferenceLog> log)
+{
+    EtymologyIndex index;
+    bool isValid = true;
+    if (log == nullptr || !log->ForEachRecord([&](const DifferenceRecordView &view)
+                           {
+                               const auto diff = view.ToDifference();
+                               if (diff)
+                                   index.add(view.Offset, *diff);
+                               else
+                                   isValid = false; }) ||
+        !isValid)
+    {
+        std::cerr << "Error: 差分ログが壊れています" << std::endl;
+        return std::nullopt;
+    }
+    index.read = [log = std::move(log)](const uint64_t position)
+    {
+        DifferenceRecordView view;
+        std::optional<LanguageDifference> diff;
+        if (log->ReadRecord(position, view))
+            diff = view.ToDifference();
+        return diff ? std::move(*diff) : LanguageDifference();
+    };
+    return index;
+}
+
+EtymologyIndex EtymologyIndex::Build(std::shared_ptr<const std::vector<LanguageDifference>> diffs)
+{
+    EtymologyIndex index;
+    if (diffs == nullptr)
+        diffs = std::make_shared<const std::vector<LanguageDifference>>();
+    for (size_t i = 0; i < diffs->size(); ++i)
+    {
+        index.add(i, (*diffs)[i]);
+    }
+    index.read = [diffs = std::move(diffs)](const uint64_t position)
+    { return (*diffs)[position]; };
+    return index;
+}
+
+std::optional<Etymology> EtymologyIndex::Query(const int place, const int wordID) const
+{
+    auto etymology = query(place, wordID, std::numeric_limits<uint64_t>::max(), SoundsNeeded | MeaningsNeeded);
+    if (etymology.Steps.empty())
+        return std::nullopt;
+    return etymology;
+}
+
+std::vector<uint64_t> EtymologyIndex::Positions(const int place, const int wordID) const
+{
+    std::vector<uint64_t> positions;
+    auto it = entries.find(key(place, wordID));
+    if (it == entries.end())
+        return positions;
+    positions.reserve(it->second.size());
+    for (const auto &entry : it->second)
+    {
+        if (positions.empty() || positions.back() != entry.Position)
+            positions.push_back(entry.Position);
+    }
+    return positions;
+}
+
+uint64_t EtymologyIndex::key(const int place, const int wordID)
+{
+    return ((uint64_t)(uint32_t)place << 32) | (uint32_t)wordID;
+}
+
+void EtymologyIndex::add(const uint64_t position, const LanguageDifference &diff)
+{
+    switch (diff.Type)
+    {
+    case LanguageDifferenceType::ChangeStrength:
+        break;
+    case LanguageDifferenceType::CopyLanguage:
+        copies[diff.Place].push_back({position, diff.Source.Place});
+        break;
+    case LanguageDifferenceType::BorrowWord:
+        entries[key(diff.Place, diff.WordID)].push_back({position, true});
+        entries[key(diff.Source.Place, diff.Source.WordID)].push_back({position, false});
+        break;
+    case LanguageDifferenceType::AddCompoundWord:
+        entries[key(diff.Place, diff.WordID)].push_back({position, true});
+        for (int p = 0; p < diff.PartCount; ++p)
+        {
+            entries[key(diff.Place, diff.Parts[p])].push_back({position, false});
+        }
+        break;
+    default:
+        entries[key(diff.Place, diff.WordID)].push_back({position, true});
+        break;
+    }
+}
+
+Etymology EtymologyIndex::query(const int place, const int wordID, const uint64_t before, uint8_t needs) const
+{
+    Etymology etymology;
+    etymology.Place = place;
+    etymology.WordID = wordID;
+
+    // それより前の語彙は置き換えられているので、最後の複写より後だけを見る
+    const Copy *copy = nullptr;
+    auto itCopies = copies.find(place);
+    if (itCopies != copies.end())
+    {
+        const auto &list = itCopies->second;
+        auto it = std::lower_bound(list.begin(), list.end(), before, [](const Copy &c, const uint64_t position)
+                                   { return c.Position < position; });
+        if (it != list.begin())
+            copy = &*std::prev(it);
+    }
+
+    // 新しい方からたどり、まだ由来の分かっていない状態を書いた差分だけを拾って、単語が作られた差分で止める
+    bool isCreated = false;
+    auto itEntries = entries.find(key(place, wordID));
+    if (itEntries != entries.end())
+    {
+        const auto &list = itEntries->second;
+        auto end = std::lower_bound(list.begin(), list.end(), before, [](const Entry &e, const uint64_t position)
+                                    { return e.Position < position; });
+        for (auto it = end; it != list.begin() && !isCreated;)
+        {
+            --it;
+            if (copy != nullptr && it->Position < copy->Position)
+                break;
+            if (!it->IsTarget)
+                continue;
+            EtymologyStep step;
+            step.Position = it->Position;
+            step.Difference = read(it->Position);
+            switch (step.Difference.Type)
+            {
+            case LanguageDifferenceType::AddWord:
+                isCreated = true;
+                break;
+            case LanguageDifferenceType::AddCompoundWord:
+                isCreated = true;
+                for (int p = 0; p < step.Difference.PartCount; ++p)
+                {
+                    // 参照単語がなかったら飛ばされている
+                    auto part = query(place, step.Difference.Parts[p], it->Position, SoundsNeeded | MeaningsNeeded);
+                    if (!part.Steps.empty())
+                        step.Sources.push_back(std::move(part));
+                }
+                break;
+            case LanguageDifferenceType::ChangeSound:
+                if ((needs & SoundsNeeded) == 0)
+                    continue;
+                break;
+            case LanguageDifferenceType::ChangeMeaning:
+                if ((needs & MeaningsNeeded) == 0)
+                    continue;
+                needs &= ~MeaningsNeeded;
+                break;
+            case LanguageDifferenceType::BorrowWord:
+            {
+                if ((needs & SoundsNeeded) == 0)
+                    continue;
+                // 借用元がなかった借用は何もしていない
+                auto source = query(step.Difference.Source.Place, step.Difference.Source.WordID, it->Position, SoundsNeeded);
+                if (source.Steps.empty())
+                    continue;
+                step.Sources.push_back(std::move(source));
+                needs &= ~SoundsNeeded;
+                break;
+            }
+            default:
+                continue;
+            }
+            etymology.Steps.push_back(std::move(step));
+        }
+    }
+
+    // この場所で作られていなければ、複写元の語源を続ける
+    if (!isCreated && copy != nullptr)
+    {
+        auto source = query(copy->Source, wordID, copy->Position, needs);
+        if (!source.Steps.empty())
+        {
+            EtymologyStep step;
+            step.Position = copy->Position;
+            step.Difference = read(copy->Position);
+            step.Sources.push_back(std::move(source));
+            etymology.Steps.push_back(std::move(step));
+        }
+    }
+
+    std::reverse(etymology.Steps.begin(), etymology.Steps.end());
+    return etymology;
+}
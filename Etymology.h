@@ -0,0 +1,109 @@
+#pragma once
+#include "Language.h"
+#include <functional>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+
+class BinaryDifferenceLog;
+struct Etymology;
+
+/**
+ * @brief 語源の1段階（単語を書き換えた差分）
+ */
+struct EtymologyStep
+{
+    // 差分の位置（バイナリ形式の差分ログではバイト位置、差分の列では番号）
+    uint64_t Position = 0;
+    // 差分
+    LanguageDifference Difference;
+    // 由来の単語（借用元・複写元は1つ、複合語は参照単語の数）
+    std::vector<Etymology> Sources;
+};
+
+/**
+ * @brief 単語の語源（派生の木）
+ */
+struct Etymology
+{
+    // 場所ID
+    int Place = -1;
+    // 単語ID
+    int WordID = -1;
+    // この場所でこの単語の今の形を作った差分（古い順、最初は単語追加・複合語の追加・言語の複写のどれか）
+    std::vector<EtymologyStep> Steps;
+};
+
+/**
+ * @brief 差分の (場所, 単語) ごとの索引（全体を再生せずに語源を引く）
+ *
+ * @note 索引は差分の位置だけを持ち、問い合わせでは関係する差分だけを読む。
+ * @note 差分ログ・差分の列は索引と共有する（索引が生きている間は解放されない）。
+ */
+class EtymologyIndex
+{
+public:
+    /**
+     * @brief バイナリ形式の差分ログから索引を作る
+     *
+     * @param log 開いた差分ログ
+     * @return 索引（ログが壊れていたら std::nullopt）
+     */
+    static std::optional<EtymologyIndex> Build(std::shared_ptr<const BinaryDifferenceLog> log);
+
+    /**
+     * @brief 差分の列から索引を作る
+     *
+     * @param diffs 差分（古い順）
+     * @return 索引
+     */
+    static EtymologyIndex Build(std::shared_ptr<const std::vector<LanguageDifference>> diffs);
+
+    /**
+     * @brief 単語の語源を引く
+     *
+     * @param place 場所ID
+     * @param wordID 単語ID
+     * @return 最後の状態でのその単語の語源（その単語に関係する差分がなければ std::nullopt）
+     *
+     * @note 借用元・複合語の参照単語・複写元をたどり、それぞれ由来となった差分の時点までの語源を引く。
+     * @note 後の借用で上書きされた音韻変化・借用や、後の意味変化で上書きされた意味変化は含めない（今の音素列と意味に関わる差分だけを返す）。
+     */
+    std::optional<Etymology> Query(const int place, const int wordID) const;
+
+    /**
+     * @brief (場所, 単語) に触れた差分の位置
+     *
+     * @param place 場所ID
+     * @param wordID 単語ID
+     * @return 差分の位置（古い順、借用元・参照単語として読まれた差分も含む）
+     */
+    std::vector<uint64_t> Positions(const int place, const int wordID) const;
+
+private:
+    // 索引の要素
+    struct Entry
+    {
+        uint64_t Position;
+        // 単語を書き換えた（借用元・参照単語として読んだだけでない）か
+        bool IsTarget;
+    };
+
+    // 言語の複写
+    struct Copy
+    {
+        uint64_t Position;
+        int Source;
+    };
+
+    static uint64_t key(const int place, const int wordID);
+    void add(const uint64_t position, const LanguageDifference &diff);
+    Etymology query(const int place, const int wordID, const uint64_t before, uint8_t needs) const;
+
+    // (場所, 単語) ごとの差分（古い順）
+    std::unordered_map<uint64_t, std::vector<Entry>> entries;
+    // 複写先の場所ごとの言語の複写（古い順）
+    std::unordered_map<int, std::vector<Copy>> copies;
+    // 位置から差分を読む
+    std::function<LanguageDifference(uint64_t)> read;
+};
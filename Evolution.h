@@ -1,10 +1,119 @@
+#pragma once
 #include "Language.h"
+#include "DifferenceLog.h"
+#include "Compaction.h"
+#include "Distance.h"
+#include "Phylogeny.h"
+#include "Profile.h"
 #include <iostream>
 #include <map>
+#include <optional>
+#include <filesystem>
+#include <thread>
 
 #include <iostream>
 
-std::optional<LanguageSystem> evolution(
+/**
+ * @brief 言語変化のパラメータ
+ *
+ */
+struct EvolutionParameters
+{
+    // 世代あたりの系全体での借用回数
+    int NBorrow = 1;
+    // 1世代である言語が音韻変化を起こす確率
+    double PSoundChange = 0.0;
+    // 音韻変化を起こしたときに音素の脱落が起こる確率
+    double PSoundLoss = 0.0;
+    // 1世代である言語が意味変化を起こす確率
+    double PSemanticShift = 0.0;
+    // 意味の最大変化率
+    double MaxSemanticShiftRate = 0.0;
+    // 1世代である言語の単語が脱落する確率
+    double PWordLoss = 0.0;
+    // 1世代である言語の単語が生成される確率
+    double PWordBirth = 0.0;
+};
+
+/**
+ * @brief 1世代進める
+ *
+ * @param languageSystem 語族
+ * @param parameters パラメータ
+ */
+inline void stepEvolution(LanguageSystem &languageSystem, const EvolutionParameters &parameters)
+{
+    languageSystem.ToNextSection();
+    // 言語の影響度を変化させる。
+    languageSystem.ChangeLanguageStrength(1.0);
+    // 借用
+    languageSystem.BollowWord(parameters.NBorrow, 0.5);
+    // 音韻変化
+    languageSystem.ChangeLanguageSound(parameters.PSoundChange, parameters.PSoundLoss);
+    // 単語の脱落と新語追加
+    languageSystem.RemoveWordRandom(parameters.PWordLoss);
+    languageSystem.CreateWord(parameters.PWordBirth);
+    // 単語の意味変化
+    languageSystem.ChangeLanguageMeaning(parameters.PSemanticShift, parameters.MaxSemanticShiftRate);
+}
+
+/**
+ * @brief 分岐の設定
+ *
+ */
+struct EvolutionBranch
+{
+    // パラメータ
+    EvolutionParameters Parameters;
+    // 乱数のシード
+    unsigned int Seed = 0;
+    // 進める世代数（0 なら各位置に言語が行き渡るまで）
+    int NSection = 0;
+};
+
+/**
+ * @brief 共通の状態から分岐させ、それぞれを別スレッドで進める
+ *
+ * @param base 分岐元の語族
+ * @param branches 分岐ごとの設定
+ * @return 分岐ごとの結果（branches と同じ順）
+ */
+inline std::vector<LanguageSystem> evolveBranches(LanguageSystem &base, const std::vector<EvolutionBranch> &branches)
+{
+    // 分岐は分岐元を書き換えるので、スレッドを立てる前にまとめて行う
+    std::vector<LanguageSystem> results;
+    results.reserve(branches.size());
+    for (size_t i = 0; i < branches.size(); ++i)
+    {
+        results.push_back(base.Fork());
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(branches.size());
+    for (size_t i = 0; i < branches.size(); ++i)
+    {
+        threads.emplace_back([&results, &branches, i]()
+                             {
+            const auto &branch = branches[i];
+            auto &languageSystem = results[i];
+            setRandomSeed(branch.Seed);
+            for (int section = 0; branch.NSection == 0 || section < branch.NSection; ++section)
+            {
+                stepEvolution(languageSystem, branch.Parameters);
+                if (branch.NSection == 0 && languageSystem.HasAllPlaceLanguage())
+                {
+                    break;
+                }
+            } });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    return results;
+}
+
+inline std::optional<LanguageSystem> evolution(
     const int N_BORROW,
     const double P_SOUND_CHANGE,
     const double P_SOUND_LOSS,
@@ -15,7 +124,15 @@ std::optional<LanguageSystem> evolution(
     const std::string &PROTO_LANGUAGE_PATH,
     const std::string &PHONEME_TABLE_PATH,
     const std::string &MAP_PATH,
-    const std::string &OUTPUT_PATH)
+    const std::string &OUTPUT_PATH,
+    const std::string &CHECKPOINT_PATH = "",
+    const int CHECKPOINT_INTERVAL = 0,
+    const std::string &LOG_FORMAT = "yaml",
+    const bool COMPACT_LOG = false,
+    const std::string &PROFILE_PATH = "",
+    const std::string &TRACE_PATH = "",
+    const size_t TRACE_BUFFER_SIZE = 1 << 16,
+    const std::string &ANALYSIS_PATH = "")
 {
     // ファイル読み込み
     const auto oldTokiPonaData = readCSV(PROTO_LANGUAGE_PATH);
@@ -31,11 +148,6 @@ std::optional<LanguageSystem> evolution(
     auto converter = PhoneticsConverter::Create(phoneticsData);
     auto oldTokiPona = converter.convertToLanguage(oldTokiPonaData[0]);
 
-    LanguageSystem languageSystem;
-    languageSystem.Map = mapData;
-    languageSystem.PhoneticsMap = phoneticsData;
-    languageSystem.SetOldLanguageOnMap("0", oldTokiPona);
-
     if (N_BORROW == 0)
     {
         return std::nullopt;
@@ -44,28 +156,159 @@ std::optional<LanguageSystem> evolution(
     {
         return std::nullopt;
     }
+
+    LanguageSystem languageSystem;
+    // 途中経過があれば再開する
+    const bool isCheckpointEnabled = !CHECKPOINT_PATH.empty() && CHECKPOINT_INTERVAL > 0;
+    if (!isCheckpointEnabled || !std::filesystem::exists(CHECKPOINT_PATH) || !languageSystem.LoadSnapshot(CHECKPOINT_PATH))
+    {
+        languageSystem.SetMap(mapData);
+        if (languageSystem.Graph.Places.empty())
+        {
+            return std::nullopt;
+        }
+        languageSystem.PhoneticsMap = phoneticsData;
+        // 途中経過を保存しない場合は、差分をメモリに溜めずに逐次書き出す
+        if (!isCheckpointEnabled)
+        {
+            std::shared_ptr<DifferenceSink> sink;
+            if (LOG_FORMAT == "binary")
+            {
+                auto writer = std::make_shared<BinaryDifferenceLogWriter>();
+                if (!writer->Open(OUTPUT_PATH + ".log", languageSystem))
+                {
+                    return std::nullopt;
+                }
+                sink = writer;
+            }
+            else
+            {
+                auto writer = std::make_shared<DifferenceLogWriter>();
+                if (!writer->Open(OUTPUT_PATH + ".log", languageSystem))
+                {
+                    return std::nullopt;
+                }
+                sink = writer;
+            }
+            languageSystem.Sink = sink;
+            languageSystem.KeepDifferences = false;
+        }
+        languageSystem.SetOldLanguageOnMap("0", oldTokiPona);
+    }
+
+    const EvolutionParameters parameters = {
+        N_BORROW,
+        P_SOUND_CHANGE,
+        P_SOUND_LOSS,
+        P_SEMANTIC_SHIFT,
+        MAX_SEMANTIC_SHIFT_RATE,
+        P_WORD_LOSS,
+        P_WORD_BIRTH};
+    // 計測
+    const bool isProfileEnabled = !PROFILE_PATH.empty();
+    if (isProfileEnabled)
+    {
+        startProfile();
+    }
+    const bool isTraceEnabled = !TRACE_PATH.empty();
+    if (isTraceEnabled)
+    {
+        startTrace(TRACE_BUFFER_SIZE);
+    }
     while (true)
     {
-        languageSystem.ToNextSection();
-        // 言語の影響度を変化させる。
-        languageSystem.ChangeLanguageStrength(1.0);
-        // 借用
-        languageSystem.BollowWord(N_BORROW, 0.5);
-        // 音韻変化
-        languageSystem.ChangeLanguageSound(P_SOUND_CHANGE, P_SOUND_LOSS);
-        // 単語の脱落と新語追加
-        languageSystem.RemoveWordRandom(P_WORD_LOSS);
-        languageSystem.CreateWord(P_WORD_BIRTH);
-        // 単語の意味変化
-        languageSystem.ChangeLanguageMeaning(P_SEMANTIC_SHIFT, MAX_SEMANTIC_SHIFT_RATE);
+        stepEvolution(languageSystem, parameters);
         // 各位置に言語があれば終了
-        if (languageSystem.HasAllPlaceLanguage())
+        const bool isFinished = languageSystem.HasAllPlaceLanguage();
+        // 途中経過の保存
+        if (!isFinished && isCheckpointEnabled && languageSystem.Section % CHECKPOINT_INTERVAL == 0)
+        {
+            ProfileScope profile(ProfileStage::Checkpoint);
+            if (COMPACT_LOG)
+            {
+                languageSystem.CompactDifferences();
+            }
+            languageSystem.SaveSnapshot(CHECKPOINT_PATH);
+        }
+        endProfileSection(languageSystem.Section);
+        if (isFinished)
         {
             break;
         }
     }
     // 出力
-    languageSystem.ExportLanguageToCSV(OUTPUT_PATH);
-    languageSystem.Export(OUTPUT_PATH + ".log");
+    bool isLogWritten = true;
+    {
+        ProfileScope profile(ProfileStage::Export);
+        languageSystem.ExportLanguageToCSV(OUTPUT_PATH);
+        const bool isAnalysisEnabled = !ANALYSIS_PATH.empty();
+        PhylogeneticTree spreadTree;
+        if (languageSystem.Sink)
+        {
+            isLogWritten = languageSystem.Sink->Close();
+            // 差分はメモリにないので、書き出すときに覚えた言語の広がりを使う
+            if (isAnalysisEnabled)
+            {
+                spreadTree = buildSpreadTree(languageSystem.Sink->SpreadDifferences(), languageSystem.Graph.Places, languageSystem.Sink->LastSection());
+            }
+            languageSystem.Sink.reset();
+            if (isLogWritten && COMPACT_LOG)
+            {
+                compactDifferenceLog(OUTPUT_PATH + ".log", OUTPUT_PATH + ".log");
+            }
+        }
+        else
+        {
+            if (COMPACT_LOG)
+            {
+                languageSystem.CompactDifferences();
+            }
+            if (LOG_FORMAT == "binary")
+            {
+                languageSystem.ExportBinary(OUTPUT_PATH + ".log");
+            }
+            else
+            {
+                languageSystem.Export(OUTPUT_PATH + ".log");
+            }
+            if (isAnalysisEnabled)
+            {
+                spreadTree = buildSpreadTree(languageSystem);
+            }
+        }
+        // 解析用の出力（列形式・距離行列・系統樹）
+        if (isAnalysisEnabled)
+        {
+            languageSystem.ExportColumnar(ANALYSIS_PATH + ".cols");
+            const auto distances = computeDistanceMatrix(languageSystem);
+            distances.ExportCSV(ANALYSIS_PATH + ".dist.csv");
+            distances.ExportBinary(ANALYSIS_PATH + ".dist");
+            const auto tree = buildNeighborJoiningTree(distances);
+            tree.ExportNewick(ANALYSIS_PATH + ".nwk");
+            // 推定した系統樹を、差分に記録された言語の広がりと比べる
+            compareTrees(tree, spreadTree).ExportCSV(ANALYSIS_PATH + ".nwk.score");
+        }
+    }
+    if (isProfileEnabled)
+    {
+        stopProfile();
+        getProfileReport().Export(PROFILE_PATH);
+    }
+    if (isTraceEnabled)
+    {
+        stopTrace();
+        exportTrace(TRACE_PATH);
+    }
+    if (!isLogWritten)
+    {
+        std::cerr << "Error: 差分ログを書き出せませんでした: " << OUTPUT_PATH << ".log" << std::endl;
+        return std::nullopt;
+    }
+    // 完了したので途中経過は不要
+    if (isCheckpointEnabled)
+    {
+        std::error_code error;
+        std::filesystem::remove(CHECKPOINT_PATH, error);
+    }
     return languageSystem;
 }
\ No newline at end of file
@@ -0,0 +1,278 @@
+#include "Geography.h"
+#include "Utility.h"
+#include "Random.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+
+namespace
+{
+    // 文字列を実数に変換する（失敗したら false）
+    bool parseDouble(const std::string &str, double &value)
+    {
+        if (str.empty())
+            return false;
+        char *end = nullptr;
+        value = std::strtod(str.c_str(), &end);
+        return end == str.c_str() + str.size();
+    }
+
+    // 名前順に並べた場所一覧を作る
+    std::vector<std::string> makeSortedPlaces(std::vector<std::string> names)
+    {
+        std::sort(names.begin(), names.end());
+        names.erase(std::unique(names.begin(), names.end()), names.end());
+        return names;
+    }
+}
+
+Geography Geography::CreateFromGrid(const std::vector<std::vector<std::string>> &map)
+{
+    Geography result;
+    result.Places = makeSortedPlaces(getNonEmptyStrings(map));
+
+    // 辺の順序は getAdjacencies と同じにする
+    const auto adjacencies = getAdjacencies(map);
+    result.Edges.reserve(adjacencies.size());
+    for (const auto &[from, to] : adjacencies)
+    {
+        result.Edges.push_back({result.FindPlace(from), result.FindPlace(to), 1.0});
+    }
+    result.Build();
+    return result;
+}
+
+Geography Geography::CreateFromEdgeList(const std::vector<std::vector<std::string>> &data)
+{
+    enum Mode
+    {
+        None_,
+        Edge_,
+        Attribute_,
+    };
+
+    Geography result;
+    Mode mode = Mode::None_;
+    size_t sourceColumn = 0, targetColumn = 1, weightColumn = std::numeric_limits<size_t>::max();
+
+    // 名前のままの辺と属性を一旦保持する
+    std::vector<std::pair<std::string, std::string>> namedEdges;
+    std::vector<double> weights;
+    std::vector<std::vector<std::string>> attributeRows;
+    std::vector<std::string> names;
+
+    for (size_t r = 0; r < data.size(); ++r)
+    {
+        const auto &row = data[r];
+        if (row.empty())
+            continue;
+
+        // 見出し行
+        if (row[0] == "source")
+        {
+            mode = Mode::Edge_;
+            for (size_t c = 0; c < row.size(); ++c)
+            {
+                if (row[c] == "source")
+                    sourceColumn = c;
+                else if (row[c] == "target")
+                    targetColumn = c;
+                else if (row[c] == "weight")
+                    weightColumn = c;
+            }
+            continue;
+        }
+        if (row[0] == "place")
+        {
+            mode = Mode::Attribute_;
+            result.AttributeNames.assign(row.begin() + 1, row.end());
+            continue;
+        }
+
+        if (mode == Mode::Edge_)
+        {
+            if (sourceColumn >= row.size() || targetColumn >= row.size() || row[sourceColumn].empty() || row[targetColumn].empty())
+            {
+                std::cerr << "Error: 辺を読み込めませんでした: " << r + 1 << "行目" << std::endl;
+                continue;
+            }
+            double weight = 1.0;
+            if (weightColumn < row.size() && !row[weightColumn].empty() && (!parseDouble(row[weightColumn], weight) || !std::isfinite(weight) || weight < 0.0))
+            {
+                std::cerr << "Error: 辺の重みが不正です: " << r + 1 << "行目" << std::endl;
+                continue;
+            }
+            // 自己ループは借用に使えないので無視する
+            if (row[sourceColumn] == row[targetColumn])
+            {
+                names.push_back(row[sourceColumn]);
+                continue;
+            }
+            namedEdges.emplace_back(row[sourceColumn], row[targetColumn]);
+            weights.push_back(weight);
+            names.push_back(row[sourceColumn]);
+            names.push_back(row[targetColumn]);
+        }
+        else if (mode == Mode::Attribute_)
+        {
+            if (row[0].empty())
+                continue;
+            attributeRows.push_back(row);
+            names.push_back(row[0]);
+        }
+    }
+
+    // 重みがすべて 0 では辺を選べない（一様とみなさず、入力の誤りとして扱う）
+    if (!weights.empty() && std::all_of(weights.begin(), weights.end(), [](const double weight)
+                                        { return weight == 0.0; }))
+    {
+        std::cerr << "Error: 辺の重みがすべて 0 です" << std::endl;
+        return Geography();
+    }
+
+    result.Places = makeSortedPlaces(std::move(names));
+
+    result.Edges.reserve(namedEdges.size());
+    for (size_t i = 0; i < namedEdges.size(); ++i)
+    {
+        result.Edges.push_back({result.FindPlace(namedEdges[i].first), result.FindPlace(namedEdges[i].second), weights[i]});
+    }
+
+    // 属性（未指定は NaN）
+    const size_t nAttribute = result.AttributeNames.size();
+    result.Attributes.assign(result.Places.size() * nAttribute, std::numeric_limits<double>::quiet_NaN());
+    for (const auto &row : attributeRows)
+    {
+        const int place = result.FindPlace(row[0]);
+        for (size_t c = 1; c < row.size() && c - 1 < nAttribute; ++c)
+        {
+            double value;
+            if (parseDouble(row[c], value))
+            {
+                result.Attributes[place * nAttribute + c - 1] = value;
+            }
+        }
+    }
+
+    result.Build();
+    return result;
+}
+
+int Geography::FindPlace(std::string_view name) const
+{
+    auto it = std::lower_bound(Places.begin(), Places.end(), name);
+    if (it == Places.end() || *it != name)
+    {
+        return -1;
+    }
+    return (int)(it - Places.begin());
+}
+
+double Geography::GetAttribute(const int place, const std::string &name, const double defaultValue) const
+{
+    auto it = std::find(AttributeNames.begin(), AttributeNames.end(), name);
+    if (it == AttributeNames.end() || place < 0 || place >= (int)Places.size())
+    {
+        return defaultValue;
+    }
+    const double value = Attributes[place * AttributeNames.size() + (it - AttributeNames.begin())];
+    return std::isnan(value) ? defaultValue : value;
+}
+
+int Geography::SampleEdge() const
+{
+    if (Edges.empty())
+    {
+        return -1;
+    }
+    const int index = getRandomInt(0, (int)Edges.size() - 1);
+    // 重みが一様なら表を引かない（格子地図の従来の乱数消費と一致させる）
+    if (IsUniform)
+    {
+        return index;
+    }
+    return getRandomDouble(0.0, 1.0) < AliasProbability[index] ? index : Alias[index];
+}
+
+void Geography::Build()
+{
+    const int nPlace = (int)Places.size();
+    const int nEdge = (int)Edges.size();
+
+    // 1. CSR（無向なので両方向に登録）
+    Offsets.assign(nPlace + 1, 0);
+    for (const auto &edge : Edges)
+    {
+        Offsets[edge.From + 1]++;
+        Offsets[edge.To + 1]++;
+    }
+    for (int i = 0; i < nPlace; ++i)
+    {
+        Offsets[i + 1] += Offsets[i];
+    }
+    Neighbors.assign(Offsets.back(), 0);
+    NeighborWeights.assign(Offsets.back(), 0.0);
+    std::vector<int> cursor(Offsets.begin(), Offsets.end() - 1);
+    for (const auto &edge : Edges)
+    {
+        Neighbors[cursor[edge.From]] = edge.To;
+        NeighborWeights[cursor[edge.From]++] = edge.Weight;
+        Neighbors[cursor[edge.To]] = edge.From;
+        NeighborWeights[cursor[edge.To]++] = edge.Weight;
+    }
+
+    // 2. エイリアス表（Vose の方法）
+    AliasProbability.assign(nEdge, 1.0);
+    Alias.resize(nEdge);
+    IsUniform = true;
+    double total = 0.0;
+    for (int i = 0; i < nEdge; ++i)
+    {
+        Alias[i] = i;
+        total += Edges[i].Weight;
+        if (Edges[i].Weight != Edges[0].Weight)
+            IsUniform = false;
+    }
+    // 重みは CreateFromEdgeList で検査済み（和が正の有限値でなければ表を作れないので一様にする）
+    if (IsUniform || !(total > 0.0) || !std::isfinite(total))
+    {
+        IsUniform = true;
+        return;
+    }
+
+    std::vector<double> scaled(nEdge);
+    std::vector<int> small, large;
+    small.reserve(nEdge);
+    large.reserve(nEdge);
+    for (int i = 0; i < nEdge; ++i)
+    {
+        scaled[i] = Edges[i].Weight * nEdge / total;
+        (scaled[i] < 1.0 ? small : large).push_back(i);
+    }
+    while (!small.empty() && !large.empty())
+    {
+        const int s = small.back();
+        small.pop_back();
+        const int l = large.back();
+        AliasProbability[s] = scaled[s];
+        Alias[s] = l;
+        scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+        if (scaled[l] < 1.0)
+        {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    // 丸め誤差で残ったものは確率 1
+    for (const int i : small)
+        AliasProbability[i] = 1.0;
+    for (const int i : large)
+        AliasProbability[i] = 1.0;
+}
+
+bool isEdgeListCSV(const std::vector<std::vector<std::string>> &data)
+{
+    return !data.empty() && !data[0].empty() && data[0][0] == "source";
+}
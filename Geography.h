@@ -0,0 +1,108 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief 地理の辺（無向）
+ *
+ */
+struct GeographyEdge
+{
+    // 場所ID
+    int From;
+    // 場所ID
+    int To;
+    // 重み（接触の強さ）
+    double Weight;
+};
+
+/**
+ * @brief 地理（場所の隣接グラフ）
+ *
+ * @note 場所IDは場所名の昇順に振る（std::map<std::string, ...> の走査順と一致する）。
+ * @note 隣接関係は CSR 形式で保持し、借用時の辺選択はエイリアス表で O(1) に行う。
+ */
+struct Geography
+{
+    // 場所名（添字が場所ID）
+    std::vector<std::string> Places;
+    // 辺の一覧
+    std::vector<GeographyEdge> Edges;
+    // CSR の行オフセット（場所IDごと、要素数は場所数 + 1）
+    std::vector<int> Offsets;
+    // CSR の隣接場所ID
+    std::vector<int> Neighbors;
+    // CSR の隣接辺の重み
+    std::vector<double> NeighborWeights;
+    // 場所属性の名前
+    std::vector<std::string> AttributeNames;
+    // 場所属性の値（場所ID * 属性数 + 属性番号）
+    std::vector<double> Attributes;
+    // エイリアス表の採択確率
+    std::vector<double> AliasProbability;
+    // エイリアス表の代替辺
+    std::vector<int> Alias;
+    // すべての辺の重みが等しいか
+    bool IsUniform = true;
+
+    /**
+     * @brief 格子状の地図から地理を作る
+     *
+     * @param map 地図（空文字のマスは場所なし）
+     * @return 地理（隣接は上下左右、重みはすべて 1）
+     */
+    static Geography CreateFromGrid(const std::vector<std::vector<std::string>> &map);
+
+    /**
+     * @brief 辺リストから地理を作る
+     *
+     * @param data 辺リスト形式のCSV
+     * @return 地理
+     *
+     * @note "source,target,weight" の見出し行に続けて辺を1行ずつ記述する。weight は省略時 1。
+     * @note weight は 0 以上の有限値。不正な行は読み飛ばし、すべての辺の重みが 0 なら空の地理を返す。
+     * @note "place,属性名..." の見出し行に続けて場所の属性を記述できる。
+     */
+    static Geography CreateFromEdgeList(const std::vector<std::vector<std::string>> &data);
+
+    /**
+     * @brief 場所IDを取得
+     *
+     * @param name 場所名
+     * @return 場所ID、見つからなければ -1
+     */
+    int FindPlace(std::string_view name) const;
+
+    /**
+     * @brief 場所の属性を取得
+     *
+     * @param place 場所ID
+     * @param name 属性名
+     * @param defaultValue 属性がない場合の値
+     * @return 属性値
+     */
+    double GetAttribute(const int place, const std::string &name, const double defaultValue = 0.0) const;
+
+    /**
+     * @brief 重みに比例した確率で辺をランダムに1つ選択する
+     *
+     * @return 辺の添字、辺がなければ -1
+     */
+    int SampleEdge() const;
+
+    /**
+     * @brief 場所名と辺から CSR とエイリアス表を構築する
+     *
+     * @note Places と Edges を設定した後に呼ぶ。
+     */
+    void Build();
+};
+
+/**
+ * @brief CSVが辺リスト形式かどうか
+ *
+ * @param data CSV
+ * @return 先頭行が "source" から始まれば true
+ */
+bool isEdgeListCSV(const std::vector<std::vector<std::string>> &data);
@@ -1,14 +1,132 @@
 #include "Language.h"
+#include "DifferenceLog.h"
+#include "Replay.h"
+#include "Profile.h"
 #include <fstream>
+#include <iostream>
 #include <cmath>
+#include <memory_resource>
 #include <set>
 #include <sstream>
 #include <iomanip>
+#include <utility>
+#include <cstring>
+#include <algorithm>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 
 namespace
 {
     double TOLERANCE = 1.0e-6;
 
+    // 発音の辞書順（std::vector<Phonetics> の比較と同じ順）
+    struct SoundsLess
+    {
+        bool operator()(std::span<const Phonetics> a, std::span<const Phonetics> b) const
+        {
+            return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
+        }
+    };
+
+    // 意味を列形式の語彙の文字列番号で引けるように展開したもの（内積は Meaning::Dot と同じ順に足す）
+    class MeaningLookup
+    {
+    public:
+        explicit MeaningLookup(std::pmr::memory_resource *resource) : weights(resource), stamps(resource) {}
+
+        // 引かれる側の列形式の語彙を設定する
+        void SetColumns(const VocabularyColumns &columns)
+        {
+            this->columns = &columns;
+            weights.assign(columns.MeaningCount(), 0.0);
+            stamps.assign(columns.MeaningCount(), 0);
+            stamp = 0;
+        }
+
+        // 引く側の意味を設定する（語彙に無い意味は内積に効かないので捨てる）
+        void Set(const Meaning &meaning)
+        {
+            ++stamp;
+            for (const auto &[key, value] : meaning)
+            {
+                const int64_t index = columns->FindMeaning(key);
+                if (index < 0)
+                    continue;
+                weights[index] = value;
+                stamps[index] = stamp;
+            }
+        }
+
+        // 設定した意味と単語の意味の内積（設定した意味.Dot(単語の意味) と同じ値）
+        double Dot(const ColumnarWords &words, const size_t index) const
+        {
+            const auto keys = words.MeaningKeys(index);
+            const auto values = words.MeaningWeights(index);
+            double result = 0.0;
+            for (size_t i = 0; i < keys.size(); ++i)
+            {
+                if (stamps[keys[i]] == stamp)
+                    result += values[i] * weights[keys[i]];
+            }
+            return result;
+        }
+
+        // 内積が最大の単語の番号（同じなら前の単語、単語が無ければ -1）
+        int64_t FindNearest(const ColumnarWords &words) const
+        {
+            int64_t result = -1;
+            double maxDot = -1.0;
+            for (size_t i = 0; i < words.Size(); ++i)
+            {
+                const double dot = Dot(words, i);
+                if (dot > maxDot)
+                {
+                    maxDot = dot;
+                    result = (int64_t)i;
+                }
+            }
+            return result;
+        }
+
+    private:
+        const VocabularyColumns *columns = nullptr;
+        std::pmr::vector<double> weights;
+        std::pmr::vector<uint64_t> stamps;
+        uint64_t stamp = 0;
+    };
+
+    // 祖語の意味を列形式にして、Word::UpdateNearestProtoWord と同じ結果を求める（列は最初に使うときに作る）
+    class NearestProtoWordFinder
+    {
+    public:
+        NearestProtoWordFinder(const Language &proto, std::pmr::memory_resource *resource)
+            : proto(proto), columns(resource), lookup(resource) {}
+
+        void Update(Word &word)
+        {
+            if (!isReady)
+            {
+                columns.Assign(proto.Words);
+                lookup.SetColumns(columns);
+                isReady = true;
+            }
+            const auto protoWords = columns.Words();
+            lookup.Set(word.Meanings);
+            const int64_t index = lookup.FindNearest(protoWords);
+            if (index < 0)
+                return;
+            const auto sounds = protoWords.Sounds(index);
+            word.NearestProtoWord.assign(sounds.begin(), sounds.end());
+        }
+
+    private:
+        const Language &proto;
+        VocabularyColumns columns;
+        MeaningLookup lookup;
+        bool isReady = false;
+    };
+
     // ヘルパー：vectorの中身を文字列に変換
     template <typename T>
     std::string joinVector(const std::vector<T> &vec, const std::string &del = " ")
@@ -38,6 +156,8 @@ namespace
             return "AddCompoundWord";
         case LanguageDifferenceType::Remove:
             return "Remove";
+        case LanguageDifferenceType::CopyLanguage:
+            return "CopyLanguage";
         default:
             return "Unknown";
         }
@@ -58,60 +178,6 @@ namespace
         ss << "]";
         return ss.str();
     }
-
-    // YAMLの [a, b, c] 形式を vector<string> に変換する
-    std::vector<std::string> parseYamlList(const std::string &line)
-    {
-        std::vector<std::string> result;
-        size_t start = line.find('[');
-        size_t end = line.find(']');
-        if (start == std::string::npos || end == std::string::npos)
-            return result;
-
-        std::string content = line.substr(start + 1, end - start - 1);
-        std::stringstream ss(content);
-        std::string item;
-        while (std::getline(ss, item, ','))
-        {
-            size_t first = item.find_first_not_of(" ");
-            size_t last = item.find_last_not_of(" ");
-            if (first != std::string::npos)
-                result.push_back(item.substr(first, (last - first + 1)));
-        }
-        return result;
-    }
-
-    /**
-     * @brief 文字列を':'で前後2つに分割する
-     * @return {前部分, 後部分}。コロンがない場合は {元の文字列, ""}
-     */
-    std::pair<std::string, std::string> splitByColon(const std::string &line)
-    {
-        size_t pos = line.find(':');
-        if (pos == std::string::npos)
-        {
-            return {line, ""};
-        }
-
-        std::string first = line.substr(0, pos);
-        std::string second = line.substr(pos + 1);
-
-        // 必要に応じて前後の空白を削除（トリミング）
-        auto trim = [](std::string &s)
-        {
-            size_t f = s.find_first_not_of(" ");
-            size_t l = s.find_last_not_of(" \r\n\t");
-            if (f == std::string::npos)
-                s = "";
-            else
-                s = s.substr(f, l - f + 1);
-        };
-
-        trim(first);
-        trim(second);
-
-        return {first, second};
-    }
 }
 
 Meaning Meaning::Add(const Meaning &meaning) const
@@ -191,79 +257,251 @@ void Word::UpdateNearestProtoWord(const Language &language)
     }
 }
 
-LanguageDifference LanguageDifference::CreateAddWord(const std::string &ID, const int section, const int wordID, const std::string &wordForm)
+std::span<const Phonetics> ColumnarWords::Sounds(const size_t index) const
+{
+    return AllSounds.subspan(SoundOffsets[index], SoundOffsets[index + 1] - SoundOffsets[index]);
+}
+
+std::span<const uint32_t> ColumnarWords::MeaningKeys(const size_t index) const
+{
+    return AllMeaningKeys.subspan(MeaningOffsets[index], MeaningOffsets[index + 1] - MeaningOffsets[index]);
+}
+
+std::span<const double> ColumnarWords::MeaningWeights(const size_t index) const
+{
+    return AllMeaningWeights.subspan(MeaningOffsets[index], MeaningOffsets[index + 1] - MeaningOffsets[index]);
+}
+
+VocabularyColumns::VocabularyColumns(std::pmr::memory_resource *resource)
+    : ids(resource), protoIDs(resource), soundOffsets(resource), sounds(resource),
+      meaningOffsets(resource), meaningKeys(resource), meaningWeights(resource), meaningIndices(resource)
+{
+}
+
+void VocabularyColumns::Assign(const Vocabulary &words, const Language *proto)
+{
+    ids.clear();
+    protoIDs.clear();
+    soundOffsets.assign(1, 0);
+    sounds.clear();
+    meaningOffsets.assign(1, 0);
+    meaningKeys.clear();
+    meaningWeights.clear();
+    meaningIndices.clear();
+    ids.reserve(words.size());
+    protoIDs.reserve(words.size());
+    soundOffsets.reserve(words.size() + 1);
+    meaningOffsets.reserve(words.size() + 1);
+
+    // 音素列が同じ祖語の単語は、ID の小さい方に対応付ける
+    std::pmr::map<std::span<const Phonetics>, int32_t, SoundsLess> protoIndices(ids.get_allocator());
+    if (proto != nullptr)
+    {
+        for (const auto &[id, word] : proto->Words)
+        {
+            protoIndices.emplace(word.Sounds, id);
+        }
+    }
+
+    for (const auto &[id, word] : words)
+    {
+        ids.push_back(id);
+        auto it = protoIndices.find(word.NearestProtoWord);
+        protoIDs.push_back(it == protoIndices.end() ? -1 : it->second);
+        sounds.insert(sounds.end(), word.Sounds.begin(), word.Sounds.end());
+        soundOffsets.push_back(sounds.size());
+        for (const auto &[key, value] : word.Meanings)
+        {
+            auto [itKey, _] = meaningIndices.emplace(key, (uint32_t)meaningIndices.size());
+            meaningKeys.push_back(itKey->second);
+            meaningWeights.push_back(value);
+        }
+        meaningOffsets.push_back(meaningKeys.size());
+    }
+}
+
+ColumnarWords VocabularyColumns::Words() const
+{
+    return {ids, protoIDs, soundOffsets, meaningOffsets, sounds, meaningKeys, meaningWeights};
+}
+
+int64_t VocabularyColumns::FindMeaning(const std::string_view meaning) const
+{
+    auto it = meaningIndices.find(meaning);
+    return it == meaningIndices.end() ? -1 : (int64_t)it->second;
+}
+
+LanguageDifference::LanguageDifference(const LanguageDifference &other)
+{
+    std::memcpy(static_cast<void *>(this), &other, sizeof(LanguageDifference));
+    if (other.HasPayload() && other.Payload != nullptr)
+    {
+        Payload = new DifferencePayload(*other.Payload);
+    }
+}
+
+LanguageDifference::LanguageDifference(LanguageDifference &&other) noexcept
+{
+    std::memcpy(static_cast<void *>(this), &other, sizeof(LanguageDifference));
+    if (other.HasPayload())
+    {
+        other.Payload = nullptr;
+    }
+}
+
+LanguageDifference &LanguageDifference::operator=(const LanguageDifference &other)
+{
+    if (this != &other)
+    {
+        LanguageDifference copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+LanguageDifference &LanguageDifference::operator=(LanguageDifference &&other) noexcept
+{
+    if (this != &other)
+    {
+        if (HasPayload())
+        {
+            delete Payload;
+        }
+        std::memcpy(static_cast<void *>(this), &other, sizeof(LanguageDifference));
+        if (other.HasPayload())
+        {
+            other.Payload = nullptr;
+        }
+    }
+    return *this;
+}
+
+LanguageDifference::~LanguageDifference()
+{
+    if (HasPayload())
+    {
+        delete Payload;
+    }
+}
+
+SoundChange LanguageDifference::GetSoundChange() const
+{
+    SoundChange result;
+    if (Type != LanguageDifferenceType::ChangeSound)
+    {
+        return result;
+    }
+    result.beforePhon = {Sound.BeforeMannar, Sound.BeforePlace};
+    result.AfterPhone = {Sound.AfterMannar, Sound.AfterPlace};
+    result.Condition = static_cast<SoundChangeCondition>(SoundCondition);
+    result.IsRemove = SoundIsRemove != 0;
+    return result;
+}
+
+const std::string &LanguageDifference::GetWordForm() const
+{
+    static const std::string empty;
+    return (HasPayload() && Payload != nullptr) ? Payload->WordForm : empty;
+}
+
+const Meaning &LanguageDifference::GetMeaning() const
+{
+    static const Meaning empty;
+    return (HasPayload() && Payload != nullptr) ? Payload->Meanings : empty;
+}
+
+LanguageDifference LanguageDifference::CreateAddWord(const int place, const int section, const int wordID, const std::string &wordForm, const Meaning &meaning)
 {
     LanguageDifference result;
     result.Section = section;
     result.Type = LanguageDifferenceType::AddWord;
-    result.StringParam.emplace_back(ID);
-    result.IntParam.emplace_back(wordID);
-    result.StringParam.emplace_back(wordForm);
+    result.Place = place;
+    result.WordID = wordID;
+    result.Payload = new DifferencePayload{wordForm, meaning};
     return result;
 }
 
-LanguageDifference LanguageDifference::CreateChangeStrength(const std::string &ID, const int section, const double strength)
+LanguageDifference LanguageDifference::CreateChangeStrength(const int place, const int section, const double strength)
 {
     LanguageDifference result;
     result.Section = section;
     result.Type = LanguageDifferenceType::ChangeStrength;
-    result.StringParam.emplace_back(ID);
-    result.DoubleParam.emplace_back(strength);
+    result.Place = place;
+    result.Strength = strength;
     return result;
 }
 
-LanguageDifference LanguageDifference::CreateChangeSound(const std::string &ID, const int section, const int wordID, const SoundChange soundChange)
+LanguageDifference LanguageDifference::CreateChangeSound(const int place, const int section, const int wordID, const SoundChange &soundChange)
 {
     LanguageDifference result;
     result.Section = section;
     result.Type = LanguageDifferenceType::ChangeSound;
-    result.StringParam.emplace_back(ID);
-    result.IntParam.emplace_back(wordID);
-    result.SoundChanges = soundChange;
+    result.Place = place;
+    result.WordID = wordID;
+    result.Sound = {
+        (int16_t)soundChange.beforePhon.Mannar,
+        (int16_t)soundChange.beforePhon.Place,
+        (int16_t)soundChange.AfterPhone.Mannar,
+        (int16_t)soundChange.AfterPhone.Place};
+    result.SoundCondition = static_cast<uint8_t>(soundChange.Condition);
+    result.SoundIsRemove = soundChange.IsRemove ? 1 : 0;
     return result;
 }
 
-LanguageDifference LanguageDifference::CreateChangeMeaning(const std::string &ID, const int section, const int wordID, const Meaning meaning)
+LanguageDifference LanguageDifference::CreateChangeMeaning(const int place, const int section, const int wordID, const Meaning &meaning)
 {
     LanguageDifference result;
     result.Section = section;
     result.Type = LanguageDifferenceType::ChangeMeaning;
-    result.StringParam.emplace_back(ID);
-    result.IntParam.emplace_back(wordID);
-    result.MeaningChange = meaning;
+    result.Place = place;
+    result.WordID = wordID;
+    result.Payload = new DifferencePayload{"", meaning};
     return result;
 }
 
-LanguageDifference LanguageDifference::CreateBorrowWord(const std::string &ID1, const std::string &ID2, const int section, const int wordID1, const int wordID2)
+LanguageDifference LanguageDifference::CreateBorrowWord(const int place1, const int place2, const int section, const int wordID1, const int wordID2)
 {
     LanguageDifference result;
     result.Section = section;
     result.Type = LanguageDifferenceType::BorrowWord;
-    result.StringParam.emplace_back(ID1);
-    result.IntParam.emplace_back(wordID1);
-    result.StringParam.emplace_back(ID2);
-    result.IntParam.emplace_back(wordID2);
+    result.Source = {place1, wordID1};
+    result.Place = place2;
+    result.WordID = wordID2;
     return result;
 }
 
-LanguageDifference LanguageDifference::CreateAddCompoundWord(const std::string &ID, const int section, const int wordID, const std::vector<int> wordIDs)
+LanguageDifference LanguageDifference::CreateAddCompoundWord(const int place, const int section, const int wordID, const std::vector<int> &wordIDs)
 {
     LanguageDifference result;
     result.Section = section;
     result.Type = LanguageDifferenceType::AddCompoundWord;
-    result.StringParam.emplace_back(ID);
-    result.IntParam.emplace_back(wordID);
-    result.IntParam.insert(result.IntParam.end(), wordIDs.begin(), wordIDs.end());
+    result.Place = place;
+    result.WordID = wordID;
+    result.PartCount = (uint8_t)std::min<size_t>(wordIDs.size(), MAX_PARTS);
+    for (int i = 0; i < result.PartCount; ++i)
+    {
+        result.Parts[i] = wordIDs[i];
+    }
     return result;
 }
 
-LanguageDifference LanguageDifference::CreateRemoveWord(const std::string &ID, const int section, const int wordID)
+LanguageDifference LanguageDifference::CreateRemoveWord(const int place, const int section, const int wordID)
 {
     LanguageDifference result;
     result.Section = section;
     result.Type = LanguageDifferenceType::Remove;
-    result.StringParam.emplace_back(ID);
-    result.IntParam.emplace_back(wordID);
+    result.Place = place;
+    result.WordID = wordID;
+    return result;
+}
+
+LanguageDifference LanguageDifference::CreateCopyLanguage(const int sourcePlace, const int place, const int section)
+{
+    LanguageDifference result;
+    result.Section = section;
+    result.Type = LanguageDifferenceType::CopyLanguage;
+    result.Source = {sourcePlace, 0};
+    result.Place = place;
     return result;
 }
 
@@ -271,51 +509,165 @@ PhoneticsConverter PhoneticsConverter::Create(const std::vector<std::vector<std:
 {
     PhoneticsConverter result;
 
+    // 1. 音素の番号ごとの表記
+    result.RowCount = (uint32_t)table.size();
+    for (const auto &row : table)
+    {
+        result.ColumnCount = std::max(result.ColumnCount, (uint32_t)row.size());
+    }
+    result.CharOffsets.push_back(0);
+    for (const auto &row : table)
+    {
+        for (uint32_t c = 0; c < result.ColumnCount; ++c)
+        {
+            if (c < row.size())
+                result.Chars += row[c];
+            result.CharOffsets.push_back((uint32_t)result.Chars.size());
+        }
+    }
+
+    // 2. 表記に現れるバイトだけに文字の種類を振る
+    for (const char c : result.Chars)
+    {
+        auto &byteClass = result.ByteClasses[(uint8_t)c];
+        if (byteClass == 0)
+            byteClass = (uint8_t)result.ClassCount++;
+    }
+
+    // 3. 字句解析の木（同じ表記が複数あれば後の音素を優先する）
+    result.Transitions.assign(result.ClassCount, 0);
+    result.Accepts.assign(1, Phonetics{-1, -1});
     for (int r = 0; r < (int)table.size(); ++r)
     {
         for (int c = 0; c < (int)table[r].size(); ++c)
         {
             const std::string &token = table[r][c];
-            Phonetics p;
-            p.Mannar = r;
-            p.Place = c;
-            result.Map[token] = p;
+            if (token.empty())
+                continue;
+            uint32_t node = 0;
+            for (const char ch : token)
+            {
+                const size_t index = node * result.ClassCount + result.ByteClasses[(uint8_t)ch];
+                if (result.Transitions[index] == 0)
+                {
+                    result.Transitions[index] = (uint32_t)result.Accepts.size();
+                    result.Accepts.push_back(Phonetics{-1, -1});
+                    result.Transitions.resize(result.Accepts.size() * result.ClassCount, 0);
+                }
+                node = result.Transitions[index];
+            }
+            result.Accepts[node] = Phonetics{r, c};
         }
     }
     return result;
 }
 
-std::vector<Phonetics> PhoneticsConverter::convertToPhonetics(const std::string &str)
+std::vector<Phonetics> PhoneticsConverter::convertToPhonetics(const std::string &str) const
 {
-    std::vector<Phonetics> output;
-    output.reserve(str.length());
+    std::vector<Phonetics> output(str.length());
+    output.resize(convertToPhonetics(str, output.data()));
+    return output;
+}
 
+size_t PhoneticsConverter::convertToPhonetics(std::string_view str, Phonetics *output) const
+{
+    size_t count = 0;
     for (size_t i = 0; i < str.length();)
     {
-        bool matched = false;
-        // 最長一致を優先（最大長が既知ならその値から開始）
-        for (size_t len = 2; len > 0; --len)
+        // 最長一致を優先
+        uint32_t node = 0;
+        size_t matchedEnd = 0;
+        Phonetics matched{-1, -1};
+        for (size_t j = i; j < str.length(); ++j)
         {
-            if (i + len <= str.length())
+            const uint8_t byteClass = ByteClasses[(uint8_t)str[j]];
+            if (byteClass == 0)
+                break;
+            node = Transitions[node * ClassCount + byteClass];
+            if (node == 0)
+                break;
+            if (Accepts[node].Mannar >= 0)
             {
-                std::string sub = str.substr(i, len);
-                auto it = Map.find(sub);
-                if (it != Map.end())
-                {
-                    output.push_back(it->second);
-                    i += len;
-                    matched = true;
-                    break;
-                }
+                matched = Accepts[node];
+                matchedEnd = j + 1;
             }
         }
-        if (!matched)
+        if (matched.Mannar >= 0)
+        {
+            output[count++] = matched;
+            i = matchedEnd;
+        }
+        else
             i++;
     }
+    return count;
+}
+
+void PhoneticsConverter::convertToPhonetics(std::span<const std::string> strs, std::vector<Phonetics> &sounds, std::vector<uint64_t> &offsets) const
+{
+    size_t length = 0;
+    for (const auto &str : strs)
+    {
+        length += str.length();
+    }
+    size_t count = sounds.size();
+    sounds.resize(count + length);
+    offsets.reserve(offsets.size() + strs.size());
+    for (const auto &str : strs)
+    {
+        count += convertToPhonetics(str, sounds.data() + count);
+        offsets.push_back(count);
+    }
+    sounds.resize(count);
+}
+
+size_t PhoneticsConverter::GetStringLength(std::span<const Phonetics> sounds) const
+{
+    size_t length = 0;
+    for (const auto &sound : sounds)
+    {
+        length += GetString(sound).size();
+    }
+    return length;
+}
+
+char *PhoneticsConverter::convertToString(std::span<const Phonetics> sounds, char *output) const
+{
+    for (const auto &sound : sounds)
+    {
+        const auto str = GetString(sound);
+        std::memcpy(output, str.data(), str.size());
+        output += str.size();
+    }
     return output;
 }
 
-Language PhoneticsConverter::convertToLanguage(const std::vector<std::string> &strs)
+void PhoneticsConverter::appendString(std::span<const Phonetics> sounds, std::string &output) const
+{
+    for (const auto &sound : sounds)
+    {
+        output += GetString(sound);
+    }
+}
+
+std::string PhoneticsConverter::convertToString(std::span<const Phonetics> sounds) const
+{
+    std::string result;
+    appendString(sounds, result);
+    return result;
+}
+
+void PhoneticsConverter::convertToString(const Vocabulary &words, std::string &chars, std::vector<uint64_t> &offsets) const
+{
+    offsets.reserve(offsets.size() + words.size());
+    for (const auto &[_, word] : words)
+    {
+        appendString(word.Sounds, chars);
+        offsets.push_back(chars.size());
+    }
+}
+
+Language PhoneticsConverter::convertToLanguage(const std::vector<std::string> &strs) const
 {
     Language result;
     int wordID = 0;
@@ -332,12 +684,12 @@ Language PhoneticsConverter::convertToLanguage(const std::vector<std::string> &s
     return result;
 }
 
-std::map<std::string, Language> setOldLanguageOnMap(
+LanguageTable setOldLanguageOnMap(
     const std::vector<std::string> &mapData,
     const std::string &startPlace,
     const Language &language)
 {
-    std::map<std::string, Language> result;
+    LanguageTable result;
 
     for (const std::string &item : mapData)
     {
@@ -359,32 +711,56 @@ std::map<std::string, Language> setOldLanguageOnMap(
     return result;
 }
 
+void LanguageSystem::SetMap(const std::vector<std::vector<std::string>> &mapData)
+{
+    if (isEdgeListCSV(mapData))
+    {
+        Map.clear();
+        Graph = Geography::CreateFromEdgeList(mapData);
+    }
+    else
+    {
+        Map = mapData;
+        Graph = Geography::CreateFromGrid(mapData);
+    }
+}
+
 void LanguageSystem::SetOldLanguageOnMap(
     const std::string &startPlace,
     const Language &language)
 {
-    LanguageMap = setOldLanguageOnMap(getNonEmptyStrings(Map), startPlace, language);
+    LanguageMap = setOldLanguageOnMap(Graph.Places, startPlace, language);
     ProtoLanguage = language;
 
     // ログ
-    languageDifference.emplace_back(LanguageDifference::CreateChangeStrength(startPlace, Section, language.Strength));
+    const int startIndex = Graph.FindPlace(startPlace);
+    const auto converter = PhoneticsConverter::Create(PhoneticsMap);
+    AddDifference(LanguageDifference::CreateChangeStrength(startIndex, Section, language.Strength));
     for (const auto &[ID, word] : language.Words)
     {
-        languageDifference.emplace_back(LanguageDifference::CreateAddWord(startPlace, Section, ID, convertToString(word.Sounds, PhoneticsMap)));
+        AddDifference(LanguageDifference::CreateAddWord(startIndex, Section, ID, converter.convertToString(word.Sounds), word.Meanings));
     }
 }
 
 std::vector<std::string> LanguageSystem::GetWords(std::string place)
 {
-    if (LanguageMap.count(place) == 0)
+    auto it = std::as_const(LanguageMap).find(place);
+    if (it == LanguageMap.Get().end())
     {
         return {};
     }
-    const auto language = LanguageMap[place];
+    const auto &language = it->second;
+    const auto converter = PhoneticsConverter::Create(PhoneticsMap);
+    std::string chars;
+    std::vector<uint64_t> offsets;
+    converter.convertToString(language.Words, chars, offsets);
     std::vector<std::string> result;
-    for (const auto &[_, word] : language.Words)
+    result.reserve(offsets.size());
+    uint64_t begin = 0;
+    for (const auto end : offsets)
     {
-        result.emplace_back(convertToString(word.Sounds, PhoneticsMap));
+        result.emplace_back(chars, begin, end - begin);
+        begin = end;
     }
     return result;
 }
@@ -419,8 +795,10 @@ void LanguageSystem::ChangeLanguageSound(
     const bool isProhibitMinimalPair,
     const bool isSoundDuplication)
 {
+    ProfileScope profile(ProfileStage::ChangeLanguageSound);
     for (auto &[ID, language] : LanguageMap)
     {
+        const int place = Graph.FindPlace(ID);
         // 音韻変化するかどうか
         if (!getWithProbability(pSoundChange))
         {
@@ -431,22 +809,34 @@ void LanguageSystem::ChangeLanguageSound(
         {
             continue;
         }
+        addProfileCount(ProfileCounter::Languages);
+        addProfileCount(ProfileCounter::Words, language.Words.size());
         const auto sound = getRandomSoundFromLanguage(language);
         SoundChange soundChange = makeSoundChangeRandom(sound, PhoneticsMap, pSoundLoss);
         // changeLanguageSound(language, soundChange, isProhibitMinimalPair, isSoundDuplication);
         {
-            // 子音と母音の境界（定数化してループ外で定義）
-            constexpr int MAX_CONSONANT_MANNAR = 3;
-
-            // 変更が発生した単語を記録する一時的なマップ（インプレース更新用）
-            std::map<int, Word> updatedWords;
+            // 変化する単語（単語IDの昇順）と変化後の発音（一時データは世代の一時領域に置く）
+            struct SoundUpdate
+            {
+                int WordID;
+                size_t Offset;
+                size_t Size;
+                bool IsValid;
+            };
+            std::pmr::memory_resource *resource = Arena.Resource();
+            std::pmr::vector<SoundUpdate> updatedWords(resource);
+            std::pmr::vector<Phonetics> updatedSounds(resource);
+            std::pmr::vector<Phonetics> nextSounds(resource);
+            auto getUpdatedSounds = [&](const SoundUpdate &update)
+            {
+                return std::span<const Phonetics>(updatedSounds.data() + update.Offset, update.Size);
+            };
 
-            // 1. 音韻変化の適用と音素重複チェックを同時に行う
-            for (auto &[wordID, word] : language.Words)
+            // 1. 音韻変化の適用と音素重複チェックを同時に行う（読むだけなので語彙の共有は解除しない）
+            for (const auto &[wordID, word] : std::as_const(language.Words))
             {
                 bool changed = false;
-                std::vector<Phonetics> nextSounds;
-                nextSounds.reserve(word.Sounds.size()); // メモリ確保を1回に抑制
+                nextSounds.clear();
 
                 for (size_t i = 0; i < word.Sounds.size(); ++i)
                 {
@@ -523,41 +913,43 @@ void LanguageSystem::ChangeLanguageSound(
                         continue; // 違反していればこの単語の変化は破棄
                 }
 
-                // 変化後の単語候補を一時保存
-                Word newWord = word;
-                newWord.Sounds = std::move(nextSounds); // 所有権を移転してコピーを回避
-                updatedWords[wordID] = std::move(newWord);
+                // 変化後の発音を一時保存
+                updatedWords.push_back({wordID, updatedSounds.size(), nextSounds.size(), true});
+                updatedSounds.insert(updatedSounds.end(), nextSounds.begin(), nextSounds.end());
             }
 
             // 2. 同音語（ミニマル・ペア）の禁止チェック (isProhibiteMinimalPair)
-            if (isProhibitMinimalPair)
+            if (isProhibitMinimalPair && !updatedWords.empty())
             {
-                // 現在の言語全体の単語分布を把握（変化しなかった単語 + 変化候補）
-                std::map<std::vector<Phonetics>, int> soundCounts;
-                for (const auto &[wordID, word] : language.Words)
+                // 現在の言語全体の単語分布を把握（変化しなかった単語 + 変化候補、どちらも単語IDの昇順）
+                std::pmr::map<std::span<const Phonetics>, int, SoundsLess> soundCounts(resource);
+                auto update = updatedWords.begin();
+                for (const auto &[wordID, word] : std::as_const(language.Words))
                 {
-                    auto it = updatedWords.find(wordID);
-                    soundCounts[it != updatedWords.end() ? it->second.Sounds : word.Sounds]++;
+                    if (update != updatedWords.end() && update->WordID == wordID)
+                        soundCounts[getUpdatedSounds(*update++)]++;
+                    else
+                        soundCounts[word.Sounds]++;
                 }
 
                 // 重複が発生する変化を差し止める
-                for (auto it = updatedWords.begin(); it != updatedWords.end();)
+                for (auto &candidate : updatedWords)
                 {
-                    if (soundCounts[it->second.Sounds] > 1)
-                        it = updatedWords.erase(it);
-                    else
-                        ++it;
+                    if (soundCounts[getUpdatedSounds(candidate)] > 1)
+                        candidate.IsValid = false;
                 }
             }
 
-            // 3. 最終的な反映（一括代入）
-            for (auto &[wordID, newWord] : updatedWords)
+            // 3. 最終的な反映（変化する単語があるときだけ語彙の共有を解除する）
+            for (const auto &update : updatedWords)
             {
-                language.Words[wordID] = std::move(newWord);
+                if (!update.IsValid)
+                    continue;
+                const auto sounds = getUpdatedSounds(update);
+                language.Words[update.WordID].Sounds.assign(sounds.begin(), sounds.end());
 
                 // ログ
-                const auto dif = LanguageDifference::CreateChangeSound(ID, Section, wordID, soundChange);
-                languageDifference.emplace_back(dif);
+                AddDifference(LanguageDifference::CreateChangeSound(place, Section, update.WordID, soundChange));
             }
         }
     }
@@ -567,13 +959,18 @@ void LanguageSystem::ChangeLanguageMeaning(
     const double pSemanticShift,
     const double maxSemanticShiftRate)
 {
+    ProfileScope profile(ProfileStage::ChangeLanguageMeaning);
+    NearestProtoWordFinder nearestProtoWord(ProtoLanguage, Arena.Resource());
     for (auto &[ID, language] : LanguageMap)
     {
+        const int place = Graph.FindPlace(ID);
         // 意味変化するかどうか
         if (getWithProbability(pSemanticShift))
         {
             if (language.Words.empty())
                 return;
+            addProfileCount(ProfileCounter::Languages);
+            addProfileCount(ProfileCounter::Words, language.Words.size());
 
             // 変更対象の単語をランダムに選択
             // マップの要素にランダムアクセスするため、イテレータを進める
@@ -597,7 +994,7 @@ void LanguageSystem::ChangeLanguageMeaning(
             double changeRate = getRandomDouble(0.0, maxSemanticShiftRate);
             targetWord.Meanings = targetWord.Meanings.Add(seedWord.Meanings.Product(changeRate));
             targetWord.Meanings.Normalize();
-            targetWord.UpdateNearestProtoWord(ProtoLanguage);
+            nearestProtoWord.Update(targetWord);
 
             // 整合性チェック：すべての単語が異なる祖語に対応しているか（単射性の維持）
             // 巨大なセットを作る代わりに、他の単語と衝突していないかだけをチェック
@@ -622,8 +1019,7 @@ void LanguageSystem::ChangeLanguageMeaning(
             else
             {
                 // ログ
-                const auto dif = LanguageDifference::CreateChangeMeaning(ID, Section, wordID, seedWord.Meanings);
-                languageDifference.emplace_back(dif);
+                AddDifference(LanguageDifference::CreateChangeMeaning(place, Section, wordID, targetWord.Meanings));
             }
         }
     }
@@ -656,144 +1052,289 @@ SoundChange makeSoundChangeRandom(const Phonetics &beforePhon, const std::vector
     return result;
 }
 
+namespace
+{
+    // 音素列のハッシュ
+    struct PhoneticsHash
+    {
+        size_t operator()(const std::vector<Phonetics> &sounds) const
+        {
+            size_t hash = sounds.size();
+            for (const auto &sound : sounds)
+            {
+                hash = hash * 1000003u ^ ((size_t)(uint32_t)sound.Mannar << 16 ^ (uint32_t)sound.Place);
+            }
+            return hash;
+        }
+    };
+
+    // 1言語の派生語を、祖語の単語（音素列が同じものは1つ）ごとにまとめて並べたもの
+    struct CognateColumn
+    {
+        // 派生語の文字列をつなげたもの
+        std::string Text;
+        // 派生語ごとの Text 内の終わりの位置
+        std::vector<uint32_t> Ends;
+        // 祖語の単語ごとの、Ends 内の始まりの位置（祖語の単語の数 + 1）
+        std::vector<uint32_t> Groups;
+
+        size_t Count(const int group) const
+        {
+            return Groups[group + 1] - Groups[group];
+        }
+
+        std::string_view Cell(const int group, const size_t row) const
+        {
+            const size_t index = Groups[group] + row;
+            const size_t begin = index == 0 ? 0 : Ends[index - 1];
+            return std::string_view(Text).substr(begin, Ends[index] - begin);
+        }
+
+        // 祖語の単語の派生語の文字列の長さの合計
+        size_t Bytes(const int group) const
+        {
+            if (Count(group) == 0)
+                return 0;
+            const size_t first = Groups[group], last = Groups[group + 1];
+            return Ends[last - 1] - (first == 0 ? 0 : Ends[first - 1]);
+        }
+    };
+
+    // [0, count) をスレッドに分けて処理する
+    void parallelFor(const size_t count, const unsigned int threadCount, const std::function<void(size_t, size_t)> &func)
+    {
+        const size_t n = std::min<size_t>(threadCount, count);
+        if (n <= 1)
+        {
+            func(0, count);
+            return;
+        }
+        auto work = [&func](const size_t begin, const size_t end)
+        {
+            ProfileScope profile(ProfileStage::Worker);
+            func(begin, end);
+        };
+        std::vector<std::thread> threads;
+        threads.reserve(n - 1);
+        for (size_t i = 1; i < n; ++i)
+        {
+            threads.emplace_back(work, count * i / n, count * (i + 1) / n);
+        }
+        work(0, count / n);
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+    }
+}
+
 void exportLanguageToCSV(
-    Language &oldLanguage,
-    const std::map<std::string, Language> &languages,
+    const Language &oldLanguage,
+    const LanguageTable &languages,
     const std::vector<std::vector<std::string>> &table,
-    const std::string &filename)
+    const std::string &filename,
+    unsigned int threadCount)
 {
     std::ofstream file(filename.c_str());
     if (!file.is_open())
         return;
-
-    // 1. 文字列変換の結果をキャッシュするマップ (高速化の肝)
-    std::map<std::vector<Phonetics>, std::string> stringCache;
-    auto getCachedString = [&](const std::vector<Phonetics> &s) -> const std::string &
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    const auto converter = PhoneticsConverter::Create(table);
+
+    // 1. 祖語の単語を音素列ごとのグループにまとめる（派生語は NearestProtoWord の音素列で対応付ける）
+    std::unordered_map<std::vector<Phonetics>, int, PhoneticsHash> groupOfSounds;
+    std::vector<int> protoGroups;
+    std::vector<std::string> protoStrings;
+    protoGroups.reserve(oldLanguage.Words.size());
+    protoStrings.reserve(oldLanguage.Words.size());
+    for (const auto &[_, word] : oldLanguage.Words)
     {
-        auto it = stringCache.find(s);
-        if (it != stringCache.end())
-            return it->second;
-        return stringCache[s] = convertToString(s, table); //
-    };
+        protoGroups.push_back(groupOfSounds.emplace(word.Sounds, (int)groupOfSounds.size()).first->second);
+        protoStrings.emplace_back();
+        converter.appendString(word.Sounds, protoStrings.back());
+    }
+    const int groupCount = (int)groupOfSounds.size();
 
-    // 2. ヘッダー行 (Place) の出力と、Languageポインタのキャッシュ
-    file << ",";
+    // 2. 言語ごとに、派生語の文字列を祖語の単語ごとにまとめる（言語ごとに並列）
     std::vector<const Language *> langPtrList;
     langPtrList.reserve(languages.size());
-    for (const auto &[place, language] : languages)
+    for (const auto &[_, language] : languages)
     {
-        file << place << ",";
-        langPtrList.push_back(&language); // ループ内でのmap検索を避けるために保持
+        langPtrList.push_back(&language);
     }
-    file << "\n";
+    std::vector<CognateColumn> columns(langPtrList.size());
+    parallelFor(langPtrList.size(), threadCount, [&](const size_t begin, const size_t end)
+                {
+        std::string text;
+        std::vector<uint32_t> ends;
+        std::vector<int> groups;
+        for (size_t i = begin; i < end; ++i)
+        {
+            // 単語ID 順に文字列にしてから、祖語の単語ごとに並べ替える（同じ祖語の単語の中では単語ID 順）
+            text.clear();
+            ends.clear();
+            groups.clear();
+            auto &column = columns[i];
+            column.Groups.assign(groupCount + 1, 0);
+            for (const auto &[_, word] : langPtrList[i]->Words)
+            {
+                auto it = groupOfSounds.find(word.NearestProtoWord);
+                if (it == groupOfSounds.end())
+                    continue;
+                converter.appendString(word.Sounds, text);
+                ends.push_back((uint32_t)text.size());
+                groups.push_back(it->second);
+                column.Groups[it->second + 1]++;
+            }
+            for (int g = 0; g < groupCount; ++g)
+            {
+                column.Groups[g + 1] += column.Groups[g];
+            }
+            std::vector<uint32_t> next(column.Groups.begin(), column.Groups.end() - 1);
+            std::vector<uint32_t> order(groups.size());
+            std::vector<uint32_t> lengths(groups.size() + 1, 0);
+            for (size_t w = 0; w < groups.size(); ++w)
+            {
+                const uint32_t index = next[groups[w]]++;
+                order[index] = (uint32_t)w;
+                lengths[index + 1] = ends[w] - (w == 0 ? 0 : ends[w - 1]);
+            }
+            column.Text.resize(text.size());
+            column.Ends.resize(groups.size());
+            uint32_t position = 0;
+            for (size_t index = 0; index < order.size(); ++index)
+            {
+                const uint32_t w = order[index];
+                const uint32_t begin = w == 0 ? 0 : ends[w - 1];
+                std::memcpy(column.Text.data() + position, text.data() + begin, lengths[index + 1]);
+                position += lengths[index + 1];
+                column.Ends[index] = position;
+            }
+        } });
 
-    // 3. 祖語の単語との対応マップの作成
-    // mapsOldWordToWord[言語インデックス][祖語の音素列] -> 該当する単語リスト
-    std::vector<std::map<std::vector<Phonetics>, std::vector<const Word *>>> mapsOldWordToWord;
-    mapsOldWordToWord.resize(langPtrList.size());
-    for (size_t i = 0; i < langPtrList.size(); ++i)
+    // 3. ヘッダー行 (Place) と「Toki Pona」行 (言語名の特定)
+    std::string head = ",";
+    for (const auto &[place, _] : languages)
     {
-        for (const auto &[_, word] : langPtrList[i]->Words)
-        {
-            mapsOldWordToWord[i][word.NearestProtoWord].push_back(&word); //
-        }
+        head += place;
+        head += ",";
     }
-
-    // 4. 「Toki Pona」行の出力 (言語名の特定)
+    head += "\nToki Pona,";
     int indexToki = -1, indexPona = -1;
-    for (const auto &[id, word] : oldLanguage.Words)
+    for (size_t p = 0; p < protoStrings.size(); ++p)
     {
-        std::string s = getCachedString(word.Sounds);
-        if (s == "toki")
-            indexToki = id;
-        if (s == "pona")
-            indexPona = id;
+        if (protoStrings[p] == "toki")
+            indexToki = (int)p;
+        if (protoStrings[p] == "pona")
+            indexPona = (int)p;
     }
-
-    file << "Toki Pona,";
     if (indexToki != -1 && indexPona != -1)
     {
-        const auto &tokiSounds = oldLanguage.Words[indexToki].Sounds;
-        const auto &ponaSounds = oldLanguage.Words[indexPona].Sounds;
-
-        for (size_t i = 0; i < langPtrList.size(); ++i)
+        const int toki = protoGroups[indexToki], pona = protoGroups[indexPona];
+        for (const auto &column : columns)
         {
-            const auto &tokiList = mapsOldWordToWord[i][tokiSounds];
-            const auto &ponaList = mapsOldWordToWord[i][ponaSounds];
-
-            if (tokiList.empty() || ponaList.empty())
+            if (column.Count(toki) != 0 && column.Count(pona) != 0)
             {
-                file << ",";
-            }
-            else
-            {
-                std::string tokiStr = getCachedString(tokiList[0]->Sounds);
-                std::string ponaStr = getCachedString(ponaList[0]->Sounds);
+                std::string tokiStr(column.Cell(toki, 0));
+                std::string ponaStr(column.Cell(pona, 0));
                 if (!tokiStr.empty())
                     tokiStr[0] = std::toupper(tokiStr[0]);
                 if (!ponaStr.empty())
                     ponaStr[0] = std::toupper(ponaStr[0]);
-                file << tokiStr << " " << ponaStr << ",";
+                head += tokiStr;
+                head += " ";
+                head += ponaStr;
             }
+            head += ",";
         }
     }
-    file << "\n";
-
-    // 5. 各単語の出力
-    for (const auto &[id, oldWord] : oldLanguage.Words)
-    {
-        const auto &protoSounds = oldWord.Sounds;
+    head += "\n";
 
-        // この祖語単語に対して、各地点で最大何個の派生語があるか確認
-        size_t maxRows = 0;
-        for (size_t i = 0; i < langPtrList.size(); ++i)
+    // 4. 祖語の単語ごとの行の大きさを先に数えて、出力全体のバッファを確保する
+    // 行数は各地点の派生語の最大数、1行は「祖語（最初の行だけ）, 派生語, ..., 派生語\n」
+    std::vector<size_t> rowCounts(protoGroups.size(), 0);
+    std::vector<size_t> offsets(protoGroups.size() + 1, head.size());
+    parallelFor(protoGroups.size(), threadCount, [&](const size_t begin, const size_t end)
+                {
+        for (size_t p = begin; p < end; ++p)
         {
-            maxRows = std::max(maxRows, mapsOldWordToWord[i][protoSounds].size());
-        }
+            size_t rows = 0, bytes = 0;
+            for (const auto &column : columns)
+            {
+                rows = std::max(rows, column.Count(protoGroups[p]));
+                bytes += column.Bytes(protoGroups[p]);
+            }
+            rowCounts[p] = rows;
+            offsets[p + 1] = rows == 0 ? 0 : protoStrings[p].size() + rows * (columns.size() + 1) + bytes;
+        } });
+    for (size_t p = 0; p < protoGroups.size(); ++p)
+    {
+        offsets[p + 1] += offsets[p];
+    }
 
-        // 派生語の数だけ行を出力
-        for (size_t row = 0; row < maxRows; ++row)
+    // 5. 各単語の行を並列に書き込む
+    std::string buffer(offsets.back(), '\0');
+    std::memcpy(buffer.data(), head.data(), head.size());
+    parallelFor(protoGroups.size(), threadCount, [&](const size_t begin, const size_t end)
+                {
+        for (size_t p = begin; p < end; ++p)
         {
-            if (row == 0)
-                file << getCachedString(protoSounds); // 最初の行だけ祖語を表示
-            file << ",";
-
-            for (size_t langIdx = 0; langIdx < langPtrList.size(); ++langIdx)
+            char *out = buffer.data() + offsets[p];
+            auto put = [&out](const std::string_view s)
+            {
+                std::memcpy(out, s.data(), s.size());
+                out += s.size();
+            };
+            const int group = protoGroups[p];
+            for (size_t row = 0; row < rowCounts[p]; ++row)
             {
-                const auto &derivedWords = mapsOldWordToWord[langIdx][protoSounds];
-                if (row < derivedWords.size())
+                if (row == 0)
+                    put(protoStrings[p]); // 最初の行だけ祖語を表示
+                *out++ = ',';
+                for (size_t langIdx = 0; langIdx < columns.size(); ++langIdx)
                 {
-                    file << getCachedString(derivedWords[row]->Sounds);
+                    if (row < columns[langIdx].Count(group))
+                        put(columns[langIdx].Cell(group, row));
+                    if (langIdx != columns.size() - 1)
+                        *out++ = ',';
                 }
-                file << (langIdx == langPtrList.size() - 1 ? "" : ",");
+                *out++ = '\n';
             }
-            file << "\n";
-        }
-    }
+        } });
 
+    file.write(buffer.data(), buffer.size());
     file.close();
 }
 
-void LanguageSystem::ExportLanguageToCSV(const std::string &filename)
+void LanguageSystem::ExportLanguageToCSV(const std::string &filename, const unsigned int threadCount)
 {
-    exportLanguageToCSV(ProtoLanguage, LanguageMap, PhoneticsMap, filename);
+    exportLanguageToCSV(ProtoLanguage, LanguageMap, PhoneticsMap, filename, threadCount);
 }
 
 void LanguageSystem::BollowWord(const int nBorrow, const double pBorrow)
 {
-    const auto mapAdjacentData = getAdjacencies(Map);
+    ProfileScope profile(ProfileStage::BollowWord);
+    // 借用元の意味だけを列形式にして順に読む（一時データは世代の一時領域に置く）
+    std::pmr::memory_resource *resource = Arena.Resource();
+    VocabularyColumns sourceColumns(resource);
+    MeaningLookup lookup(resource);
     for (int i = 0; i < nBorrow; i++)
     {
         // 借用率 は現在固定
-        const auto adjucent = mapAdjacentData[getRandomInt(0, mapAdjacentData.size() - 1)];
+        const int edgeIndex = Graph.SampleEdge();
+        if (edgeIndex < 0)
+            return;
+        const auto &adjucent = Graph.Edges[edgeIndex];
         {
-            auto it1 = LanguageMap.find(adjucent.first);
-            auto it2 = LanguageMap.find(adjucent.second);
+            auto it1 = LanguageMap.find(Graph.Places[adjucent.From]);
+            auto it2 = LanguageMap.find(Graph.Places[adjucent.To]);
             if (it1 == LanguageMap.end() || it2 == LanguageMap.end())
                 return;
 
             Language &l1 = it1->second;
             Language &l2 = it2->second;
+            addProfileCount(ProfileCounter::Languages, 2);
 
             if (l1.Words.empty() || l2.Words.empty())
             {
@@ -801,47 +1342,46 @@ void LanguageSystem::BollowWord(const int nBorrow, const double pBorrow)
                 {
                     l1.Words = l2.Words;
                     l1.Strength = l2.Strength;
+                    AddDifference(LanguageDifference::CreateCopyLanguage(adjucent.To, adjucent.From, Section));
                 }
                 else
                 {
                     l2.Words = l1.Words;
                     l2.Strength = l1.Strength;
+                    AddDifference(LanguageDifference::CreateCopyLanguage(adjucent.From, adjucent.To, Section));
                 }
                 return;
             }
 
             auto *source = (l1.Strength > l2.Strength) ? &l1 : &l2;
             auto *target = (l1.Strength > l2.Strength) ? &l2 : &l1;
-            const auto sID = (l1.Strength > l2.Strength) ? it1->first : it2->first;
-            const auto tID = (l1.Strength > l2.Strength) ? it2->first : it1->first;
+            const int sID = (l1.Strength > l2.Strength) ? adjucent.From : adjucent.To;
+            const int tID = (l1.Strength > l2.Strength) ? adjucent.To : adjucent.From;
+
+            sourceColumns.Assign(source->Words);
+            lookup.SetColumns(sourceColumns);
+            const auto sourceWords = sourceColumns.Words();
 
+            uint64_t scannedWords = target->Words.size();
             for (auto &[tWordID, tWord] : target->Words)
             {
                 if (getRandomInt(0, 1) != 0)
                     continue;
+                scannedWords += source->Words.size();
 
-                const Word *bestSourceWord = nullptr;
-                int bestSourceWordID = -1;
-                double maxDot = -1.0;
-
-                for (const auto &[sWordID, sWord] : source->Words)
+                lookup.Set(tWord.Meanings);
+                const int64_t bestIndex = lookup.FindNearest(sourceWords);
+                if (bestIndex >= 0)
                 {
-                    double dot = tWord.Meanings.Dot(sWord.Meanings);
-                    if (dot > maxDot)
-                    {
-                        maxDot = dot;
-                        bestSourceWord = &sWord;
-                        bestSourceWordID = sWordID;
-                    }
-                }
+                    // 音素列は語彙から読む（借用元と借用先が同じ言語なら、この段階で借用した後の音素列になる）
+                    const auto &[bestSourceWordID, bestSourceWord] = source->Words.Get()[bestIndex];
 
-                if (bestSourceWord)
-                {
                     // 同音語チェックを最適化
                     bool isDuplicate = false;
                     for (const auto &[checkID, checkWord] : target->Words)
                     {
-                        if (checkWord.Sounds == bestSourceWord->Sounds)
+                        scannedWords++;
+                        if (checkWord.Sounds == bestSourceWord.Sounds)
                         {
                             isDuplicate = true;
                             break;
@@ -849,14 +1389,14 @@ void LanguageSystem::BollowWord(const int nBorrow, const double pBorrow)
                     }
                     if (!isDuplicate)
                     {
-                        tWord.Sounds = bestSourceWord->Sounds;
+                        tWord.Sounds = bestSourceWord.Sounds;
 
                         // ログ
-                        const auto dif = LanguageDifference::CreateBorrowWord(sID, tID, Section, bestSourceWordID, tWordID);
-                        languageDifference.emplace_back(dif);
+                        AddDifference(LanguageDifference::CreateBorrowWord(sID, tID, Section, bestSourceWordID, tWordID));
                     }
                 }
             }
+            addProfileCount(ProfileCounter::Words, scannedWords);
         }
     }
 }
@@ -894,43 +1434,57 @@ Phonetics getRandomSoundFromLanguage(Language &language)
     {
         return {0, 0};
     }
+    // 単語IDは連番とは限らないので、位置で選ぶ
     const int index1 = getRandomInt(0, (int)(language.Words.size()) - 1);
-    const int index2 = getRandomInt(0, (int)(language.Words[index1].Sounds.size()) - 1);
-    return language.Words[index1].Sounds[index2];
+    const auto &sounds = std::next(std::as_const(language.Words).begin(), index1)->second.Sounds;
+    if (sounds.empty())
+    {
+        return {0, 0};
+    }
+    const int index2 = getRandomInt(0, (int)(sounds.size()) - 1);
+    return sounds[index2];
 }
 
 void LanguageSystem::ChangeLanguageStrength(const double pChangeStrength)
 {
+    ProfileScope profile(ProfileStage::ChangeLanguageStrength);
     for (auto &[ID, language] : LanguageMap)
     {
+        const int place = Graph.FindPlace(ID);
         if (getWithProbability(pChangeStrength))
         {
+            addProfileCount(ProfileCounter::Languages);
             language.Strength = language.Strength * 0.9 + getRandomDouble(-1.0, 1.0) * 0.1;
 
             // ログ
-            const auto dif = LanguageDifference::CreateChangeStrength(ID, Section, language.Strength);
-            languageDifference.emplace_back(dif);
+            AddDifference(LanguageDifference::CreateChangeStrength(place, Section, language.Strength));
         }
     }
 }
 
 void LanguageSystem::RemoveWordRandom(const double pWordLoss)
 {
+    ProfileScope profile(ProfileStage::RemoveWordRandom);
     for (auto &[ID, language] : LanguageMap)
     {
+        const int place = Graph.FindPlace(ID);
         // 単語が脱落するかどうか
         if (getWithProbability(pWordLoss))
         {
             if (language.Words.empty())
                 return;
+            addProfileCount(ProfileCounter::Languages);
+            addProfileCount(ProfileCounter::Words, language.Words.size());
 
-            std::map<std::vector<Phonetics>, std::vector<int>> mapProtoWordToWordIndice;
-            for (const auto &[id, word] : language.Words)
+            // 一時データは世代の一時領域に置く（キーは語彙の中の発音を指す）
+            std::pmr::memory_resource *resource = Arena.Resource();
+            std::pmr::map<std::span<const Phonetics>, std::pmr::vector<int>, SoundsLess> mapProtoWordToWordIndice(resource);
+            for (const auto &[id, word] : std::as_const(language.Words))
             {
                 mapProtoWordToWordIndice[word.NearestProtoWord].push_back(id);
             }
 
-            std::vector<int> duplicatedIds;
+            std::pmr::vector<int> duplicatedIds(resource);
             for (const auto &[key, ids] : mapProtoWordToWordIndice)
             {
                 if (ids.size() > 1)
@@ -943,8 +1497,7 @@ void LanguageSystem::RemoveWordRandom(const double pWordLoss)
                 language.Words.erase(targetId); // mapのキー指定削除はO(log N)
 
                 // ログ
-                const auto dif = LanguageDifference::CreateRemoveWord(ID, Section, targetId);
-                languageDifference.emplace_back(dif);
+                AddDifference(LanguageDifference::CreateRemoveWord(place, Section, targetId));
             }
         }
     }
@@ -952,8 +1505,11 @@ void LanguageSystem::RemoveWordRandom(const double pWordLoss)
 
 void LanguageSystem::CreateWord(const double pWordBirth)
 {
+    ProfileScope profile(ProfileStage::CreateWord);
+    NearestProtoWordFinder nearestProtoWord(ProtoLanguage, Arena.Resource());
     for (auto &[ID, language] : LanguageMap)
     {
+        const int place = Graph.FindPlace(ID);
         // 単語を追加するかどうか
         if (getWithProbability(pWordBirth))
         {
@@ -961,32 +1517,36 @@ void LanguageSystem::CreateWord(const double pWordBirth)
             {
                 return;
             }
-            const auto wordID1 = getRandomInt(0, (int)language.Words.size() - 1);
-            const auto word1 = language.Words[wordID1];
-            const auto wordID2 = getRandomInt(0, (int)language.Words.size() - 1);
-            const auto word2 = language.Words[wordID2];
+            addProfileCount(ProfileCounter::Languages);
+            addProfileCount(ProfileCounter::Words, 2);
+            // 単語IDは連番とは限らないので、位置で選ぶ
+            const auto &words = std::as_const(language.Words);
+            const auto it1 = std::next(words.begin(), getRandomInt(0, (int)words.size() - 1));
+            const auto it2 = std::next(words.begin(), getRandomInt(0, (int)words.size() - 1));
+            const int wordID1 = it1->first;
+            const int wordID2 = it2->first;
+            const auto &word1 = it1->second;
+            const auto &word2 = it2->second;
 
             auto newWord = word1.Add(word2);
-            newWord.UpdateNearestProtoWord(ProtoLanguage);
+            nearestProtoWord.Update(newWord);
 
             const int newWordId = language.Words.rbegin()->first + 1;
-            language.Words[newWordId] = newWord;
+            language.Words[newWordId] = std::move(newWord);
 
             // ログ出力
-            const auto dif = LanguageDifference::CreateAddCompoundWord(ID, Section, newWordId, {wordID1, wordID2});
-            languageDifference.emplace_back(dif);
+            AddDifference(LanguageDifference::CreateAddCompoundWord(place, Section, newWordId, {wordID1, wordID2}));
         }
     }
 }
 
 bool LanguageSystem::HasAllPlaceLanguage()
 {
-    const auto activePlaces = getNonEmptyStrings(Map);
-    for (const auto &place : activePlaces)
+    for (const auto &place : Graph.Places)
     {
         // find を使うことで「存在チェック」と「データアクセス」を1回で済ませる
-        auto it = LanguageMap.find(place);
-        if (it == LanguageMap.end() || it->second.Words.empty())
+        auto it = std::as_const(LanguageMap).find(place);
+        if (it == LanguageMap.Get().end() || it->second.Words.empty())
         {
             return false;
         }
@@ -996,358 +1556,101 @@ bool LanguageSystem::HasAllPlaceLanguage()
 
 void LanguageSystem::ToNextSection()
 {
+    ProfileScope profile(ProfileStage::ToNextSection);
+    if (Sink)
+        Sink->EndSection(*this);
+    Arena.Reset();
     Section++;
 }
 
 // 単一の差分を適用する
 void LanguageSystem::ApplyDifference(const LanguageDifference &diff)
 {
-    const auto places = getNonEmptyStrings(Map);
-    PhoneticsConverter converter = PhoneticsConverter::Create(PhoneticsMap);
+    ReplayEngine(*this).Apply(diff);
+}
 
-    switch (diff.Type)
-    {
-    case LanguageDifferenceType::AddWord:
+LanguageSystem LanguageSystem::Fork()
+{
+    // 自身の差分を変更しない区間に移し、分岐先と共有する
+    if (!languageDifference.empty())
     {
-        LanguageMap[diff.StringParam[0]].Words[diff.IntParam[0]].Sounds = converter.convertToPhonetics(diff.StringParam[1]);
-        LanguageMap[diff.StringParam[0]].Words[diff.IntParam[0]].Meanings = diff.MeaningChange;
-        break;
+        auto segment = std::make_shared<DifferenceSegment>();
+        segment->Parent = BaseDifference;
+        segment->Records = std::move(languageDifference);
+        languageDifference.clear();
+        BaseDifference = std::move(segment);
     }
+    LanguageSystem result = *this;
+    result.Sink.reset();
+    return result;
+}
 
-    case LanguageDifferenceType::ChangeStrength:
+void LanguageSystem::AddDifference(LanguageDifference &&diff)
+{
+    addProfileCount(ProfileCounter::Differences);
+    if (Sink)
     {
-        LanguageMap[diff.StringParam[0]].Strength = diff.DoubleParam[0];
-        break;
+        Sink->Write(diff);
     }
-
-    case LanguageDifferenceType::ChangeSound:
+    if (KeepDifferences)
     {
-        auto itWord = LanguageMap[diff.StringParam[0]].Words.find(diff.IntParam[0]);
-        if (itWord != LanguageMap[diff.StringParam[0]].Words.end())
-        {
-            // 音韻変化を適用（インプレース更新）
-            const auto &sc = diff.SoundChanges;
-            std::vector<Phonetics> nextSounds;
-            nextSounds.reserve(itWord->second.Sounds.size());
-
-            for (size_t i = 0; i < itWord->second.Sounds.size(); ++i)
-            {
-                bool isMatch = (itWord->second.Sounds[i] == sc.beforePhon);
-                if (isMatch)
-                {
-                    if (sc.Condition == SoundChangeCondition::Start && i != 0)
-                        isMatch = false;
-                    else if (sc.Condition == SoundChangeCondition::End && i != itWord->second.Sounds.size() - 1)
-                        isMatch = false;
-                    else if (sc.Condition == SoundChangeCondition::Middle && (i == 0 || i == itWord->second.Sounds.size() - 1))
-                        isMatch = false;
-                }
-                if (isMatch)
-                {
-                    if (!sc.IsRemove)
-                        nextSounds.push_back(sc.AfterPhone);
-                }
-                else
-                {
-                    nextSounds.push_back(itWord->second.Sounds[i]);
-                }
-            }
-            itWord->second.Sounds = std::move(nextSounds);
-        }
-        break;
+        languageDifference.emplace_back(std::move(diff));
     }
+}
 
-    case LanguageDifferenceType::ChangeMeaning:
+void LanguageSystem::ForEachDifference(const std::function<void(const LanguageDifference &)> &func) const
+{
+    // 区間は新しい順につながっているので、古い順に並べ直す
+    std::vector<const DifferenceSegment *> segments;
+    for (const DifferenceSegment *segment = BaseDifference.get(); segment != nullptr; segment = segment->Parent.get())
     {
-        auto itWord = LanguageMap[diff.StringParam[0]].Words.find(diff.IntParam[0]);
-        if (itWord != LanguageMap[diff.StringParam[0]].Words.end())
-        {
-            itWord->second.Meanings = diff.MeaningChange;
-            itWord->second.UpdateNearestProtoWord(ProtoLanguage);
-        }
-        break;
+        segments.push_back(segment);
     }
-
-    case LanguageDifferenceType::BorrowWord:
+    for (auto it = segments.rbegin(); it != segments.rend(); ++it)
     {
+        for (const auto &diff : (*it)->Records)
         {
-            auto itSrc = LanguageMap[diff.StringParam[0]].Words.find(diff.IntParam[0]);
-            auto itDst = LanguageMap[diff.StringParam[1]].Words.find(diff.IntParam[1]);
-            if (itSrc != LanguageMap[diff.StringParam[0]].Words.end() && itDst != LanguageMap[diff.StringParam[1]].Words.end())
-            {
-                // 借用：音素列をコピー
-                itDst->second.Sounds = itSrc->second.Sounds;
-            }
-            break;
+            func(diff);
         }
     }
-
-    case LanguageDifferenceType::AddCompoundWord:
+    for (const auto &diff : languageDifference)
     {
-        Word newWord;
-        bool first = true;
-        // IntParam[2]以降に合成元の単語IDリストが格納されている
-        for (size_t i = 1; i < diff.IntParam.size(); ++i)
-        {
-            auto itPart = LanguageMap[diff.StringParam[0]].Words.find(diff.IntParam[i]);
-            if (itPart != LanguageMap[diff.StringParam[0]].Words.end())
-            {
-                if (first)
-                {
-                    newWord = itPart->second;
-                    first = false;
-                }
-                else
-                    newWord = newWord.Add(itPart->second);
-            }
-        }
-        newWord.UpdateNearestProtoWord(ProtoLanguage);
-        LanguageMap[diff.StringParam[0]].Words[diff.IntParam[0]] = std::move(newWord);
-        break;
+        func(diff);
     }
+}
 
-    case LanguageDifferenceType::Remove:
+size_t LanguageSystem::CountDifferences() const
+{
+    size_t result = languageDifference.size();
+    for (const DifferenceSegment *segment = BaseDifference.get(); segment != nullptr; segment = segment->Parent.get())
     {
-        LanguageMap[diff.StringParam[0]].Words.erase(diff.IntParam[0]);
-        break;
-    }
+        result += segment->Records.size();
     }
+    return result;
 }
 
-// 大量の差分を高速に適用する（IDマッピングをキャッシュ）
-void LanguageSystem::ApplyDifferences(const std::vector<LanguageDifference> &diffs)
+// 大量の差分を高速に適用する（変換表と場所の参照を一度だけ作る）
+void LanguageSystem::ApplyDifferences(const std::vector<LanguageDifference> &diffs, const unsigned int threadCount)
 {
-    for (const auto &diff : diffs)
-    {
-        ApplyDifference(diff);
-    }
+    ReplayEngine(*this).ApplyParallel(diffs, threadCount);
 }
 
 void LanguageSystem::Export(const std::string &filename)
 {
-    std::ofstream file(filename);
-    if (!file.is_open())
+    DifferenceLogWriter writer;
+    if (!writer.Open(filename, *this))
         return;
-
-    // 2. Map
-    file << "Map:\n";
-    for (const auto &row : Map)
-    {
-        file << "  - [";
-        for (size_t i = 0; i < row.size(); ++i)
-        {
-            file << row[i] << (i == row.size() - 1 ? "" : ", ");
-        }
-        file << "]\n";
-    }
-
-    // 3. PhoneticsMap
-    file << "PhoneticsMap:\n";
-    for (const auto &row : PhoneticsMap)
-    {
-        file << "  - [";
-        for (size_t i = 0; i < row.size(); ++i)
-        {
-            file << row[i] << (i == row.size() - 1 ? "" : ", ");
-        }
-        file << "]\n";
-    }
-
-    // 4. LanguageDifferences
-    file << "LanguageDifferences:\n";
-    for (const auto &diff : languageDifference)
-    {
-        file << "  - Section: " << diff.Section << "\n";
-        file << "    Type: " << static_cast<int>(diff.Type) << "\n";
-
-        file << "    IntParam:\n";
-        for (const auto &i : diff.IntParam)
-            file << "      - " << i << "\n";
-
-        file << "    DoubleParam:\n";
-        for (const auto &d : diff.DoubleParam)
-            file << "      - " << d << "\n";
-
-        file << "    StringParam:\n";
-        for (const auto &s : diff.StringParam)
-            file << "      - " << s << "\n";
-
-        file << "    SoundChange:\n";
-        file << "      Before:\n";
-        file << "        Place: " << diff.SoundChanges.beforePhon.Place << "\n";
-        file << "        Mannar: " << diff.SoundChanges.beforePhon.Mannar << "\n";
-        file << "      After:\n";
-        file << "        Place: " << diff.SoundChanges.AfterPhone.Place << "\n";
-        file << "        Mannar: " << diff.SoundChanges.AfterPhone.Mannar << "\n";
-        file << "      Condition: " << static_cast<int>(diff.SoundChanges.Condition) << "\n";
-        file << "      IsRemove: " << diff.SoundChanges.IsRemove << "\n";
-
-        file << "    MeaningChange:\n";
-        for (const auto &pair : diff.MeaningChange)
-        {
-            file << "      - Key: " << pair.first << "\n";
-            file << "        Value: " << pair.second << "\n";
-        }
-    }
+    ForEachDifference([&](const LanguageDifference &diff)
+                      { writer.Write(diff); });
+    writer.Close();
 }
 
 void LanguageSystem::Import(const std::string &filename)
 {
-    std::ifstream file(filename);
-    if (!file.is_open())
-        return;
-
-    enum Mode
-    {
-        Map_,
-        PhoneticsMap_,
-        LanguageDifferences_,
-    };
-
-    enum SubMode
-    {
-        Type_,
-        Section_,
-        IntParam_,
-        DoubleParam_,
-        StringParam_,
-        SoundChanges_,
-        MeaningChange_,
-    };
-
-    Mode mode;
-    SubMode subMode;
-    LanguageDifference dif;
-    bool b = false;
-
-    std::string line;
-    while (std::getline(file, line))
+    if (BinaryDifferenceLog::IsBinaryLog(filename))
     {
-        if (line == "Map:")
-        {
-            mode = Mode::Map_;
-            Map.clear();
-            continue;
-        }
-        else if (line == "PhoneticsMap:")
-        {
-            mode = Mode::PhoneticsMap_;
-            PhoneticsMap.clear();
-            continue;
-        }
-        else if (line == "LanguageDifferences:")
-        {
-            mode = Mode::LanguageDifferences_;
-            languageDifference.clear();
-            continue;
-        }
-
-        if (mode == Mode::Map_)
-        {
-            Map.emplace_back(parseYamlList(line));
-        }
-        else if (mode == Mode::PhoneticsMap_)
-        {
-            PhoneticsMap.emplace_back(parseYamlList(line));
-        }
-        else if (mode == Mode::LanguageDifferences_)
-        {
-            auto [key, value] = splitByColon(line);
-            if (key == "- Section")
-            {
-                if (b)
-                {
-                    languageDifference.emplace_back(dif);
-                    dif = LanguageDifference();
-                }
-                else
-                {
-                    b = true;
-                }
-                dif.Section = std::stoi(value);
-                continue;
-            }
-            else if (key == "Type")
-            {
-                dif.Type = static_cast<LanguageDifferenceType>(std::stoi(value));
-                continue;
-            }
-            else if (line == "    IntParam:")
-            {
-                subMode = SubMode::IntParam_;
-                continue;
-            }
-            else if (line == "    DoubleParam:")
-            {
-                subMode = SubMode::DoubleParam_;
-                continue;
-            }
-            else if (line == "    StringParam:")
-            {
-                subMode = SubMode::StringParam_;
-                continue;
-            }
-            else if (line == "    SoundChange:")
-            {
-                std::getline(file, line); // Before:
-                std::getline(file, line); // Place:
-                std::tie(key, value) = splitByColon(line);
-                const int beforePlace = std::stoi(value);
-                std::getline(file, line); // Mannar:
-                std::tie(key, value) = splitByColon(line);
-                const int beforeMannar = std::stoi(value);
-
-                std::getline(file, line); // After:
-                std::getline(file, line); // Place:
-                std::tie(key, value) = splitByColon(line);
-                const int afterPlace = std::stoi(value);
-                std::getline(file, line); // Mannar:
-                std::tie(key, value) = splitByColon(line);
-                const int afterMannar = std::stoi(value);
-
-                std::getline(file, line); // Condition:
-                std::tie(key, value) = splitByColon(line);
-                const auto condition = static_cast<SoundChangeCondition>(std::stoi(value));
-
-                std::getline(file, line); // IsRemove:
-                std::tie(key, value) = splitByColon(line);
-                const bool isRemove = static_cast<bool>(std::stoi(value));
-
-                dif.SoundChanges.beforePhon.Place = beforePlace;
-                dif.SoundChanges.beforePhon.Mannar = beforeMannar;
-                dif.SoundChanges.AfterPhone.Place = afterPlace;
-                dif.SoundChanges.AfterPhone.Mannar = afterMannar;
-                dif.SoundChanges.Condition = condition;
-                dif.SoundChanges.IsRemove = isRemove;
-                continue;
-            }
-            else if (line == "    MeaningChange:")
-            {
-                subMode = SubMode::MeaningChange_;
-                continue;
-            }
-
-            if (subMode == SubMode::IntParam_)
-            {
-                dif.IntParam.emplace_back(std::stoi(line.substr(8)));
-            }
-            else if (subMode == SubMode::DoubleParam_)
-            {
-                dif.DoubleParam.emplace_back(std::stod(line.substr(8)));
-            }
-            else if (subMode == SubMode::StringParam_)
-            {
-                dif.StringParam.emplace_back(line.substr(8));
-            }
-            else if (subMode == SubMode::MeaningChange_)
-            {
-                std::getline(file, line);
-                const auto [_1, key2] = splitByColon(line);
-                std::getline(file, line);
-                const auto [_2, value2] = splitByColon(line);
-                dif.MeaningChange[key2] = std::stod(value2);
-            }
-        }
+        ImportBinary(filename);
+        return;
     }
-    languageDifference.emplace_back(dif);
+    ImportYaml(filename);
 }
\ No newline at end of file
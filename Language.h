@@ -1,8 +1,20 @@
+#pragma once
 #include "Utility.h"
 #include "Random.h"
+#include "Geography.h"
+#include "CopyOnWrite.h"
+#include "Arena.h"
+#include <array>
+#include <span>
+#include <string_view>
 #include <vector>
+#include <cstdint>
 #include <string>
 #include <map>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <unordered_map>
 
 /**
  * @brief 音韻
@@ -33,6 +45,9 @@ struct Phonetics
     }
 };
 
+// 子音と母音の境界（調音方法がこれ以下なら子音）
+constexpr int MAX_CONSONANT_MANNAR = 3;
+
 /**
  * @brief 意味ベクトル
  *
@@ -115,6 +130,14 @@ struct Word
     void UpdateNearestProtoWord(const Language &language);
 };
 
+/**
+ * @brief 語彙（単語ID -> 単語）
+ *
+ * @note コピーは O(1)、書き込み時に複製する。
+ * @note 単語は単語IDの昇順に1つの配列に並べる（走査は線形、追加・削除で他の単語への参照は無効になる）。
+ */
+using Vocabulary = CopyOnWriteFlatMap<int, Word>;
+
 /**
  * @brief 言語
  *
@@ -122,11 +145,119 @@ struct Word
 struct Language
 {
     // 影響度、大きい方から小さいほうへ単語が借用される
-    double Strength;
+    double Strength = 0.0;
     // 語彙
-    std::map<int, Word> Words;
+    Vocabulary Words;
+};
+
+/**
+ * @brief 単語の列形式の範囲（列ごとにコピーせずに参照する）
+ *
+ * @note 列形式の結果ファイル（ColumnarResult）と列形式の語彙（VocabularyColumns）の単語を、Word の代わりに読むための型。
+ */
+struct ColumnarWords
+{
+    // 単語ID
+    std::span<const int32_t> IDs;
+    // 対応する祖語の単語ID（NearestProtoWord と音素列が同じ祖語の単語のうち最小のもの、なければ -1）
+    std::span<const int32_t> ProtoIDs;
+    // 単語ごとの音素列の始まりの位置（単語数 + 1、AllSounds 内の位置）
+    std::span<const uint64_t> SoundOffsets;
+    // 単語ごとの意味の始まりの位置（単語数 + 1、AllMeaningKeys 内の位置）
+    std::span<const uint64_t> MeaningOffsets;
+    // 全体の音素列
+    std::span<const Phonetics> AllSounds;
+    // 全体の意味（文字列番号）と重み
+    std::span<const uint32_t> AllMeaningKeys;
+    std::span<const double> AllMeaningWeights;
+
+    size_t Size() const { return IDs.size(); }
+
+    /**
+     * @brief 単語の音素列
+     *
+     * @param index 範囲内の番号
+     */
+    std::span<const Phonetics> Sounds(const size_t index) const;
+
+    /**
+     * @brief 単語の意味（文字列番号）
+     *
+     * @param index 範囲内の番号
+     */
+    std::span<const uint32_t> MeaningKeys(const size_t index) const;
+
+    /**
+     * @brief 単語の意味の重み（MeaningKeys と同じ順）
+     *
+     * @param index 範囲内の番号
+     */
+    std::span<const double> MeaningWeights(const size_t index) const;
 };
 
+/**
+ * @brief 列形式の語彙（単語ごとの構造体の代わりに、単語ID・音素列・意味・祖語の単語IDを列ごとに連続した配列で持つ）
+ *
+ * @note 段階が必要な列だけを先頭から順に読むために、段階の呼び出しごとに語彙から作る（Language は語彙を Word の形でだけ持つ）。音素列と意味は全単語で1つの配列にまとめ、単語ごとの位置で区切る。
+ * @note 意味は文字列番号で持ち、単語の中では Meaning と同じ順（文字列の昇順）に並べる。文字列番号の表は語彙の意味の文字列を指すので、語彙より長く使わない。
+ */
+class VocabularyColumns
+{
+public:
+    /**
+     * @brief 空の列を作る
+     *
+     * @param resource 列の確保先（段階の中だけで使うなら LanguageSystem::Arena）
+     */
+    explicit VocabularyColumns(std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+    /**
+     * @brief 語彙を列形式にする（これまでの中身は消す）
+     *
+     * @param words 語彙
+     * @param proto 祖語（NearestProtoWord に対応する祖語の単語IDを求める。nullptr ならすべて -1）
+     */
+    void Assign(const Vocabulary &words, const Language *proto = nullptr);
+
+    /**
+     * @brief 単語の列
+     *
+     * @return 列の範囲（単語IDの昇順、語彙の並びと同じ）
+     */
+    ColumnarWords Words() const;
+
+    /**
+     * @brief 意味の文字列番号
+     *
+     * @param meaning 意味の文字列
+     * @return 文字列番号（この語彙に無い意味なら -1）
+     */
+    int64_t FindMeaning(std::string_view meaning) const;
+
+    /**
+     * @brief 意味の文字列の数（文字列番号は 0 からこの数未満）
+     *
+     */
+    size_t MeaningCount() const { return meaningIndices.size(); }
+
+private:
+    std::pmr::vector<int32_t> ids;
+    std::pmr::vector<int32_t> protoIDs;
+    std::pmr::vector<uint64_t> soundOffsets;
+    std::pmr::vector<Phonetics> sounds;
+    std::pmr::vector<uint64_t> meaningOffsets;
+    std::pmr::vector<uint32_t> meaningKeys;
+    std::pmr::vector<double> meaningWeights;
+    std::pmr::unordered_map<std::string_view, uint32_t> meaningIndices;
+};
+
+/**
+ * @brief 地理と言語の対応（場所名 -> 言語）
+ *
+ * @note コピーは O(1)、書き込み時に複製する。
+ */
+using LanguageTable = CopyOnWriteMap<std::string, Language>;
+
 /**
  * @brief 音韻変化の条件
  *
@@ -148,172 +279,372 @@ enum SoundChangeCondition
 struct SoundChange
 {
     // 変化前の音韻
-    Phonetics beforePhon;
+    Phonetics beforePhon = {0, 0};
     // 条件
-    SoundChangeCondition Condition;
+    SoundChangeCondition Condition = SoundChangeCondition::Start;
     // 音韻が消えるか
-    bool IsRemove;
+    bool IsRemove = false;
     // 変化前の音韻
-    Phonetics AfterPhone;
+    Phonetics AfterPhone = {0, 0};
 };
 
 /**
  * @brief 語族差分タイプ
  *
  */
-enum LanguageDifferenceType
+enum LanguageDifferenceType : uint8_t
 {
     // 単語追加
-    // string 地理
-    // int 単語ID
-    // string 語形
-    // Meaning 意味
+    // Place 地理
+    // WordID 単語ID
+    // WordForm 語形
     AddWord,
     // 影響度変化
-    // string 地理
-    // double 影響度
+    // Place 地理
+    // Strength 影響度
     ChangeStrength,
     // 音韻変化
-    // string 地理
-    // int 単語ID
-    // SoundChange 音韻変化
+    // Place 地理
+    // WordID 単語ID
+    // Sound 音韻変化
     ChangeSound,
     // 意味変化
-    // string 地理
-    // int 単語ID
-    // Meaning 意味変化
+    // Place 地理
+    // WordID 単語ID
+    // Meanings 意味変化
     ChangeMeaning,
     // 借用
-    // string 地理
-    // int 借用元単語ID
-    // string 地理
-    // int 借用先単語ID
+    // Source.Place 借用元地理
+    // Source.WordID 借用元単語ID
+    // Place 借用先地理
+    // WordID 借用先単語ID
     BorrowWord,
     // 複合語
-    // string 地理
-    // int 単語ID
-    // int... 参照単語ID
+    // Place 地理
+    // WordID 単語ID
+    // Parts 参照単語ID
     AddCompoundWord,
     // 死語
-    // string 地理
-    // int 単語ID
-    Remove
+    // Place 地理
+    // WordID 単語ID
+    Remove,
+    // 言語の複写（空の地域への拡散）
+    // Source.Place 複写元地理
+    // Place 複写先地理
+    CopyLanguage
+};
+
+/**
+ * @brief 語族差分の可変長データ（単語追加・意味変化のみ）
+ *
+ */
+struct DifferencePayload
+{
+    // 語形
+    std::string WordForm;
+    // 意味
+    Meaning Meanings;
+};
+
+/**
+ * @brief 音韻変化（差分用の詰めた形式）
+ *
+ */
+struct PackedSoundChange
+{
+    int16_t BeforeMannar;
+    int16_t BeforePlace;
+    int16_t AfterMannar;
+    int16_t AfterPlace;
 };
 
 /**
  * @brief 語族差分
  *
+ * @note 24バイト固定長のタグ付き共用体。Type によって共用体のどのメンバを使うかが決まる。
+ * @note 単語追加と意味変化以外はヒープを確保しない。
  */
 struct LanguageDifference
 {
     // タイプ
-    LanguageDifferenceType Type;
+    LanguageDifferenceType Type = LanguageDifferenceType::AddWord;
+    // 音韻変化の条件（ChangeSound）
+    uint8_t SoundCondition = 0;
+    // 音韻が消えるか（ChangeSound）
+    uint8_t SoundIsRemove = 0;
+    // 参照単語の数（AddCompoundWord）
+    uint8_t PartCount = 0;
     // 時代
-    int Section;
-    // 整数パラメータ
-    std::vector<int> IntParam;
-    // 実数パラメータ
-    std::vector<double> DoubleParam;
-    // 文字列パラメータ
-    std::vector<std::string> StringParam;
-    // 音韻変化（あとで消す）
-    SoundChange SoundChanges;
-    // 意味変化（あとで消す）
-    Meaning MeaningChange;
+    int Section = 0;
+    // 地理（場所ID）
+    int Place = 0;
+    // 単語ID
+    int WordID = 0;
+    union
+    {
+        // 影響度（ChangeStrength）
+        double Strength = 0.0;
+        // 音韻変化（ChangeSound）
+        PackedSoundChange Sound;
+        // 借用元（BorrowWord）・複写元（CopyLanguage）
+        struct
+        {
+            int Place;
+            int WordID;
+        } Source;
+        // 参照単語ID（AddCompoundWord）
+        int Parts[2];
+        // 可変長データ（AddWord, ChangeMeaning）
+        DifferencePayload *Payload;
+    };
+
+    // 複合語の参照単語の最大数
+    static constexpr int MAX_PARTS = 2;
+
+    LanguageDifference() = default;
+    LanguageDifference(const LanguageDifference &other);
+    LanguageDifference(LanguageDifference &&other) noexcept;
+    LanguageDifference &operator=(const LanguageDifference &other);
+    LanguageDifference &operator=(LanguageDifference &&other) noexcept;
+    ~LanguageDifference();
+
+    /**
+     * @brief 可変長データを持つタイプか
+     *
+     */
+    bool HasPayload() const
+    {
+        return Type == LanguageDifferenceType::AddWord || Type == LanguageDifferenceType::ChangeMeaning;
+    }
+
+    /**
+     * @brief 音韻変化を取得
+     *
+     */
+    SoundChange GetSoundChange() const;
+
+    /**
+     * @brief 語形を取得（AddWord）
+     *
+     */
+    const std::string &GetWordForm() const;
+
+    /**
+     * @brief 意味を取得（AddWord, ChangeMeaning）
+     *
+     */
+    const Meaning &GetMeaning() const;
+
     /**
      * @brief Create a Add 単語 object
      *
-     * @param ID 言語ID
+     * @param place 場所ID
      * @param section 時代
      * @param wordID 単語ID
      * @param wordForm 語形
+     * @param meaning 意味
      * @return LanguageDifference
      */
-    static LanguageDifference CreateAddWord(const std::string &ID, const int section, const int wordID, const std::string &wordForm);
+    static LanguageDifference CreateAddWord(const int place, const int section, const int wordID, const std::string &wordForm, const Meaning &meaning = {});
     /**
      * @brief Change 言語 影響度
      *
-     * @param ID 言語ID
+     * @param place 場所ID
      * @param section 時代
      * @param strength 影響度
      * @return LanguageDifference
      */
-    static LanguageDifference CreateChangeStrength(const std::string &ID, const int section, const double strength);
+    static LanguageDifference CreateChangeStrength(const int place, const int section, const double strength);
     /**
      * @brief Change 言語 音韻
      *
-     * @param ID 言語ID
+     * @param place 場所ID
      * @param section 時代
      * @param wordID 単語ID
      * @param soundChange 音韻変化
      * @return LanguageDifference
      */
-    static LanguageDifference CreateChangeSound(const std::string &ID, const int section, const int wordID, const SoundChange soundChange);
+    static LanguageDifference CreateChangeSound(const int place, const int section, const int wordID, const SoundChange &soundChange);
     /**
      * @brief Change 単語の意味
      *
-     * @param ID 言語ID
+     * @param place 場所ID
      * @param section 時代
      * @param wordID 単語ID
      * @param meaning 意味変化
      * @return LanguageDifference
      */
-    static LanguageDifference CreateChangeMeaning(const std::string &ID, const int section, const int wordID, const Meaning meaning);
+    static LanguageDifference CreateChangeMeaning(const int place, const int section, const int wordID, const Meaning &meaning);
     /**
      * @brief 借用
      *
-     * @param ID1 借用元言語ID
-     * @param ID2 借用先言語ID
+     * @param place1 借用元場所ID
+     * @param place2 借用先場所ID
      * @param section 時代
      * @param wordID1 借用元単語ID
      * @param wordID2 借用先単語ID
      * @return LanguageDifference
      */
-    static LanguageDifference CreateBorrowWord(const std::string &ID1, const std::string &ID2, const int section, const int wordID1, const int wordID2);
+    static LanguageDifference CreateBorrowWord(const int place1, const int place2, const int section, const int wordID1, const int wordID2);
     /**
      * @brief 複合語
      *
-     * @param ID 言語ID
+     * @param place 場所ID
      * @param section 時代
      * @param wordID 単語ID
-     * @param wordIDs 参照単語ID
+     * @param wordIDs 参照単語ID（MAX_PARTS 個まで）
      * @return LanguageDifference
      */
-    static LanguageDifference CreateAddCompoundWord(const std::string &ID, const int section, const int wordID, const std::vector<int> wordIDs);
+    static LanguageDifference CreateAddCompoundWord(const int place, const int section, const int wordID, const std::vector<int> &wordIDs);
     /**
      * @brief 単語削除
      *
-     * @param ID 言語ID
+     * @param place 場所ID
      * @param section 時代
      * @param wordID 単語ID
      * @return LanguageDifference
      */
-    static LanguageDifference CreateRemoveWord(const std::string &ID, const int section, const int wordID);
+    static LanguageDifference CreateRemoveWord(const int place, const int section, const int wordID);
+    /**
+     * @brief 言語の複写
+     *
+     * @param sourcePlace 複写元の場所ID
+     * @param place 複写先の場所ID
+     * @param section 時代
+     * @return LanguageDifference
+     */
+    static LanguageDifference CreateCopyLanguage(const int sourcePlace, const int place, const int section);
 };
+static_assert(sizeof(LanguageDifference) == 24);
 
 /**
  * @brief 音素 <-> 表記変換
  *
+ * @note 表記から音素へは、音素表から作ったバイト単位の字句解析の木（遷移表）で最長一致をとる（表記の長さに制限なし）。
+ * @note 音素から表記へは、音素の番号ごとの文字列を1つにつなげた表を引く。
+ * @note 作った後の変換はどれもメモリを確保しない（std::vector を返すものと、一括変換の出力先の拡張を除く）。
  */
 struct PhoneticsConverter
 {
-    std::map<std::string, Phonetics> Map;
+    // バイトごとの文字の種類（表記に現れないバイトは 0）
+    std::array<uint8_t, 256> ByteClasses = {};
+    // 文字の種類の数
+    size_t ClassCount = 1;
+    // 遷移表（節点 × 文字の種類、遷移先の節点、なければ 0。節点 0 が根）
+    std::vector<uint32_t> Transitions;
+    // 節点ごとの、そこで終わる表記の音素（なければ Mannar が -1）
+    std::vector<Phonetics> Accepts;
+    // 音素表の行数と、最も長い行の列数（音素の番号は 行 × 列数 + 列、足りないセルは空の表記）
+    uint32_t RowCount = 0;
+    uint32_t ColumnCount = 0;
+    // 音素の番号ごとの、表記の Chars 内の始まりの位置（RowCount × ColumnCount + 1）
+    std::vector<uint32_t> CharOffsets;
+    // 表記をつなげたもの
+    std::string Chars;
+
     PhoneticsConverter static Create(const std::vector<std::vector<std::string>> &table);
 
     /**
      * 文字列を変換表に基づいて音素列に変換する
      * @param str 文字列
-     * @param table 音素表
      */
-    std::vector<Phonetics> convertToPhonetics(const std::string &str);
+    std::vector<Phonetics> convertToPhonetics(const std::string &str) const;
+
+    /**
+     * @brief 文字列を音素列に変換する（出力先は呼び出し側が用意する）
+     *
+     * @param str 文字列
+     * @param output 出力先（str.size() 個以上の領域）
+     * @return 音素の数
+     *
+     * @note 最長一致で音素を切り出し、どの表記にも一致しないバイトは読み飛ばす。
+     */
+    size_t convertToPhonetics(std::string_view str, Phonetics *output) const;
+
+    /**
+     * @brief 文字列の配列をまとめて音素列に変換する
+     *
+     * @param strs 文字列の配列
+     * @param sounds 音素列をつなげたもの（末尾に追記）
+     * @param offsets 文字列ごとの sounds 内の終わりの位置（末尾に追記）
+     */
+    void convertToPhonetics(std::span<const std::string> strs, std::vector<Phonetics> &sounds, std::vector<uint64_t> &offsets) const;
+
+    /**
+     * @brief 音素の表記
+     *
+     * @param phonetics 音素
+     * @return 表記（音素表にない音素なら空）
+     */
+    std::string_view GetString(const Phonetics &phonetics) const
+    {
+        if ((uint32_t)phonetics.Mannar >= RowCount || (uint32_t)phonetics.Place >= ColumnCount)
+            return {};
+        const uint32_t code = phonetics.Mannar * ColumnCount + phonetics.Place;
+        return {Chars.data() + CharOffsets[code], CharOffsets[code + 1] - CharOffsets[code]};
+    }
+
+    /**
+     * @brief 音素列の表記のバイト数
+     *
+     * @param sounds 音素列
+     */
+    size_t GetStringLength(std::span<const Phonetics> sounds) const;
+
+    /**
+     * @brief 音素列を文字列に変換する（出力先は呼び出し側が用意する）
+     *
+     * @param sounds 音素列
+     * @param output 出力先（GetStringLength バイト以上の領域）
+     * @return 書き込んだ末尾
+     */
+    char *convertToString(std::span<const Phonetics> sounds, char *output) const;
+
+    /**
+     * @brief 音素列を文字列に変換して末尾に加える
+     *
+     * @param sounds 音素列
+     * @param output 出力先
+     */
+    void appendString(std::span<const Phonetics> sounds, std::string &output) const;
+
+    /**
+     * @brief 音素列を文字列に変換する
+     *
+     * @param sounds 音素列
+     * @return 文字列
+     */
+    std::string convertToString(std::span<const Phonetics> sounds) const;
+
+    /**
+     * @brief 言語の語彙をまとめて文字列に変換する
+     *
+     * @param words 語彙
+     * @param chars 文字列をつなげたもの（末尾に追記）
+     * @param offsets 単語ごとの chars 内の終わりの位置（単語ID 順、末尾に追記）
+     */
+    void convertToString(const Vocabulary &words, std::string &chars, std::vector<uint64_t> &offsets) const;
 
     /**
      * @brief 文字列の配列を言語に変換する
      * @param strs 文字列の配列
-     * @param table 音素表
      * @return 言語
      */
-    Language convertToLanguage(const std::vector<std::string> &strs);
+    Language convertToLanguage(const std::vector<std::string> &strs) const;
+};
+
+class DifferenceSink;
+
+/**
+ * @brief 差分の区間（分岐元と共有する、変更しない部分）
+ *
+ */
+struct DifferenceSegment
+{
+    // さらに前の区間
+    std::shared_ptr<const DifferenceSegment> Parent;
+    // 差分
+    std::vector<LanguageDifference> Records;
 };
 
 /**
@@ -326,14 +657,41 @@ struct LanguageSystem
     int Section = 0;
     // 地理
     std::vector<std::vector<std::string>> Map;
+    // 地理（隣接グラフ）
+    Geography Graph;
     // 音韻
     std::vector<std::vector<std::string>> PhoneticsMap;
     // 地理と言語の対応
-    std::map<std::string, Language> LanguageMap;
+    LanguageTable LanguageMap;
     // 祖語
     Language ProtoLanguage;
+    // 分岐元と共有する差分（languageDifference より前）
+    std::shared_ptr<const DifferenceSegment> BaseDifference;
     // 祖語からの差分
     std::vector<LanguageDifference> languageDifference;
+    // 差分の出力先（設定すると記録と同時に書き出す）
+    std::shared_ptr<DifferenceSink> Sink;
+    // 差分をメモリ上（languageDifference）にも残すか
+    bool KeepDifferences = true;
+    // 段階の一時データの確保先（ToNextSection で捨てる）
+    GenerationArena Arena;
+
+    /**
+     * @brief 差分を記録する
+     *
+     * @param diff 差分
+     *
+     * @note Sink があれば書き出し、KeepDifferences なら languageDifference に追加する。
+     */
+    void AddDifference(LanguageDifference &&diff);
+
+    /**
+     * @brief 地図データを設定する
+     *
+     * @param mapData 格子状の地図、または辺リスト形式のCSV
+     */
+    void SetMap(const std::vector<std::vector<std::string>> &mapData);
+
     /**
      * 地図データの特定の位置に祖語を配置する
      * @param startPlace 祖語を配置する位置
@@ -412,8 +770,19 @@ struct LanguageSystem
     /**
      * Language構造体のリストをCSVに出力する
      * @param filename 出力ファイル名
+     * @param threadCount 行を作るスレッド数（0 ならハードウェアのスレッド数）
+     */
+    void ExportLanguageToCSV(const std::string &filename, const unsigned int threadCount = 0);
+
+    /**
+     * @brief 最終状態を列形式の結果ファイルに出力する（場所・祖語・言語ごとの単語表・影響度）
+     *
+     * @param filename 出力ファイル名
+     * @return 成功したら true
+     *
+     * @note ColumnarResult でメモリマップして、文字列に戻さずに読める。
      */
-    void ExportLanguageToCSV(const std::string &filename);
+    bool ExportColumnar(const std::string &filename) const;
 
     /**
      * @brief 各地に言語があるか
@@ -426,6 +795,8 @@ struct LanguageSystem
     /**
      * @brief 時代を進める
      *
+     * @note Sink があれば、進める前に時代の終わりを知らせる（DifferenceSink::EndSection）。
+     * @note 段階の一時データ（Arena）を捨てる。
      */
     void ToNextSection();
 
@@ -433,6 +804,8 @@ struct LanguageSystem
      * @brief 差分を適用
      *
      * @param diff 差分
+     *
+     * @note 呼ぶたびに変換表を作るので、1件ずつ多数適用するなら ReplayEngine（Replay.h）を使い回す。
      */
     void ApplyDifference(const LanguageDifference &diff);
 
@@ -440,8 +813,9 @@ struct LanguageSystem
      * @brief 差分を複数適用
      *
      * @param diffs 差分
+     * @param threadCount スレッド数（1 なら順に適用、0 ならハードウェアのスレッド数で場所ごとに並列に適用）
      */
-    void ApplyDifferences(const std::vector<LanguageDifference> &diffs);
+    void ApplyDifferences(const std::vector<LanguageDifference> &diffs, const unsigned int threadCount = 1);
 
     /**
      * @brief 差分をファイル出力
@@ -449,12 +823,88 @@ struct LanguageSystem
      */
     void Export(const std::string &filename);
 
+    /**
+     * @brief 差分をバイナリ形式でファイル出力
+     *
+     * @note メモリマップして読み込める。時代ごとの索引を持つ（DifferenceLog.h）。
+     */
+    void ExportBinary(const std::string &filename);
+
     /**
      * @brief ファイル読み込み
      *
-     * @param filename ファイルパス
+     * @param filename ファイルパス（YAML、またはバイナリ形式の差分ログ）
      */
     void Import(const std::string &filename);
+
+    /**
+     * @brief YAML 形式の差分ログの読み込み
+     *
+     * @param filename ファイルパス
+     * @return 成功したら true（失敗したら状態は変更しない）
+     *
+     * @note Export が書き出す形式だけを受け付け、誤りは行と列を添えて報告する。
+     */
+    bool ImportYaml(const std::string &filename);
+
+    /**
+     * @brief バイナリ形式の差分ログの読み込み
+     *
+     * @param filename ファイルパス
+     * @return 成功したら true（失敗したら状態は変更しない）
+     */
+    bool ImportBinary(const std::string &filename);
+
+    /**
+     * @brief 分岐させる
+     *
+     * @return 現在の状態を共有した語族
+     *
+     * @note 言語・語彙・差分は共有し、書き込み時に複製するため O(1)。地図と音素表はコピーする。
+     * @note 分岐後は互いに独立して変化させられ、別スレッドで進めてもよい。
+     * @note 分岐先には Sink を引き継がない。
+     */
+    LanguageSystem Fork();
+
+    /**
+     * @brief すべての差分を古い順に走査する
+     *
+     * @param func 差分ごとに呼ぶ関数
+     */
+    void ForEachDifference(const std::function<void(const LanguageDifference &)> &func) const;
+
+    /**
+     * @brief 差分の総数
+     *
+     */
+    size_t CountDifferences() const;
+
+    /**
+     * @brief 差分を圧縮する（再生した結果に影響しない差分を取り除く）
+     *
+     * @param retainedSections 状態を保つ時代（現在の状態は常に保つ）
+     *
+     * @note 分岐元と共有する差分も含めて圧縮し、分岐元との共有はやめる。詳細は compactDifferences（Compaction.h）。
+     */
+    void CompactDifferences(const std::vector<int> &retainedSections = {});
+
+    /**
+     * @brief 状態をバイナリのスナップショットに保存する
+     *
+     * @param filename ファイルパス
+     * @return 成功したら true
+     *
+     * @note 言語・単語・意味・差分・乱数の状態・時代をすべて含む。
+     */
+    bool SaveSnapshot(const std::string &filename) const;
+
+    /**
+     * @brief バイナリのスナップショットから状態を復元する
+     *
+     * @param filename ファイルパス
+     * @return 成功したら true（失敗したら状態は変更しない）
+     */
+    bool LoadSnapshot(const std::string &filename);
 };
 
 /**
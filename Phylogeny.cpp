@@ -0,0 +1,537 @@
+#include "Phylogeny.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+    constexpr float INFINITE_DISTANCE = std::numeric_limits<float>::infinity();
+
+    // 下三角の距離行列（行 i には列 0 .. i-1 が連続して並ぶ）
+    class TriangularMatrix
+    {
+    public:
+        explicit TriangularMatrix(const DistanceMatrix &distances)
+            : values(distances.Size() * (distances.Size() - (distances.Size() > 0 ? 1 : 0)) / 2)
+        {
+            for (size_t i = 1; i < distances.Size(); ++i)
+            {
+                float *row = Row(i);
+                for (size_t j = 0; j < i; ++j)
+                {
+                    // 比べられない組は最大距離とする
+                    const double value = distances.At(i, j);
+                    row[j] = std::isnan(value) ? 1.0f : (float)value;
+                }
+            }
+        }
+
+        float *Row(const size_t i) { return values.data() + i * (i - 1) / 2; }
+        const float *Row(const size_t i) const { return values.data() + i * (i - 1) / 2; }
+        float &At(const size_t i, const size_t j) { return i > j ? Row(i)[j] : Row(j)[i]; }
+
+        /**
+         * @brief 行 from を行 to に移す（to < from、from 以降の行は使わなくなる）
+         */
+        void Move(const size_t from, const size_t to)
+        {
+            std::copy(Row(from), Row(from) + to, Row(to));
+            for (size_t k = to + 1; k < from; ++k)
+            {
+                Row(k)[to] = Row(from)[k];
+            }
+        }
+
+    private:
+        std::vector<float> values;
+    };
+
+    // 葉だけの木を作る
+    PhylogeneticTree createLeaves(const DistanceMatrix &distances)
+    {
+        PhylogeneticTree tree;
+        tree.Leaves = distances.Places;
+        tree.Nodes.resize(distances.Size());
+        for (size_t i = 0; i < distances.Size(); ++i)
+        {
+            tree.Nodes[i].Leaf = (int)i;
+        }
+        if (distances.Size() == 1)
+            tree.Root = 0;
+        return tree;
+    }
+
+    int addNode(PhylogeneticTree &tree, const int left, const int right, const double leftLength, const double rightLength)
+    {
+        PhylogeneticTree::Node node;
+        node.Children = {left, right};
+        node.Lengths = {std::max(0.0, leftLength), std::max(0.0, rightLength)};
+        tree.Nodes.push_back(node);
+        return (int)tree.Nodes.size() - 1;
+    }
+
+    // 行の列 0 .. i-1 の最小値とその位置
+    std::pair<float, size_t> getRowMinimum(const TriangularMatrix &matrix, const size_t i)
+    {
+        const float *row = matrix.Row(i);
+        float minimum = INFINITE_DISTANCE;
+        size_t position = 0;
+        for (size_t j = 0; j < i; ++j)
+        {
+            if (row[j] < minimum)
+            {
+                minimum = row[j];
+                position = j;
+            }
+        }
+        return {minimum, position};
+    }
+
+    // Newick 形式の名前（記号を含む名前は引用符で囲む）
+    void appendNewickName(std::string &output, const std::string &name)
+    {
+        if (name.find_first_of(" ,:;()[]'\t\n") == std::string::npos)
+        {
+            output += name;
+            return;
+        }
+        output += '\'';
+        for (const char c : name)
+        {
+            if (c == '\'')
+                output += '\'';
+            output += c;
+        }
+        output += '\'';
+    }
+
+    // 木の分割（葉の乱数の排他的論理和、葉の絞り込み後）
+    std::unordered_set<uint64_t> getSplits(const PhylogeneticTree &tree, const std::unordered_map<std::string, uint64_t> &leafHashes, const std::string &firstLeaf, const uint64_t total, const size_t leafCount)
+    {
+        std::unordered_set<uint64_t> splits;
+        if (tree.Root < 0)
+            return splits;
+        std::vector<uint64_t> hashes(tree.Nodes.size(), 0);
+        std::vector<size_t> counts(tree.Nodes.size(), 0);
+        std::vector<bool> hasFirst(tree.Nodes.size(), false);
+        // 子から先に処理するため、深さ優先の順を作って逆にたどる
+        std::vector<int> order;
+        std::vector<int> stack = {tree.Root};
+        while (!stack.empty())
+        {
+            const int node = stack.back();
+            stack.pop_back();
+            order.push_back(node);
+            for (const int child : tree.Nodes[node].Children)
+            {
+                if (child >= 0)
+                    stack.push_back(child);
+            }
+        }
+        for (auto it = order.rbegin(); it != order.rend(); ++it)
+        {
+            const auto &node = tree.Nodes[*it];
+            if (node.Leaf >= 0)
+            {
+                const auto &name = tree.Leaves[node.Leaf];
+                auto itHash = leafHashes.find(name);
+                if (itHash != leafHashes.end())
+                {
+                    hashes[*it] = itHash->second;
+                    counts[*it] = 1;
+                    hasFirst[*it] = name == firstLeaf;
+                }
+                continue;
+            }
+            for (const int child : node.Children)
+            {
+                if (child < 0)
+                    continue;
+                hashes[*it] ^= hashes[child];
+                counts[*it] += counts[child];
+                hasFirst[*it] = hasFirst[*it] || hasFirst[child];
+            }
+            // 両側に2つ以上の葉がある分割だけを数える（最初の葉を含まない側で表す）
+            if (counts[*it] >= 2 && counts[*it] + 2 <= leafCount)
+                splits.insert(hasFirst[*it] ? hashes[*it] ^ total : hashes[*it]);
+        }
+        return splits;
+    }
+
+    // 木の葉の名前
+    std::vector<std::string> getLeafNames(const PhylogeneticTree &tree)
+    {
+        std::vector<std::string> names;
+        for (const auto &node : tree.Nodes)
+        {
+            if (node.Leaf >= 0)
+                names.push_back(tree.Leaves[node.Leaf]);
+        }
+        return names;
+    }
+}
+
+std::string PhylogeneticTree::ToNewick() const
+{
+    std::string output;
+    if (Root < 0)
+        return ";";
+    // 深い木でもスタックがあふれないよう、再帰を使わずにたどる
+    struct Frame
+    {
+        int Node;
+        int Next;
+    };
+    std::ostringstream length;
+    std::vector<Frame> stack = {{Root, 0}};
+    while (!stack.empty())
+    {
+        auto &frame = stack.back();
+        const auto &node = Nodes[frame.Node];
+        if (node.Leaf >= 0)
+        {
+            appendNewickName(output, Leaves[node.Leaf]);
+            stack.pop_back();
+        }
+        else if (frame.Next < 2)
+        {
+            output += frame.Next == 0 ? '(' : ',';
+            const int child = node.Children[frame.Next++];
+            stack.push_back({child, 0});
+            continue;
+        }
+        else
+        {
+            output += ')';
+            stack.pop_back();
+        }
+        // 親への枝の長さ
+        if (!stack.empty())
+        {
+            const auto &parent = stack.back();
+            length.str("");
+            length << Nodes[parent.Node].Lengths[parent.Next - 1];
+            output += ':';
+            output += length.str();
+        }
+    }
+    output += ';';
+    return output;
+}
+
+bool PhylogeneticTree::ExportNewick(const std::string &filename) const
+{
+    std::ofstream file(filename.c_str());
+    if (!file.is_open())
+    {
+        std::cerr << "Error: ファイルを開けませんでした: " << filename << std::endl;
+        return false;
+    }
+    file << ToNewick() << "\n";
+    return true;
+}
+
+bool TreeComparison::ExportCSV(const std::string &filename) const
+{
+    std::ofstream file(filename.c_str());
+    if (!file.is_open())
+    {
+        std::cerr << "Error: ファイルを開けませんでした: " << filename << std::endl;
+        return false;
+    }
+    file << "common_leaves,inferred_splits,true_splits,shared_splits,robinson_foulds,normalized_robinson_foulds\n";
+    file << CommonLeaves << "," << InferredSplits << "," << TrueSplits << "," << SharedSplits << ","
+         << RobinsonFoulds << "," << NormalizedRobinsonFoulds << "\n";
+    return true;
+}
+
+PhylogeneticTree buildNeighborJoiningTree(const DistanceMatrix &distances)
+{
+    PhylogeneticTree tree = createLeaves(distances);
+    size_t m = distances.Size();
+    if (m < 2)
+        return tree;
+
+    TriangularMatrix matrix(distances);
+    // 行ごとの節点・距離の和・列 0 .. i-1 の距離の下限
+    std::vector<int> nodes(m);
+    std::vector<double> sums(m, 0.0);
+    std::vector<float> lowerBounds(m, INFINITE_DISTANCE);
+    for (size_t i = 0; i < m; ++i)
+    {
+        nodes[i] = (int)i;
+        const float *row = matrix.Row(i);
+        for (size_t j = 0; j < i; ++j)
+        {
+            sums[i] += row[j];
+            sums[j] += row[j];
+        }
+        lowerBounds[i] = getRowMinimum(matrix, i).first;
+    }
+
+    while (m > 2)
+    {
+        // 1. Q(i, j) = (m - 2) D(i, j) - R(i) - R(j) が最小の組を探す
+        const double scale = (double)(m - 2);
+        const double maxSum = *std::max_element(sums.begin(), sums.begin() + m);
+        double best = std::numeric_limits<double>::infinity();
+        size_t a = 1, b = 0;
+        for (size_t i = 1; i < m; ++i)
+        {
+            const double sum = sums[i];
+            if (scale * lowerBounds[i] - sum - maxSum >= best)
+                continue;
+            const float *row = matrix.Row(i);
+            float minimum = INFINITE_DISTANCE;
+            for (size_t j = 0; j < i; ++j)
+            {
+                const double q = scale * row[j] - sum - sums[j];
+                if (q < best)
+                {
+                    best = q;
+                    a = i;
+                    b = j;
+                }
+                minimum = std::min(minimum, row[j]);
+            }
+            lowerBounds[i] = minimum;
+        }
+
+        // 2. a と b を結合し、新しい節点を行 b に置く
+        const double dab = matrix.At(a, b);
+        const double lengthA = 0.5 * dab + (sums[a] - sums[b]) / (2.0 * scale);
+        nodes[b] = addNode(tree, nodes[a], nodes[b], lengthA, dab - lengthA);
+        double newSum = 0.0;
+        for (size_t k = 0; k < m; ++k)
+        {
+            if (k == a || k == b)
+                continue;
+            float &dbk = matrix.At(b, k);
+            const float dak = matrix.At(a, k);
+            const float duk = 0.5f * (dak + dbk - (float)dab);
+            sums[k] += (double)duk - dak - dbk;
+            newSum += duk;
+            dbk = duk;
+            if (k > b)
+                lowerBounds[k] = std::min(lowerBounds[k], duk);
+        }
+        sums[b] = newSum;
+        lowerBounds[b] = getRowMinimum(matrix, b).first;
+
+        // 3. 行 a を末尾の行で埋める
+        const size_t last = m - 1;
+        if (a != last)
+        {
+            matrix.Move(last, a);
+            nodes[a] = nodes[last];
+            sums[a] = sums[last];
+            lowerBounds[a] = getRowMinimum(matrix, a).first;
+            for (size_t k = a + 1; k < last; ++k)
+            {
+                lowerBounds[k] = std::min(lowerBounds[k], matrix.Row(k)[a]);
+            }
+        }
+        m--;
+    }
+
+    const double d = matrix.At(1, 0);
+    tree.Root = addNode(tree, nodes[0], nodes[1], 0.5 * d, 0.5 * d);
+    return tree;
+}
+
+PhylogeneticTree buildUpgmaTree(const DistanceMatrix &distances)
+{
+    PhylogeneticTree tree = createLeaves(distances);
+    size_t m = distances.Size();
+    if (m < 2)
+        return tree;
+
+    TriangularMatrix matrix(distances);
+    // 行ごとの節点・葉の数・高さ・列 0 .. i-1 の最小値とその位置
+    std::vector<int> nodes(m);
+    std::vector<double> sizes(m, 1.0);
+    std::vector<double> heights(m, 0.0);
+    std::vector<float> minimums(m, INFINITE_DISTANCE);
+    std::vector<size_t> positions(m, 0);
+    for (size_t i = 0; i < m; ++i)
+    {
+        nodes[i] = (int)i;
+        std::tie(minimums[i], positions[i]) = getRowMinimum(matrix, i);
+    }
+    std::vector<size_t> dirty;
+
+    while (m > 1)
+    {
+        // 1. 最小の組を探す
+        const size_t a = std::min_element(minimums.begin() + 1, minimums.begin() + m) - minimums.begin();
+        const size_t b = positions[a];
+        const double dab = matrix.At(a, b);
+        const double height = 0.5 * dab;
+
+        // 2. a と b を結合し、新しい節点を行 b に置く
+        nodes[b] = addNode(tree, nodes[a], nodes[b], height - heights[a], height - heights[b]);
+        const double sizeA = sizes[a], sizeB = sizes[b];
+        dirty.clear();
+        for (size_t k = 0; k < m; ++k)
+        {
+            if (k == a || k == b)
+                continue;
+            float &dbk = matrix.At(b, k);
+            dbk = (float)((sizeA * matrix.At(a, k) + sizeB * dbk) / (sizeA + sizeB));
+            if (k < b)
+                continue;
+            // 最小値の位置が結合した行なら読み直し、そうでなければ新しい値と比べる
+            if (positions[k] == a || positions[k] == b)
+                dirty.push_back(k);
+            else if (dbk < minimums[k])
+            {
+                minimums[k] = dbk;
+                positions[k] = b;
+            }
+        }
+        sizes[b] = sizeA + sizeB;
+        heights[b] = height;
+        dirty.push_back(b);
+
+        // 3. 行 a を末尾の行で埋める
+        const size_t last = m - 1;
+        if (a != last)
+        {
+            matrix.Move(last, a);
+            nodes[a] = nodes[last];
+            sizes[a] = sizes[last];
+            heights[a] = heights[last];
+            dirty.push_back(a);
+            for (size_t k = a + 1; k < last; ++k)
+            {
+                if (positions[k] == a)
+                    dirty.push_back(k);
+                else if (matrix.Row(k)[a] < minimums[k])
+                {
+                    minimums[k] = matrix.Row(k)[a];
+                    positions[k] = a;
+                }
+            }
+        }
+        m--;
+        for (const size_t k : dirty)
+        {
+            if (k < m)
+                std::tie(minimums[k], positions[k]) = getRowMinimum(matrix, k);
+        }
+    }
+    tree.Root = nodes[0];
+    return tree;
+}
+
+PhylogeneticTree buildSpreadTree(const std::vector<LanguageDifference> &diffs, const std::vector<std::string> &places, const int lastSection)
+{
+    PhylogeneticTree tree;
+    tree.Leaves = places;
+    // 場所ごとの今の系統の末端の節点と、節点ごとの時代
+    std::vector<int> tips(places.size(), -1);
+    std::vector<int> sections;
+    auto addTip = [&](const int place, const int section)
+    {
+        PhylogeneticTree::Node node;
+        node.Leaf = place;
+        tree.Nodes.push_back(node);
+        sections.push_back(section);
+        tips[place] = (int)tree.Nodes.size() - 1;
+        return tips[place];
+    };
+    auto isValid = [&](const int place)
+    {
+        return place >= 0 && (size_t)place < places.size();
+    };
+
+    int endSection = lastSection;
+    for (const auto &diff : diffs)
+    {
+        endSection = std::max(endSection, diff.Section);
+        if (diff.Type == LanguageDifferenceType::AddWord && isValid(diff.Place) && tree.Root < 0)
+        {
+            // 最初に単語が置かれた場所が起源
+            tree.Root = addTip(diff.Place, diff.Section);
+        }
+        else if (diff.Type == LanguageDifferenceType::CopyLanguage && isValid(diff.Place) && isValid(diff.Source.Place) &&
+                 diff.Place != diff.Source.Place && tips[diff.Source.Place] >= 0 && tips[diff.Place] < 0)
+        {
+            // 複写元の末端を分岐点にし、複写元と複写先の末端を新しく作る
+            const int branch = tips[diff.Source.Place];
+            tree.Nodes[branch].Leaf = -1;
+            sections[branch] = diff.Section;
+            const int source = addTip(diff.Source.Place, diff.Section);
+            const int target = addTip(diff.Place, diff.Section);
+            tree.Nodes[branch].Children = {source, target};
+        }
+    }
+
+    // 枝の長さは時代の差（末端は最後の時代まで伸ばす）
+    for (size_t i = 0; i < tree.Nodes.size(); ++i)
+    {
+        if (tree.Nodes[i].Leaf >= 0)
+            sections[i] = endSection;
+    }
+    for (size_t i = 0; i < tree.Nodes.size(); ++i)
+    {
+        auto &node = tree.Nodes[i];
+        for (int c = 0; c < 2; ++c)
+        {
+            if (node.Children[c] >= 0)
+                node.Lengths[c] = sections[node.Children[c]] - sections[i];
+        }
+    }
+    return tree;
+}
+
+PhylogeneticTree buildSpreadTree(const LanguageSystem &system)
+{
+    std::vector<LanguageDifference> diffs;
+    diffs.reserve(system.CountDifferences());
+    system.ForEachDifference([&](const LanguageDifference &diff)
+                             { diffs.push_back(diff); });
+    return buildSpreadTree(diffs, system.Graph.Places);
+}
+
+TreeComparison compareTrees(const PhylogeneticTree &inferred, const PhylogeneticTree &truth)
+{
+    TreeComparison result;
+    // 両方にある葉に乱数を振る
+    const auto truthLeaves = getLeafNames(truth);
+    const std::unordered_set<std::string> truthLeafSet(truthLeaves.begin(), truthLeaves.end());
+    std::unordered_map<std::string, uint64_t> leafHashes;
+    std::mt19937_64 engine(0x9e3779b97f4a7c15ull);
+    std::string firstLeaf;
+    uint64_t total = 0;
+    for (const auto &name : getLeafNames(inferred))
+    {
+        if (truthLeafSet.count(name) == 0 || leafHashes.count(name) != 0)
+            continue;
+        const uint64_t hash = engine();
+        leafHashes.emplace(name, hash);
+        total ^= hash;
+        if (firstLeaf.empty())
+            firstLeaf = name;
+    }
+    result.CommonLeaves = leafHashes.size();
+
+    const auto inferredSplits = getSplits(inferred, leafHashes, firstLeaf, total, result.CommonLeaves);
+    const auto trueSplits = getSplits(truth, leafHashes, firstLeaf, total, result.CommonLeaves);
+    result.InferredSplits = inferredSplits.size();
+    result.TrueSplits = trueSplits.size();
+    for (const auto split : inferredSplits)
+    {
+        result.SharedSplits += trueSplits.count(split);
+    }
+    result.RobinsonFoulds = result.InferredSplits + result.TrueSplits - 2 * result.SharedSplits;
+    const size_t maximum = result.InferredSplits + result.TrueSplits;
+    result.NormalizedRobinsonFoulds = maximum == 0 ? 0.0 : (double)result.RobinsonFoulds / maximum;
+    return result;
+}
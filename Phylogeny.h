@@ -0,0 +1,125 @@
+#pragma once
+#include "Distance.h"
+#include <array>
+
+/**
+ * @brief 系統樹（根付きの二分木）
+ *
+ */
+struct PhylogeneticTree
+{
+    struct Node
+    {
+        // 子の節点（葉では -1）
+        std::array<int, 2> Children = {-1, -1};
+        // 子への枝の長さ
+        std::array<double, 2> Lengths = {0.0, 0.0};
+        // 葉の番号（Leaves 内の位置、内部の節点では -1）
+        int Leaf = -1;
+    };
+
+    // 葉の名前（場所名）
+    std::vector<std::string> Leaves;
+    // 節点
+    std::vector<Node> Nodes;
+    // 根の節点（空の木では -1）
+    int Root = -1;
+
+    /**
+     * @brief Newick 形式に変換する
+     *
+     * @return Newick 形式の文字列（末尾は ";"）
+     */
+    std::string ToNewick() const;
+
+    /**
+     * @brief Newick 形式で出力する
+     *
+     * @param filename 出力ファイル名
+     * @return 成功したら true
+     */
+    bool ExportNewick(const std::string &filename) const;
+};
+
+/**
+ * @brief 系統樹の比較結果
+ *
+ */
+struct TreeComparison
+{
+    // 両方の木にある葉の数
+    size_t CommonLeaves = 0;
+    // 推定した木の分割（自明でないもの）の数
+    size_t InferredSplits = 0;
+    // 正しい木の分割の数
+    size_t TrueSplits = 0;
+    // 両方にある分割の数
+    size_t SharedSplits = 0;
+    // Robinson-Foulds 距離（片方にしかない分割の数）
+    size_t RobinsonFoulds = 0;
+    // 正規化した Robinson-Foulds 距離（0 なら一致、1 なら共通の分割なし）
+    double NormalizedRobinsonFoulds = 0.0;
+
+    /**
+     * @brief CSV に出力する
+     *
+     * @param filename 出力ファイル名
+     * @return 成功したら true
+     *
+     * @note 1行目が項目名、2行目が値。
+     */
+    bool ExportCSV(const std::string &filename) const;
+};
+
+/**
+ * @brief 近隣結合法で系統樹を作る
+ *
+ * @param distances 距離行列（NaN の組は最大距離 1 とみなす）
+ * @return 系統樹（最後に残った2つの節点を根でつなぐ）
+ *
+ * @note 距離は下三角だけを float で持ち（O(n²) のメモリ）、結合した行は末尾の行と入れ替えて詰めるので、内側のループは連続したメモリを読む。
+ * @note 行ごとの距離の下限から Q の下限を求め、今の最小値を下回りえない行は読み飛ばす。
+ */
+PhylogeneticTree buildNeighborJoiningTree(const DistanceMatrix &distances);
+
+/**
+ * @brief UPGMA（群平均法）で系統樹を作る
+ *
+ * @param distances 距離行列（NaN の組は最大距離 1 とみなす）
+ * @return 系統樹（超計量木、枝の長さは高さの差）
+ *
+ * @note 行ごとの最小値とその位置を保ち、結合で変わった行だけを読み直す（平均 O(n²) 時間、O(n²) メモリ）。
+ */
+PhylogeneticTree buildUpgmaTree(const DistanceMatrix &distances);
+
+/**
+ * @brief 差分から言語の広がりの正しい系統樹を作る
+ *
+ * @param diffs 差分（古い順）
+ * @param places 場所名（場所ID の順）
+ * @param lastSection 最後の時代（末端の枝をここまで伸ばす。差分にもっと後の時代があればそちら）
+ * @return 系統樹（言語の複写ごとに複写元の系統が分岐する、枝の長さは時代の差）
+ *
+ * @note 言語の広がりは複写（CopyLanguage）として記録されている。単語の借用（BorrowWord）は系統を分けない。
+ * @note 使うのは最初の AddWord と CopyLanguage だけなので、DifferenceSink::SpreadDifferences も渡せる。
+ */
+PhylogeneticTree buildSpreadTree(const std::vector<LanguageDifference> &diffs, const std::vector<std::string> &places, const int lastSection = 0);
+
+/**
+ * @brief 語族の差分から言語の広がりの正しい系統樹を作る
+ *
+ * @param system 語族
+ * @return 系統樹
+ */
+PhylogeneticTree buildSpreadTree(const LanguageSystem &system);
+
+/**
+ * @brief 推定した系統樹を正しい系統樹と比べる
+ *
+ * @param inferred 推定した系統樹
+ * @param truth 正しい系統樹
+ * @return 比較結果（両方にある葉に絞った、根なしの分割の比較）
+ *
+ * @note 分割は葉ごとの乱数の排他的論理和で表して比べる（確率的だが、衝突はまず起きない）。
+ */
+TreeComparison compareTrees(const PhylogeneticTree &inferred, const PhylogeneticTree &truth);
@@ -0,0 +1,496 @@
+#include "Profile.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <sstream>
+
+std::atomic<bool> isProfiling = false;
+std::atomic<bool> isTracing = false;
+
+namespace
+{
+    constexpr const char *STAGE_NAMES[PROFILE_STAGE_COUNT] = {
+        "Other",
+        "ToNextSection",
+        "ChangeLanguageStrength",
+        "BollowWord",
+        "ChangeLanguageSound",
+        "RemoveWordRandom",
+        "CreateWord",
+        "ChangeLanguageMeaning",
+        "Checkpoint",
+        "Export",
+        "Worker",
+        "WriteLog",
+    };
+    constexpr const char *COUNTER_NAMES[PROFILE_COUNTER_COUNT] = {
+        "Languages",
+        "Words",
+        "Differences",
+        "Allocations",
+    };
+
+    // 時系列のイベント（Stage が段階の数なら世代のイベント）
+    struct TraceEvent
+    {
+        // 記録を始めてからの時刻（ナノ秒）
+        uint64_t Begin;
+        uint64_t End;
+        uint32_t ThreadID;
+        uint32_t Stage;
+        int32_t Section;
+    };
+
+    // スレッドごとの計測値
+    struct ThreadProfile
+    {
+        std::array<ProfileTotals, PROFILE_STAGE_COUNT> Stages;
+        // 前回の世代の区切りでの値
+        std::array<ProfileTotals, PROFILE_STAGE_COUNT> SectionMark;
+        // 今の段階
+        ProfileStage Current = ProfileStage::Other;
+        // スレッドが使っているか（終わったスレッドの計測値は残し、次のスレッドが引き継ぐ）
+        bool InUse = false;
+        ThreadProfile *Next = nullptr;
+        // 時系列のリングバッファ（書くのはこのスレッドだけ）
+        TraceEvent *Events = nullptr;
+        size_t EventCapacity = 0;
+        std::atomic<uint64_t> EventCount = 0;
+        // 出力でのスレッドの番号
+        uint32_t ThreadID = 0;
+        // 今の世代の始まりの時刻
+        uint64_t SectionBegin = 0;
+    };
+
+    // スレッドごとの計測値の一覧（メモリ確保の計測から作られるので、operator new を使わずに確保する）と世代ごとの内訳
+    std::mutex profileMutex;
+    ThreadProfile *threadProfiles = nullptr;
+    std::vector<ProfileSection> profileSections;
+    // 時系列の記録の設定（startTrace で決め、記録中は変えない）
+    size_t traceCapacity = 0;
+    std::chrono::steady_clock::time_point traceOrigin;
+    uint32_t nextTraceThreadID = 0;
+
+    // スレッドが終わったら計測値を手放す
+    struct ThreadProfileOwner
+    {
+        ThreadProfile *Profile = nullptr;
+
+        ~ThreadProfileOwner()
+        {
+            if (Profile == nullptr)
+                return;
+            std::lock_guard<std::mutex> lock(profileMutex);
+            Profile->Current = ProfileStage::Other;
+            Profile->InUse = false;
+        }
+    };
+    thread_local ThreadProfileOwner threadProfileOwner;
+
+    ThreadProfile &getThreadProfile()
+    {
+        auto &owner = threadProfileOwner;
+        if (owner.Profile != nullptr)
+            return *owner.Profile;
+
+        std::lock_guard<std::mutex> lock(profileMutex);
+        ThreadProfile *profile = threadProfiles;
+        while (profile != nullptr && profile->InUse)
+        {
+            profile = profile->Next;
+        }
+        if (profile == nullptr)
+        {
+            void *memory = std::malloc(sizeof(ThreadProfile));
+            if (memory == nullptr)
+                std::abort();
+            profile = new (memory) ThreadProfile();
+            profile->Next = threadProfiles;
+            threadProfiles = profile;
+        }
+        profile->InUse = true;
+        profile->ThreadID = nextTraceThreadID++;
+        owner.Profile = profile;
+        return *profile;
+    }
+
+    // リングバッファを記録の設定の大きさにする（記録は消す）
+    void resetTraceBuffer(ThreadProfile &profile)
+    {
+        if (profile.EventCapacity != traceCapacity)
+        {
+            std::free(profile.Events);
+            profile.Events = static_cast<TraceEvent *>(std::malloc(traceCapacity * sizeof(TraceEvent)));
+            profile.EventCapacity = profile.Events == nullptr ? 0 : traceCapacity;
+        }
+        profile.EventCount.store(0, std::memory_order_relaxed);
+        profile.SectionBegin = 0;
+    }
+
+    uint64_t getTraceTime(const std::chrono::steady_clock::time_point time)
+    {
+        // 記録を始める前に始まった段階は、記録の始まりからとする
+        if (time < traceOrigin)
+            return 0;
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time - traceOrigin).count();
+    }
+
+    // イベントを書く（満杯なら一番古いイベントを上書きする）
+    void recordTraceEvent(ThreadProfile &profile, const uint32_t stage, const int section, const uint64_t begin, const uint64_t end)
+    {
+        if (profile.EventCapacity != traceCapacity)
+        {
+            // 記録を始めた後に作られたスレッド
+            std::lock_guard<std::mutex> lock(profileMutex);
+            resetTraceBuffer(profile);
+        }
+        if (profile.EventCapacity == 0)
+            return;
+        const uint64_t count = profile.EventCount.load(std::memory_order_relaxed);
+        profile.Events[count % profile.EventCapacity] = {begin, end, profile.ThreadID, stage, section};
+        profile.EventCount.store(count + 1, std::memory_order_release);
+    }
+
+    // 時間を読みやすい単位の文字列にする
+    std::string formatMilliseconds(const uint64_t nanoseconds)
+    {
+        std::ostringstream stream;
+        stream << std::fixed << std::setprecision(3) << nanoseconds / 1e6;
+        return stream.str();
+    }
+}
+
+// メモリ確保の回数を数えるため、全体の operator new を置き換える
+void *operator new(const std::size_t size)
+{
+    if (isProfiling.load(std::memory_order_relaxed))
+        recordProfileCount(ProfileCounter::Allocations, 1);
+    void *memory = std::malloc(size == 0 ? 1 : size);
+    if (memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void *operator new[](const std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+ProfileTotals &ProfileTotals::operator+=(const ProfileTotals &other)
+{
+    Calls += other.Calls;
+    Nanoseconds += other.Nanoseconds;
+    for (size_t i = 0; i < PROFILE_COUNTER_COUNT; ++i)
+    {
+        Counters[i] += other.Counters[i];
+    }
+    return *this;
+}
+
+ProfileTotals ProfileTotals::operator-(const ProfileTotals &other) const
+{
+    ProfileTotals result;
+    result.Calls = Calls - other.Calls;
+    result.Nanoseconds = Nanoseconds - other.Nanoseconds;
+    for (size_t i = 0; i < PROFILE_COUNTER_COUNT; ++i)
+    {
+        result.Counters[i] = Counters[i] - other.Counters[i];
+    }
+    return result;
+}
+
+const char *getProfileStageName(const ProfileStage stage)
+{
+    return (size_t)stage < PROFILE_STAGE_COUNT ? STAGE_NAMES[(size_t)stage] : "";
+}
+
+const char *getProfileCounterName(const ProfileCounter counter)
+{
+    return (size_t)counter < PROFILE_COUNTER_COUNT ? COUNTER_NAMES[(size_t)counter] : "";
+}
+
+void startProfile()
+{
+    {
+        std::lock_guard<std::mutex> lock(profileMutex);
+        for (ThreadProfile *profile = threadProfiles; profile != nullptr; profile = profile->Next)
+        {
+            profile->Stages = {};
+            profile->SectionMark = {};
+        }
+        profileSections.clear();
+    }
+    isProfiling.store(true);
+}
+
+void stopProfile()
+{
+    isProfiling.store(false);
+}
+
+ProfileReport getProfileReport()
+{
+    ProfileReport report;
+    // 内訳の複製でのメモリ確保がロック中に計測値を作らないよう、先に作っておく
+    getThreadProfile();
+    std::lock_guard<std::mutex> lock(profileMutex);
+    for (const ThreadProfile *profile = threadProfiles; profile != nullptr; profile = profile->Next)
+    {
+        for (size_t i = 0; i < PROFILE_STAGE_COUNT; ++i)
+        {
+            report.Stages[i] += profile->Stages[i];
+        }
+    }
+    report.Sections = profileSections;
+    return report;
+}
+
+void startTrace(const size_t capacity)
+{
+    {
+        std::lock_guard<std::mutex> lock(profileMutex);
+        traceCapacity = std::max<size_t>(1, capacity);
+        traceOrigin = std::chrono::steady_clock::now();
+        for (ThreadProfile *profile = threadProfiles; profile != nullptr; profile = profile->Next)
+        {
+            resetTraceBuffer(*profile);
+        }
+    }
+    isTracing.store(true);
+}
+
+void stopTrace()
+{
+    isTracing.store(false);
+}
+
+bool exportTrace(const std::string &filename)
+{
+    std::ofstream file(filename.c_str());
+    if (!file.is_open())
+    {
+        std::cerr << "Error: ファイルを開けませんでした: " << filename << std::endl;
+        return false;
+    }
+    getThreadProfile();
+    std::lock_guard<std::mutex> lock(profileMutex);
+    file << "{\"traceEvents\": [\n";
+    file << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"TokiPonaLanguages\"}}";
+    file << std::fixed << std::setprecision(3);
+    uint64_t dropped = 0;
+    for (const ThreadProfile *profile = threadProfiles; profile != nullptr; profile = profile->Next)
+    {
+        if (profile->EventCapacity == 0)
+            continue;
+        // リングバッファの古い順に読む
+        const uint64_t count = profile->EventCount.load(std::memory_order_acquire);
+        const uint64_t first = count > profile->EventCapacity ? count - profile->EventCapacity : 0;
+        dropped += first;
+        for (uint64_t i = first; i < count; ++i)
+        {
+            const auto &event = profile->Events[i % profile->EventCapacity];
+            file << ",\n{\"name\": \"";
+            if (event.Stage < PROFILE_STAGE_COUNT)
+                file << STAGE_NAMES[event.Stage] << "\", \"cat\": \"stage\"";
+            else
+                file << "Section " << event.Section << "\", \"cat\": \"section\"";
+            file << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.ThreadID
+                 << ", \"ts\": " << event.Begin / 1e3
+                 << ", \"dur\": " << (event.End - event.Begin) / 1e3;
+            if (event.Stage >= PROFILE_STAGE_COUNT)
+                file << ", \"args\": {\"section\": " << event.Section << "}";
+            file << "}";
+        }
+    }
+    file << "\n], \"displayTimeUnit\": \"ms\", \"otherData\": {\"droppedEvents\": " << dropped << "}}\n";
+    return true;
+}
+
+void endProfileSection(const int section)
+{
+    const bool profiling = isProfiling.load(std::memory_order_relaxed);
+    const bool tracing = isTracing.load(std::memory_order_relaxed);
+    if (!profiling && !tracing)
+        return;
+    auto &profile = getThreadProfile();
+    if (tracing)
+    {
+        const uint64_t now = getTraceTime(std::chrono::steady_clock::now());
+        recordTraceEvent(profile, PROFILE_STAGE_COUNT, section, profile.SectionBegin, now);
+        profile.SectionBegin = now;
+    }
+    if (!profiling)
+        return;
+    ProfileSection result;
+    result.Section = section;
+    for (size_t i = 0; i < PROFILE_STAGE_COUNT; ++i)
+    {
+        result.Stages[i] = profile.Stages[i] - profile.SectionMark[i];
+    }
+    profile.SectionMark = profile.Stages;
+    std::lock_guard<std::mutex> lock(profileMutex);
+    profileSections.push_back(result);
+}
+
+void recordProfileCount(const ProfileCounter counter, const uint64_t value)
+{
+    auto &profile = getThreadProfile();
+    profile.Stages[(size_t)profile.Current].Counters[(size_t)counter] += value;
+}
+
+void ProfileScope::begin(const ProfileStage stage)
+{
+    auto &profile = getThreadProfile();
+    isActive = true;
+    this->stage = stage;
+    previous = profile.Current;
+    profile.Current = stage;
+    start = std::chrono::steady_clock::now();
+}
+
+void ProfileScope::end()
+{
+    const auto finish = std::chrono::steady_clock::now();
+    auto &profile = getThreadProfile();
+    auto &totals = profile.Stages[(size_t)stage];
+    totals.Calls++;
+    totals.Nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(finish - start).count();
+    profile.Current = previous;
+    if (isTracing.load(std::memory_order_relaxed))
+        recordTraceEvent(profile, (uint32_t)stage, -1, getTraceTime(start), getTraceTime(finish));
+}
+
+std::string ProfileReport::ToText() const
+{
+    std::ostringstream stream;
+    ProfileTotals total;
+    for (const auto &stage : Stages)
+    {
+        total += stage;
+    }
+
+    // 1. 段階ごとの合計
+    stream << std::left << std::setw(24) << "stage" << std::right
+           << std::setw(10) << "calls"
+           << std::setw(14) << "time[ms]"
+           << std::setw(8) << "share";
+    for (size_t i = 0; i < PROFILE_COUNTER_COUNT; ++i)
+    {
+        stream << std::setw(14) << COUNTER_NAMES[i];
+    }
+    stream << "\n";
+    auto writeRow = [&](const char *name, const ProfileTotals &totals)
+    {
+        const double share = total.Nanoseconds == 0 ? 0.0 : 100.0 * totals.Nanoseconds / total.Nanoseconds;
+        stream << std::left << std::setw(24) << name << std::right
+               << std::setw(10) << totals.Calls
+               << std::setw(14) << formatMilliseconds(totals.Nanoseconds)
+               << std::setw(7) << std::fixed << std::setprecision(1) << share << "%";
+        for (const auto counter : totals.Counters)
+        {
+            stream << std::setw(14) << counter;
+        }
+        stream << "\n";
+    };
+    for (size_t i = 0; i < PROFILE_STAGE_COUNT; ++i)
+    {
+        writeRow(STAGE_NAMES[i], Stages[i]);
+    }
+    writeRow("total", total);
+
+    // 2. 世代ごとの段階別の時間
+    if (!Sections.empty())
+    {
+        stream << "\n"
+               << std::setw(8) << "section";
+        for (size_t i = 0; i < PROFILE_STAGE_COUNT; ++i)
+        {
+            stream << " " << STAGE_NAMES[i] << "[ms]";
+        }
+        stream << "\n";
+        for (const auto &section : Sections)
+        {
+            stream << std::setw(8) << section.Section;
+            for (size_t i = 0; i < PROFILE_STAGE_COUNT; ++i)
+            {
+                stream << " " << formatMilliseconds(section.Stages[i].Nanoseconds);
+            }
+            stream << "\n";
+        }
+    }
+    return stream.str();
+}
+
+std::string ProfileReport::ToJSON() const
+{
+    std::ostringstream stream;
+    auto writeTotals = [&](const ProfileTotals &totals)
+    {
+        stream << "{\"calls\": " << totals.Calls << ", \"nanoseconds\": " << totals.Nanoseconds;
+        for (size_t i = 0; i < PROFILE_COUNTER_COUNT; ++i)
+        {
+            stream << ", \"" << COUNTER_NAMES[i] << "\": " << totals.Counters[i];
+        }
+        stream << "}";
+    };
+    auto writeStages = [&](const std::array<ProfileTotals, PROFILE_STAGE_COUNT> &stages)
+    {
+        stream << "{";
+        for (size_t i = 0; i < PROFILE_STAGE_COUNT; ++i)
+        {
+            stream << (i == 0 ? "" : ", ") << "\"" << STAGE_NAMES[i] << "\": ";
+            writeTotals(stages[i]);
+        }
+        stream << "}";
+    };
+
+    stream << "{\n  \"stages\": ";
+    writeStages(Stages);
+    stream << ",\n  \"sections\": [";
+    for (size_t i = 0; i < Sections.size(); ++i)
+    {
+        stream << (i == 0 ? "\n" : ",\n") << "    {\"section\": " << Sections[i].Section << ", \"stages\": ";
+        writeStages(Sections[i].Stages);
+        stream << "}";
+    }
+    stream << "\n  ]\n}\n";
+    return stream.str();
+}
+
+bool ProfileReport::Export(const std::string &filename) const
+{
+    std::ofstream text(filename.c_str());
+    std::ofstream json((filename + ".json").c_str());
+    if (!text.is_open() || !json.is_open())
+    {
+        std::cerr << "Error: ファイルを開けませんでした: " << filename << std::endl;
+        return false;
+    }
+    text << ToText();
+    json << ToJSON();
+    return true;
+}
@@ -0,0 +1,233 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 計測する処理の段階
+ *
+ */
+enum class ProfileStage
+{
+    // どの段階にも属さない処理
+    Other,
+    ToNextSection,
+    ChangeLanguageStrength,
+    BollowWord,
+    ChangeLanguageSound,
+    RemoveWordRandom,
+    CreateWord,
+    ChangeLanguageMeaning,
+    // 途中経過の保存
+    Checkpoint,
+    // 結果の出力
+    Export,
+    // 並列処理の作業スレッド（1回の呼び出し分）
+    Worker,
+    // ログの書き込みスレッドの書き込み
+    WriteLog,
+    Count,
+};
+
+/**
+ * @brief 計測する数
+ *
+ */
+enum class ProfileCounter
+{
+    // 処理した言語の数
+    Languages,
+    // 走査した単語の数
+    Words,
+    // 記録した差分の数
+    Differences,
+    // メモリ確保の回数
+    Allocations,
+    Count,
+};
+
+constexpr size_t PROFILE_STAGE_COUNT = (size_t)ProfileStage::Count;
+constexpr size_t PROFILE_COUNTER_COUNT = (size_t)ProfileCounter::Count;
+
+/**
+ * @brief 段階ごとの計測値
+ *
+ */
+struct ProfileTotals
+{
+    // 呼び出し回数
+    uint64_t Calls = 0;
+    // 経過時間（ナノ秒、入れ子になった段階の時間を含む）
+    uint64_t Nanoseconds = 0;
+    // 数（ProfileCounter の順）
+    std::array<uint64_t, PROFILE_COUNTER_COUNT> Counters{};
+
+    ProfileTotals &operator+=(const ProfileTotals &other);
+    ProfileTotals operator-(const ProfileTotals &other) const;
+};
+
+/**
+ * @brief 1世代分の計測値
+ *
+ */
+struct ProfileSection
+{
+    int Section = 0;
+    std::array<ProfileTotals, PROFILE_STAGE_COUNT> Stages;
+};
+
+/**
+ * @brief 計測結果
+ *
+ */
+struct ProfileReport
+{
+    // 段階ごとの合計（すべてのスレッド）
+    std::array<ProfileTotals, PROFILE_STAGE_COUNT> Stages;
+    // 世代ごとの内訳（endProfileSection を呼んだスレッドの分）
+    std::vector<ProfileSection> Sections;
+
+    /**
+     * @brief 表形式の文字列にする
+     *
+     * @return 段階ごとの合計と、世代ごとの段階別の時間
+     */
+    std::string ToText() const;
+
+    /**
+     * @brief JSON 形式の文字列にする
+     *
+     * @return {"stages": [...], "sections": [...]}
+     */
+    std::string ToJSON() const;
+
+    /**
+     * @brief ファイルに出力する
+     *
+     * @param filename 出力ファイル名（表形式、JSON は filename + ".json"）
+     * @return 成功したら true
+     */
+    bool Export(const std::string &filename) const;
+};
+
+/**
+ * @brief 段階名
+ *
+ * @param stage 段階
+ * @return 段階名
+ */
+const char *getProfileStageName(ProfileStage stage);
+
+/**
+ * @brief 数の名前
+ *
+ * @param counter 数
+ * @return 数の名前
+ */
+const char *getProfileCounterName(ProfileCounter counter);
+
+// 計測が有効か（無効なら計測用の関数はこの値を読むだけで戻る）
+extern std::atomic<bool> isProfiling;
+// 時系列の記録が有効か
+extern std::atomic<bool> isTracing;
+
+/**
+ * @brief 計測を始める（これまでの計測値は消す）
+ *
+ */
+void startProfile();
+
+/**
+ * @brief 計測を止める（計測値は残す）
+ *
+ */
+void stopProfile();
+
+/**
+ * @brief 計測値を集計する
+ *
+ * @return 計測結果
+ *
+ * @note 計測中のスレッドの値も読むので、他のスレッドが止まっているときに呼ぶ。
+ */
+ProfileReport getProfileReport();
+
+/**
+ * @brief 時系列の記録を始める（これまでの記録は消す）
+ *
+ * @param capacity スレッドごとに残すイベントの数
+ *
+ * @note イベントはスレッドごとのリングバッファに書き、あふれたら古いものから捨てる（ロックを取らず、待たない）。
+ */
+void startTrace(size_t capacity);
+
+/**
+ * @brief 時系列の記録を止める（記録は残す）
+ *
+ */
+void stopTrace();
+
+/**
+ * @brief 時系列の記録を Chrome Trace Event 形式の JSON で出力する
+ *
+ * @param filename 出力ファイル名
+ * @return 成功したら true
+ *
+ * @note 段階と世代を開始時刻・長さを持つイベント（"ph": "X"）として書く。捨てたイベントの数は otherData に書く。Perfetto などで読める。
+ * @note 記録中のスレッドのバッファも読むので、他のスレッドが止まっているときに呼ぶ。
+ */
+bool exportTrace(const std::string &filename);
+
+/**
+ * @brief 世代の区切り（呼んだスレッドの前回の区切りからの計測値を世代の内訳に加え、その間を世代のイベントとして記録する）
+ *
+ * @param section 終わった世代
+ */
+void endProfileSection(int section);
+
+/**
+ * @brief 今の段階の数を加える（スレッドごとに溜める）
+ *
+ * @param counter 数
+ * @param value 加える値
+ */
+void recordProfileCount(ProfileCounter counter, uint64_t value);
+
+inline void addProfileCount(const ProfileCounter counter, const uint64_t value = 1)
+{
+    if (isProfiling.load(std::memory_order_relaxed))
+        recordProfileCount(counter, value);
+}
+
+/**
+ * @brief 段階の時間を計測する（スコープの間、数はこの段階に加える。時系列の記録中はイベントも記録する）
+ *
+ */
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const ProfileStage stage)
+    {
+        if (isProfiling.load(std::memory_order_relaxed) || isTracing.load(std::memory_order_relaxed))
+            begin(stage);
+    }
+    ~ProfileScope()
+    {
+        if (isActive)
+            end();
+    }
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    void begin(ProfileStage stage);
+    void end();
+
+    bool isActive = false;
+    ProfileStage stage = ProfileStage::Other;
+    ProfileStage previous = ProfileStage::Other;
+    std::chrono::steady_clock::time_point start;
+};
@@ -1,11 +1,23 @@
 #include "Random.h"
 #include <random>
 #include <algorithm>
+#include <mutex>
+#include <sstream>
 
 namespace
 {
     static std::random_device rd;
-    static std::mt19937 gen(rd() + std::rand());
+    static std::mutex rdMutex;
+
+    // スレッドごとの初期シード
+    unsigned int makeSeed()
+    {
+        std::lock_guard<std::mutex> lock(rdMutex);
+        return rd() + std::rand();
+    }
+
+    // 乱数生成器はスレッドごとに持つ
+    thread_local std::mt19937 gen(makeSeed());
 }
 
 int getRandomInt(int min, int max)
@@ -90,4 +102,27 @@ void moveRandomOnTable(int &A, int &B, const std::vector<std::vector<std::string
     }
 
     // どの方向にも有効なセルが見つからなかった場合、A, B は変更されない
+}
+
+std::string getRandomState()
+{
+    std::ostringstream ss;
+    ss << gen;
+    return ss.str();
+}
+
+bool setRandomState(const std::string &state)
+{
+    std::istringstream ss(state);
+    std::mt19937 restored;
+    ss >> restored;
+    if (ss.fail())
+        return false;
+    gen = restored;
+    return true;
+}
+
+void setRandomSeed(unsigned int seed)
+{
+    gen.seed(seed);
 }
\ No newline at end of file
@@ -30,4 +30,24 @@ bool getWithProbability(double p);
  * @param B 現在の列インデックス（参照渡し、更新される）
  * @param table 探索対象の2次元テーブル
  */
-void moveRandomOnTable(int &A, int &B, const std::vector<std::vector<std::string>> &table);
\ No newline at end of file
+void moveRandomOnTable(int &A, int &B, const std::vector<std::vector<std::string>> &table);
+
+/**
+ * @brief 乱数生成器の内部状態を文字列で取得する。
+ * @return 内部状態
+ */
+std::string getRandomState();
+
+/**
+ * @brief 乱数生成器の内部状態を復元する。
+ * @param state getRandomState で取得した内部状態
+ * @return 復元できたら true
+ */
+bool setRandomState(const std::string &state);
+
+/**
+ * @brief 乱数生成器のシードを設定する。
+ * @param seed シード
+ * @note 乱数生成器はスレッドごとにあり、呼び出したスレッドのものだけを設定する。
+ */
+void setRandomSeed(unsigned int seed);
\ No newline at end of file
@@ -0,0 +1,291 @@
+#include "Replay.h"
+#include "Profile.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <utility>
+
+namespace
+{
+    // 場所ごとの差分の列の要素
+    struct ReplayStep
+    {
+        const LanguageDifference *Diff;
+        // 相手の場所（場所をまたがない差分では -1）
+        int Other;
+        // 相手の列での位置
+        size_t OtherIndex;
+        // 読むだけの側（借用元・複写元）か
+        bool IsSource;
+    };
+}
+
+ReplayEngine::ReplayEngine(LanguageSystem &system)
+    : system(system),
+      converter(PhoneticsConverter::Create(system.PhoneticsMap)),
+      languages(system.Graph.Places.size(), nullptr)
+{
+}
+
+Language *ReplayEngine::getLanguage(const int place)
+{
+    if (place < 0 || place >= (int)languages.size())
+        return nullptr;
+    if (languages[place] == nullptr)
+    {
+        // 場所ごとに一度だけ引く（共有を解除した後は map のノードが動かないので参照は有効なまま）
+        languages[place] = &system.LanguageMap.Mutable()[system.Graph.Places[place]];
+    }
+    return languages[place];
+}
+
+void ReplayEngine::Apply(const LanguageDifference &diff)
+{
+    Language *language = getLanguage(diff.Place);
+    if (language == nullptr)
+        return;
+
+    switch (diff.Type)
+    {
+    case LanguageDifferenceType::AddWord:
+        applyAddWord(*language, diff);
+        break;
+    case LanguageDifferenceType::ChangeStrength:
+        applyChangeStrength(*language, diff);
+        break;
+    case LanguageDifferenceType::ChangeSound:
+        applyChangeSound(*language, diff);
+        break;
+    case LanguageDifferenceType::ChangeMeaning:
+        applyChangeMeaning(*language, diff);
+        break;
+    case LanguageDifferenceType::BorrowWord:
+        applyBorrowWord(*language, diff);
+        break;
+    case LanguageDifferenceType::AddCompoundWord:
+        applyAddCompoundWord(*language, diff);
+        break;
+    case LanguageDifferenceType::Remove:
+        applyRemove(*language, diff);
+        break;
+    case LanguageDifferenceType::CopyLanguage:
+        applyCopyLanguage(*language, diff);
+        break;
+    }
+}
+
+void ReplayEngine::Apply(const std::vector<LanguageDifference> &diffs)
+{
+    for (const auto &diff : diffs)
+    {
+        Apply(diff);
+    }
+}
+
+void ReplayEngine::ApplyParallel(const std::vector<LanguageDifference> &diffs, unsigned int threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    if (threadCount == 1)
+    {
+        Apply(diffs);
+        return;
+    }
+
+    // 単語追加の間の区間ごとに並列に再生する
+    auto first = diffs.begin();
+    while (first != diffs.end())
+    {
+        auto last = std::find_if(first, diffs.end(), [](const LanguageDifference &diff)
+                                 { return diff.Type == LanguageDifferenceType::AddWord; });
+        applyParallel(std::span<const LanguageDifference>(first, last), threadCount);
+        if (last == diffs.end())
+            break;
+        Apply(*last);
+        first = last + 1;
+    }
+}
+
+void ReplayEngine::applyParallel(std::span<const LanguageDifference> diffs, const unsigned int threadCount)
+{
+    if (diffs.empty())
+        return;
+
+    // 場所ごとの列に分ける（言語への参照もここで作っておき、スレッドからは読むだけにする）
+    std::vector<std::vector<ReplayStep>> streams(languages.size());
+    for (const auto &diff : diffs)
+    {
+        if (getLanguage(diff.Place) == nullptr)
+            continue;
+        const bool isCrossPlace = (diff.Type == LanguageDifferenceType::BorrowWord || diff.Type == LanguageDifferenceType::CopyLanguage) &&
+                                  diff.Source.Place != diff.Place && getLanguage(diff.Source.Place) != nullptr;
+        auto &target = streams[diff.Place];
+        if (!isCrossPlace)
+        {
+            target.push_back({&diff, -1, 0, false});
+            continue;
+        }
+        auto &source = streams[diff.Source.Place];
+        target.push_back({&diff, diff.Source.Place, source.size(), false});
+        source.push_back({&diff, diff.Place, target.size() - 1, true});
+    }
+
+    // 列ごとの適用済みの数
+    std::vector<std::atomic<size_t>> done(streams.size());
+    auto run = [&](const unsigned int index)
+    {
+        ProfileScope profile(ProfileStage::Worker);
+        std::vector<int> owned;
+        for (int place = index; place < (int)streams.size(); place += threadCount)
+        {
+            if (!streams[place].empty())
+                owned.push_back(place);
+        }
+        // 待ちになった列は飛ばして、担当の列を順に進める
+        while (!owned.empty())
+        {
+            bool isProgressed = false;
+            for (auto it = owned.begin(); it != owned.end();)
+            {
+                const auto &stream = streams[*it];
+                size_t i = done[*it].load(std::memory_order_relaxed);
+                while (i < stream.size())
+                {
+                    const auto &step = stream[i];
+                    if (step.Other >= 0)
+                    {
+                        // 借用元は借用先が適用し終えるまで、借用先は借用元がこの差分に達するまで待つ
+                        const size_t other = done[step.Other].load(std::memory_order_acquire);
+                        if (step.IsSource ? other <= step.OtherIndex : other < step.OtherIndex)
+                            break;
+                    }
+                    if (!step.IsSource)
+                        Apply(*step.Diff);
+                    done[*it].store(++i, std::memory_order_release);
+                    isProgressed = true;
+                }
+                it = (i == stream.size()) ? owned.erase(it) : it + 1;
+            }
+            if (!isProgressed)
+                std::this_thread::yield();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
+    for (unsigned int i = 1; i < threadCount; ++i)
+    {
+        threads.emplace_back(run, i);
+    }
+    run(0);
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void ReplayEngine::applyAddWord(Language &language, const LanguageDifference &diff)
+{
+    // 単語追加は祖語の配置にだけ使われるので、祖語にも同じ単語を加える
+    Word word;
+    word.Sounds = converter.convertToPhonetics(diff.GetWordForm());
+    word.Meanings = diff.GetMeaning();
+    word.NearestProtoWord = word.Sounds;
+    system.ProtoLanguage.Words[diff.WordID] = word;
+    language.Words[diff.WordID] = std::move(word);
+}
+
+void ReplayEngine::applyChangeStrength(Language &language, const LanguageDifference &diff)
+{
+    language.Strength = diff.Strength;
+}
+
+void ReplayEngine::applyChangeSound(Language &language, const LanguageDifference &diff)
+{
+    auto itWord = language.Words.find(diff.WordID);
+    if (itWord == language.Words.end())
+        return;
+
+    // 音韻変化を適用（インプレース更新）
+    const auto sc = diff.GetSoundChange();
+    auto &sounds = itWord->second.Sounds;
+    size_t next = 0;
+    for (size_t i = 0; i < sounds.size(); ++i)
+    {
+        bool isMatch = (sounds[i] == sc.beforePhon);
+        if (isMatch)
+        {
+            if (sc.Condition == SoundChangeCondition::Start && i != 0)
+                isMatch = false;
+            else if (sc.Condition == SoundChangeCondition::End && i != sounds.size() - 1)
+                isMatch = false;
+            else if (sc.Condition == SoundChangeCondition::Middle && (i == 0 || i == sounds.size() - 1))
+                isMatch = false;
+        }
+        if (!isMatch)
+            sounds[next++] = sounds[i];
+        else if (!sc.IsRemove)
+            sounds[next++] = sc.AfterPhone;
+    }
+    sounds.resize(next);
+}
+
+void ReplayEngine::applyChangeMeaning(Language &language, const LanguageDifference &diff)
+{
+    auto itWord = language.Words.find(diff.WordID);
+    if (itWord == language.Words.end())
+        return;
+    itWord->second.Meanings = diff.GetMeaning();
+    itWord->second.UpdateNearestProtoWord(system.ProtoLanguage);
+}
+
+void ReplayEngine::applyBorrowWord(Language &language, const LanguageDifference &diff)
+{
+    Language *source = getLanguage(diff.Source.Place);
+    if (source == nullptr)
+        return;
+    auto itSrc = std::as_const(source->Words).find(diff.Source.WordID);
+    if (itSrc == source->Words.Get().end())
+        return;
+    auto itDst = language.Words.find(diff.WordID);
+    if (itDst == language.Words.end())
+        return;
+    // 借用：音素列をコピー
+    itDst->second.Sounds = itSrc->second.Sounds;
+}
+
+void ReplayEngine::applyAddCompoundWord(Language &language, const LanguageDifference &diff)
+{
+    Word newWord;
+    bool first = true;
+    for (int i = 0; i < diff.PartCount; ++i)
+    {
+        auto itPart = std::as_const(language.Words).find(diff.Parts[i]);
+        if (itPart == language.Words.Get().end())
+            continue;
+        if (first)
+        {
+            newWord = itPart->second;
+            first = false;
+        }
+        else
+            newWord = newWord.Add(itPart->second);
+    }
+    newWord.UpdateNearestProtoWord(system.ProtoLanguage);
+    language.Words[diff.WordID] = std::move(newWord);
+}
+
+void ReplayEngine::applyRemove(Language &language, const LanguageDifference &diff)
+{
+    language.Words.erase(diff.WordID);
+}
+
+void ReplayEngine::applyCopyLanguage(Language &language, const LanguageDifference &diff)
+{
+    Language *source = getLanguage(diff.Source.Place);
+    if (source == nullptr || source == &language)
+        return;
+    // 語彙は共有し、どちらかが変更されたときに複製される
+    language.Words = source->Words;
+    language.Strength = source->Strength;
+}
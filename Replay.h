@@ -0,0 +1,63 @@
+#pragma once
+#include "Language.h"
+#include <span>
+
+/**
+ * @brief 差分を語族に適用する（再生）
+ *
+ * @note 音素の変換表と、場所ID から言語への参照を最初に一度だけ作り、差分ごとにはタイプ別の処理を呼ぶだけにする。
+ * @note 再生中は対象の語族を分岐させたり、LanguageMap を直接書き換えたりしないこと（言語への参照が無効になる）。
+ */
+class ReplayEngine
+{
+public:
+    /**
+     * @brief 再生の準備をする
+     *
+     * @param system 適用先の語族（地理と音素表を設定済みであること）
+     */
+    explicit ReplayEngine(LanguageSystem &system);
+
+    /**
+     * @brief 差分を適用
+     *
+     * @param diff 差分
+     */
+    void Apply(const LanguageDifference &diff);
+
+    /**
+     * @brief 差分を複数適用
+     *
+     * @param diffs 差分
+     */
+    void Apply(const std::vector<LanguageDifference> &diffs);
+
+    /**
+     * @brief 差分を複数、場所ごとに分けて並列に適用
+     *
+     * @param diffs 差分
+     * @param threadCount スレッド数（0 ならハードウェアのスレッド数）
+     *
+     * @note 場所ごとの差分の列をスレッドに割り当て、列の中の順序は保つ。
+     * @note 借用・複写は借用元と借用先の列がそろって同じ差分に達するまで待つ（同期点）ので、結果は Apply と同じになる。
+     * @note 単語追加は祖語も書き換えるので、その都度すべての列を止めて順に適用する。
+     */
+    void ApplyParallel(const std::vector<LanguageDifference> &diffs, unsigned int threadCount = 0);
+
+private:
+    Language *getLanguage(const int place);
+    void applyParallel(std::span<const LanguageDifference> diffs, const unsigned int threadCount);
+    void applyAddWord(Language &language, const LanguageDifference &diff);
+    void applyChangeStrength(Language &language, const LanguageDifference &diff);
+    void applyChangeSound(Language &language, const LanguageDifference &diff);
+    void applyChangeMeaning(Language &language, const LanguageDifference &diff);
+    void applyBorrowWord(Language &language, const LanguageDifference &diff);
+    void applyAddCompoundWord(Language &language, const LanguageDifference &diff);
+    void applyRemove(Language &language, const LanguageDifference &diff);
+    void applyCopyLanguage(Language &language, const LanguageDifference &diff);
+
+    LanguageSystem &system;
+    PhoneticsConverter converter;
+    // 場所ID ごとの言語（未作成なら nullptr）
+    std::vector<Language *> languages;
+};
@@ -0,0 +1,371 @@
+#include "Snapshot.h"
+#include "Binary.h"
+#include "DifferenceLog.h"
+#include <iostream>
+#include <limits>
+
+namespace
+{
+    constexpr char SNAPSHOT_MAGIC[8] = {'T', 'P', 'S', 'N', 'A', 'P', '\0', '\0'};
+    constexpr uint32_t SNAPSHOT_VERSION = 2;
+    // 祖語を表す場所番号
+    constexpr uint32_t PROTO_PLACE = std::numeric_limits<uint32_t>::max();
+
+    // ヘッダー（ファイル先頭）
+    struct SnapshotHeader
+    {
+        char Magic[8];
+        uint32_t Version;
+        int32_t Section;
+        uint32_t HasHistory;
+        uint32_t Padding;
+        // 文字列表
+        BinaryBlock StringOffsets;
+        BinaryBlock StringChars;
+        // 格子地図（行ごとのセル開始位置と、セルの文字列番号）
+        BinaryBlock MapRows;
+        BinaryBlock MapCells;
+        // 音素表
+        BinaryBlock PhoneticsRows;
+        BinaryBlock PhoneticsCells;
+        // 地理
+        BinaryBlock Places;
+        BinaryBlock Edges;
+        BinaryBlock AttributeNames;
+        BinaryBlock Attributes;
+        // 言語（先頭は祖語）
+        BinaryBlock Languages;
+        BinaryBlock Words;
+        BinaryBlock Phonemes;
+        BinaryBlock Meanings;
+        // 差分
+        BinaryBlock Differences;
+        BinaryBlock DifferencePayloads;
+        // 乱数の状態
+        BinaryBlock RandomState;
+    };
+
+    struct SnapshotLanguage
+    {
+        uint32_t Place;
+        uint32_t WordCount;
+        uint64_t WordBegin;
+        double Strength;
+    };
+
+    struct SnapshotWord
+    {
+        int32_t ID;
+        uint32_t SoundCount;
+        uint32_t ProtoCount;
+        uint32_t MeaningCount;
+        uint64_t SoundBegin;
+        uint64_t ProtoBegin;
+        uint64_t MeaningBegin;
+    };
+
+    struct SnapshotMeaning
+    {
+        uint32_t Key;
+        uint32_t Padding;
+        double Value;
+    };
+
+    // 差分の可変長データ（DifferenceRecord::Data がこの番号）
+    struct SnapshotPayload
+    {
+        uint32_t WordForm;
+        uint32_t MeaningCount;
+        uint64_t MeaningBegin;
+    };
+
+    // 言語を書き出すための作業領域
+    struct LanguageBlocks
+    {
+        std::vector<SnapshotLanguage> Languages;
+        std::vector<SnapshotWord> Words;
+        std::vector<Phonetics> Phonemes;
+        std::vector<SnapshotMeaning> Meanings;
+
+        void Add(BinaryStringTable &strings, const uint32_t place, const Language &language)
+        {
+            SnapshotLanguage entry{place, (uint32_t)language.Words.size(), Words.size(), language.Strength};
+            Languages.push_back(entry);
+            for (const auto &[id, word] : language.Words)
+            {
+                SnapshotWord w{};
+                w.ID = id;
+                w.SoundBegin = Phonemes.size();
+                w.SoundCount = (uint32_t)word.Sounds.size();
+                Phonemes.insert(Phonemes.end(), word.Sounds.begin(), word.Sounds.end());
+                w.ProtoBegin = Phonemes.size();
+                w.ProtoCount = (uint32_t)word.NearestProtoWord.size();
+                Phonemes.insert(Phonemes.end(), word.NearestProtoWord.begin(), word.NearestProtoWord.end());
+                w.MeaningBegin = Meanings.size();
+                w.MeaningCount = (uint32_t)word.Meanings.size();
+                for (const auto &[key, value] : word.Meanings)
+                {
+                    Meanings.push_back({strings.Add(key), 0, value});
+                }
+                Words.push_back(w);
+            }
+        }
+    };
+
+    // 言語を読み込む
+    bool readLanguage(const SnapshotLanguage &entry, std::span<const SnapshotWord> words, std::span<const Phonetics> phonemes, std::span<const SnapshotMeaning> meanings, const BinaryStringView &strings, Language &language)
+    {
+        if (!isInBinaryRange(entry.WordBegin, entry.WordCount, words.size()))
+            return false;
+        language.Strength = entry.Strength;
+        language.Words.clear();
+        language.Words.reserve(entry.WordCount);
+        for (uint64_t i = entry.WordBegin; i < entry.WordBegin + entry.WordCount; ++i)
+        {
+            const auto &w = words[i];
+            if (!isInBinaryRange(w.SoundBegin, w.SoundCount, phonemes.size()) ||
+                !isInBinaryRange(w.ProtoBegin, w.ProtoCount, phonemes.size()) ||
+                !isInBinaryRange(w.MeaningBegin, w.MeaningCount, meanings.size()))
+                return false;
+            Word word;
+            word.Sounds.assign(phonemes.begin() + w.SoundBegin, phonemes.begin() + w.SoundBegin + w.SoundCount);
+            word.NearestProtoWord.assign(phonemes.begin() + w.ProtoBegin, phonemes.begin() + w.ProtoBegin + w.ProtoCount);
+            for (uint64_t m = w.MeaningBegin; m < w.MeaningBegin + w.MeaningCount; ++m)
+            {
+                word.Meanings.emplace(strings.Get(meanings[m].Key), meanings[m].Value);
+            }
+            language.Words.emplace_hint(language.Words.end(), w.ID, std::move(word));
+        }
+        return true;
+    }
+}
+
+std::vector<char> encodeSnapshot(const LanguageSystem &system, const bool includeHistory)
+{
+    BinaryWriter writer;
+    BinaryStringTable strings;
+    SnapshotHeader header{};
+    std::memcpy(header.Magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.Version = SNAPSHOT_VERSION;
+    header.Section = system.Section;
+    header.HasHistory = includeHistory ? 1 : 0;
+    writer.Write(header);
+
+    // 1. 地図と音素表
+    writeBinaryTable(writer, strings, system.Map, header.MapRows, header.MapCells);
+    writeBinaryTable(writer, strings, system.PhoneticsMap, header.PhoneticsRows, header.PhoneticsCells);
+
+    // 2. 地理
+    std::vector<uint32_t> places;
+    places.reserve(system.Graph.Places.size());
+    for (const auto &place : system.Graph.Places)
+    {
+        places.push_back(strings.Add(place));
+    }
+    header.Places = writer.WriteBlock(places);
+    header.Edges = writer.WriteBlock(system.Graph.Edges);
+    std::vector<uint32_t> attributeNames;
+    for (const auto &name : system.Graph.AttributeNames)
+    {
+        attributeNames.push_back(strings.Add(name));
+    }
+    header.AttributeNames = writer.WriteBlock(attributeNames);
+    header.Attributes = writer.WriteBlock(system.Graph.Attributes);
+
+    // 3. 言語
+    LanguageBlocks languages;
+    languages.Add(strings, PROTO_PLACE, system.ProtoLanguage);
+    for (const auto &[place, language] : system.LanguageMap)
+    {
+        languages.Add(strings, strings.Add(place), language);
+    }
+    header.Languages = writer.WriteBlock(languages.Languages);
+    header.Words = writer.WriteBlock(languages.Words);
+    header.Phonemes = writer.WriteBlock(languages.Phonemes);
+
+    // 4. 差分と乱数の状態
+    if (includeHistory)
+    {
+        std::vector<DifferenceRecord> differences;
+        std::vector<SnapshotPayload> payloads;
+        differences.reserve(system.CountDifferences());
+        system.ForEachDifference([&](const LanguageDifference &diff)
+        {
+            auto d = DifferenceRecord::Create(diff);
+            if (diff.HasPayload())
+            {
+                d.Data = payloads.size();
+                SnapshotPayload payload{};
+                payload.WordForm = strings.Add(diff.GetWordForm());
+                payload.MeaningBegin = languages.Meanings.size();
+                payload.MeaningCount = (uint32_t)diff.GetMeaning().size();
+                for (const auto &[key, value] : diff.GetMeaning())
+                {
+                    languages.Meanings.push_back({strings.Add(key), 0, value});
+                }
+                payloads.push_back(payload);
+            }
+            differences.push_back(d);
+        });
+        header.Differences = writer.WriteBlock(differences);
+        header.DifferencePayloads = writer.WriteBlock(payloads);
+
+        const std::string randomState = getRandomState();
+        header.RandomState = writer.WriteBlock(randomState.data(), randomState.size());
+    }
+    header.Meanings = writer.WriteBlock(languages.Meanings);
+
+    // 5. 文字列表（最後にまとめて書く）
+    strings.Write(writer, header.StringOffsets, header.StringChars);
+    writer.Align();
+    writer.Overwrite(0, header);
+    return std::move(writer.Buffer);
+}
+
+bool decodeSnapshot(LanguageSystem &system, const char *data, const size_t size)
+{
+    BinaryReader reader(data, size);
+    SnapshotHeader header;
+    if (!reader.Read(0, header) || std::memcmp(header.Magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+    {
+        std::cerr << "Error: スナップショットではありません" << std::endl;
+        return false;
+    }
+    if (header.Version != SNAPSHOT_VERSION)
+    {
+        std::cerr << "Error: 未対応のスナップショットのバージョンです: " << header.Version << std::endl;
+        return false;
+    }
+
+    const BinaryStringView strings(reader, header.StringOffsets, header.StringChars);
+    const auto placeIndices = reader.Block<uint32_t>(header.Places);
+    const auto edges = reader.Block<GeographyEdge>(header.Edges);
+    const auto attributeNames = reader.Block<uint32_t>(header.AttributeNames);
+    const auto attributes = reader.Block<double>(header.Attributes);
+    const auto languages = reader.Block<SnapshotLanguage>(header.Languages);
+    const auto words = reader.Block<SnapshotWord>(header.Words);
+    const auto phonemes = reader.Block<Phonetics>(header.Phonemes);
+    const auto meanings = reader.Block<SnapshotMeaning>(header.Meanings);
+    const auto differences = reader.Block<DifferenceRecord>(header.Differences);
+    const auto payloads = reader.Block<SnapshotPayload>(header.DifferencePayloads);
+    const auto randomState = reader.Block<char>(header.RandomState);
+
+    const bool isValid = strings.Size() + 1 == header.StringOffsets.Count &&
+                         reader.IsValid<char>(header.StringChars) &&
+                         placeIndices.size() == header.Places.Count &&
+                         edges.size() == header.Edges.Count &&
+                         attributeNames.size() == header.AttributeNames.Count &&
+                         attributes.size() == header.Attributes.Count &&
+                         !languages.empty() && languages.size() == header.Languages.Count &&
+                         words.size() == header.Words.Count &&
+                         phonemes.size() == header.Phonemes.Count &&
+                         meanings.size() == header.Meanings.Count &&
+                         differences.size() == header.Differences.Count &&
+                         payloads.size() == header.DifferencePayloads.Count &&
+                         randomState.size() == header.RandomState.Count;
+    auto fail = []()
+    {
+        std::cerr << "Error: スナップショットが壊れています" << std::endl;
+        return false;
+    };
+    if (!isValid)
+        return fail();
+
+    // 復元先を直接書き換えないよう、一旦別の語族に読み込む
+    LanguageSystem result;
+    result.Section = header.Section;
+    if (!readBinaryTable(reader, strings, header.MapRows, header.MapCells, result.Map) ||
+        !readBinaryTable(reader, strings, header.PhoneticsRows, header.PhoneticsCells, result.PhoneticsMap))
+        return fail();
+
+    // 1. 地理
+    for (const auto index : placeIndices)
+    {
+        result.Graph.Places.emplace_back(strings.Get(index));
+    }
+    for (const auto &edge : edges)
+    {
+        if (edge.From < 0 || edge.To < 0 || edge.From >= (int)placeIndices.size() || edge.To >= (int)placeIndices.size())
+            return fail();
+    }
+    result.Graph.Edges.assign(edges.begin(), edges.end());
+    for (const auto index : attributeNames)
+    {
+        result.Graph.AttributeNames.emplace_back(strings.Get(index));
+    }
+    if (attributes.size() != placeIndices.size() * attributeNames.size())
+        return fail();
+    result.Graph.Attributes.assign(attributes.begin(), attributes.end());
+    result.Graph.Build();
+
+    // 2. 言語
+    if (languages[0].Place != PROTO_PLACE || !readLanguage(languages[0], words, phonemes, meanings, strings, result.ProtoLanguage))
+        return fail();
+    for (size_t i = 1; i < languages.size(); ++i)
+    {
+        Language language;
+        if (!readLanguage(languages[i], words, phonemes, meanings, strings, language))
+            return fail();
+        result.LanguageMap.emplace_hint(result.LanguageMap.end(), std::string(strings.Get(languages[i].Place)), std::move(language));
+    }
+
+    // 3. 差分と乱数の状態
+    if (header.HasHistory)
+    {
+        result.languageDifference.reserve(differences.size());
+        for (const auto &d : differences)
+        {
+            LanguageDifference diff;
+            if (!d.Restore(placeIndices.size(), diff))
+                return fail();
+            if (diff.HasPayload())
+            {
+                if (d.Data >= payloads.size())
+                    return fail();
+                const auto &payload = payloads[d.Data];
+                if (!isInBinaryRange(payload.MeaningBegin, payload.MeaningCount, meanings.size()))
+                    return fail();
+                diff.Payload = new DifferencePayload;
+                diff.Payload->WordForm = strings.Get(payload.WordForm);
+                for (uint64_t m = payload.MeaningBegin; m < payload.MeaningBegin + payload.MeaningCount; ++m)
+                {
+                    diff.Payload->Meanings.emplace(strings.Get(meanings[m].Key), meanings[m].Value);
+                }
+            }
+            result.languageDifference.push_back(std::move(diff));
+        }
+        if (!setRandomState(std::string(randomState.begin(), randomState.end())))
+            return fail();
+    }
+
+    // 状態だけを移す（Sink・KeepDifferences・Arena は呼び出し側のものを残す）
+    system.Section = result.Section;
+    system.Map = std::move(result.Map);
+    system.Graph = std::move(result.Graph);
+    system.PhoneticsMap = std::move(result.PhoneticsMap);
+    system.LanguageMap = std::move(result.LanguageMap);
+    system.ProtoLanguage = std::move(result.ProtoLanguage);
+    if (header.HasHistory)
+    {
+        system.BaseDifference = std::move(result.BaseDifference);
+        system.languageDifference = std::move(result.languageDifference);
+    }
+    return true;
+}
+
+bool LanguageSystem::SaveSnapshot(const std::string &filename) const
+{
+    const auto data = encodeSnapshot(*this);
+    return writeBinaryFile(filename, data.data(), data.size());
+}
+
+bool LanguageSystem::LoadSnapshot(const std::string &filename)
+{
+    MappedFile file;
+    if (!file.Open(filename))
+    {
+        std::cerr << "Error: ファイルを開けませんでした: " << filename << std::endl;
+        return false;
+    }
+    return decodeSnapshot(*this, file.Data(), file.Size());
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "Language.h"
+
+/**
+ * @brief 語族の状態をバイナリに変換する
+ *
+ * @param system 語族
+ * @param includeHistory 差分と乱数の状態を含めるか
+ * @return バイナリ（8バイト境界に揃えたブロックの並び、そのままマップして読める）
+ */
+std::vector<char> encodeSnapshot(const LanguageSystem &system, const bool includeHistory = true);
+
+/**
+ * @brief バイナリから語族の状態を復元する
+ *
+ * @param system 復元先
+ * @param data バイナリ
+ * @param size バイト数
+ * @return 成功したら true（失敗したら復元先は変更しない）
+ *
+ * @note 差分と乱数の状態を含まないバイナリでは、それらは変更しない。
+ * @note Sink・KeepDifferences・Arena は復元先のものをそのまま使う。
+ */
+bool decodeSnapshot(LanguageSystem &system, const char *data, const size_t size);
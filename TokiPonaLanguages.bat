@@ -2,7 +2,7 @@
 setlocal
 
 pushd "%~dp0"
-g++ -o ignore/a Utility.cpp Random.cpp Language.cpp TokiPonaLanguages.cpp -std=c++2a -lcomdlg32
+g++ -o ignore/a Utility.cpp Random.cpp Geography.cpp Binary.cpp Language.cpp Snapshot.cpp DifferenceLog.cpp Replay.cpp Compaction.cpp Etymology.cpp Columnar.cpp Distance.cpp Phylogeny.cpp Profile.cpp Arena.cpp TokiPonaLanguages.cpp -std=c++2a -pthread -lcomdlg32
 popd
 
 pause
\ No newline at end of file
@@ -261,7 +261,7 @@ WindowType DisplayWindow(WindowType type)
         std::cout << "=============================================\n";
         std::cout << "> 言語変化シミュレート > 表示\n";
 
-        const auto geometry = getNonEmptyStrings(language_system->Map);
+        const auto &geometry = language_system->Graph.Places;
         DisplayMulti(geometry);
 
         std::cout << "q : 戻る\n";
@@ -306,7 +306,7 @@ WindowType DisplayWindow(WindowType type)
 
         language_system = LanguageSystem();
         language_system->Import(input);
-        language_system->ApplyDifferences(language_system->languageDifference);
+        language_system->ApplyDifferences(language_system->languageDifference, 0);
 
         language_system->Export("ignore/test.log");
 
@@ -328,7 +328,7 @@ WindowType DisplayWindow(WindowType type)
         std::cout << "=============================================\n";
         std::cout << "> ファイル選択 > 結果\n";
 
-        const auto geometry = getNonEmptyStrings(language_system->Map);
+        const auto &geometry = language_system->Graph.Places;
         DisplayMulti(geometry);
 
         std::cout << "q : 戻る\n";
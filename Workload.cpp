@@ -0,0 +1,203 @@
+#include "Workload.h"
+#include "Language.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string_view>
+#include <unordered_set>
+
+namespace
+{
+    constexpr int CONSONANT_ROWS = MAX_CONSONANT_MANNAR + 1;
+    constexpr char CONSONANT_LETTERS[] = "ptkmnslwjbdgfhvzrcqxy";
+    constexpr char VOWEL_LETTERS[] = "aeiou";
+    constexpr char SECOND_LETTERS[] = "abcdefghijklmnopqrstuvwxyz";
+
+    // 標準ライブラリの分布は実装ごとに結果が違うので、乱数の値から直接求める
+    class WorkloadRandom
+    {
+    public:
+        explicit WorkloadRandom(const unsigned int seed) : engine(seed) {}
+
+        // [0, n)
+        uint64_t Index(const uint64_t n) { return engine() % n; }
+        bool Probability(const double p) { return (engine() >> 11) * (1.0 / 9007199254740992.0) < p; }
+
+    private:
+        std::mt19937_64 engine;
+    };
+
+    // 音素の文字列（一方の種類の数が1文字で足りなければ、すべて2文字にする）
+    std::string getPhonemeString(const bool isConsonant, const size_t index, const bool isLong)
+    {
+        const std::string_view letters = isConsonant ? CONSONANT_LETTERS : VOWEL_LETTERS;
+        if (!isLong)
+            return std::string(1, letters[index]);
+        return std::string{letters[index / 26], SECOND_LETTERS[index % 26]};
+    }
+
+    // 音素の並びが音韻変化の音素重複の禁止に反しないか
+    bool isValidWord(const std::vector<bool> &isConsonants)
+    {
+        const size_t n = isConsonants.size();
+        if (n == 0 || (n == 1 && isConsonants[0]))
+            return false;
+        if (n >= 2 && ((isConsonants[0] && isConsonants[1]) || (isConsonants[n - 1] && isConsonants[n - 2])))
+            return false;
+        for (size_t i = 0; i + 2 < n; ++i)
+        {
+            if (isConsonants[i] == isConsonants[i + 1] && isConsonants[i + 1] == isConsonants[i + 2])
+                return false;
+        }
+        return true;
+    }
+}
+
+std::vector<std::vector<std::string>> generatePhonemeTable(const int columns, const int vowelRows, const double fillRate, const unsigned int seed)
+{
+    WorkloadRandom random(seed);
+    const int rows = CONSONANT_ROWS + std::max(1, vowelRows);
+    const int width = std::max(1, columns);
+    std::vector<std::vector<std::string>> table(rows, std::vector<std::string>(width));
+
+    // 1. 音素を置くマスを決める（各行に1つ以上）
+    std::vector<std::vector<bool>> isFilled(rows, std::vector<bool>(width, false));
+    size_t consonantCount = 0, vowelCount = 0;
+    for (int r = 0; r < rows; ++r)
+    {
+        isFilled[r][random.Index(width)] = true;
+        for (int c = 0; c < width; ++c)
+        {
+            if (random.Probability(fillRate))
+                isFilled[r][c] = true;
+        }
+        const size_t count = std::count(isFilled[r].begin(), isFilled[r].end(), true);
+        (r < CONSONANT_ROWS ? consonantCount : vowelCount) += count;
+    }
+
+    // 2. 文字列を割り当てる
+    const size_t consonantLetters = sizeof(CONSONANT_LETTERS) - 1;
+    const size_t vowelLetters = sizeof(VOWEL_LETTERS) - 1;
+    const bool isLong = consonantCount > consonantLetters || vowelCount > vowelLetters;
+    size_t consonantIndex = 0, vowelIndex = 0;
+    for (int r = 0; r < rows; ++r)
+    {
+        const bool isConsonant = r < CONSONANT_ROWS;
+        auto &index = isConsonant ? consonantIndex : vowelIndex;
+        const size_t capacity = (isConsonant ? consonantLetters : vowelLetters) * (isLong ? 26 : 1);
+        for (int c = 0; c < width; ++c)
+        {
+            if (isFilled[r][c] && index < capacity)
+                table[r][c] = getPhonemeString(isConsonant, index++, isLong);
+        }
+    }
+    return table;
+}
+
+std::vector<std::string> generateProtoLexicon(const std::vector<std::vector<std::string>> &table, const int wordCount, const int maxSyllables, const unsigned int seed)
+{
+    WorkloadRandom random(seed);
+    std::vector<std::string> consonants, vowels;
+    for (int r = 0; r < (int)table.size(); ++r)
+    {
+        for (const auto &cell : table[r])
+        {
+            if (!cell.empty())
+                (r <= MAX_CONSONANT_MANNAR ? consonants : vowels).push_back(cell);
+        }
+    }
+    if (vowels.empty())
+    {
+        std::cerr << "Error: 音素表に母音がありません" << std::endl;
+        return {};
+    }
+
+    std::vector<std::string> words;
+    words.reserve(std::max(0, wordCount));
+    std::unordered_set<std::string> used;
+    std::vector<bool> isConsonants;
+    const uint64_t maxAttempts = 100 * (uint64_t)std::max(1, wordCount) + 1000;
+    for (uint64_t attempt = 0; (int)words.size() < wordCount; ++attempt)
+    {
+        if (attempt >= maxAttempts)
+        {
+            std::cerr << "Error: 重複のない単語を " << wordCount << " 個作れませんでした（音素か音節を増やしてください）" << std::endl;
+            return {};
+        }
+        // (C)V(V)(C) の音節を並べる
+        std::string word;
+        isConsonants.clear();
+        auto append = [&](const bool isConsonant)
+        {
+            const auto &pool = isConsonant ? consonants : vowels;
+            word += pool[random.Index(pool.size())];
+            isConsonants.push_back(isConsonant);
+        };
+        const int syllables = 1 + (int)random.Index(std::max(1, maxSyllables));
+        for (int s = 0; s < syllables; ++s)
+        {
+            if (!consonants.empty() && random.Probability(0.8))
+                append(true);
+            append(false);
+            if (random.Probability(0.2))
+                append(false);
+            if (!consonants.empty() && random.Probability(0.3))
+                append(true);
+        }
+        if (isValidWord(isConsonants) && used.insert(word).second)
+            words.push_back(std::move(word));
+    }
+    return words;
+}
+
+std::vector<std::vector<std::string>> generateGridMap(const int width, const int height)
+{
+    std::vector<std::vector<std::string>> map(std::max(1, height), std::vector<std::string>(std::max(1, width)));
+    int index = 0;
+    for (auto &row : map)
+    {
+        for (auto &cell : row)
+        {
+            cell = std::to_string(index++);
+        }
+    }
+    return map;
+}
+
+std::vector<std::vector<std::string>> generateGraphMap(const int places, const double averageDegree, const unsigned int seed)
+{
+    WorkloadRandom random(seed);
+    const int n = std::max(1, places);
+    // 番号がこの範囲内の場所とつなぐ
+    const int window = std::max(2, (int)std::sqrt((double)n));
+    auto getWeight = [&]()
+    {
+        std::ostringstream stream;
+        stream << 0.5 + random.Index(1001) / 1000.0;
+        return stream.str();
+    };
+
+    std::vector<std::vector<std::string>> map = {{"source", "target", "weight"}};
+    if (n == 1)
+    {
+        map.push_back({"0", "0", "1"});
+        return map;
+    }
+    // 1. 全域木（前の場所のどれかとつなぐ）
+    for (int i = 1; i < n; ++i)
+    {
+        const int j = i - 1 - (int)random.Index(std::min(i, window));
+        map.push_back({std::to_string(j), std::to_string(i), getWeight()});
+    }
+    // 2. 平均の隣接数になるまで辺を足す（同じ辺が重なれば、その分だけ借用で選ばれやすくなる）
+    const uint64_t extraEdges = (uint64_t)std::max(0.0, averageDegree / 2.0 * n - (n - 1));
+    for (uint64_t e = 0; e < extraEdges; ++e)
+    {
+        const int i = 1 + (int)random.Index(n - 1);
+        const int j = i - 1 - (int)random.Index(std::min(i, window));
+        map.push_back({std::to_string(j), std::to_string(i), getWeight()});
+    }
+    return map;
+}
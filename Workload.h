@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <vector>
+
+/**
+ * @brief 音素表を作る
+ *
+ * @param columns 調音部位（列）の数
+ * @param vowelRows 母音の調音方法（行）の数（子音は音韻変化と同じく先頭の4行）
+ * @param fillRate 音素のあるマスの割合（各行に1つ以上は置く）
+ * @param seed 乱数のシード
+ * @return Phonetics.csv と同じ形式の表
+ *
+ * @note 音素の文字列は、子音 21 個・母音 5 個までは1文字、それを超えるとすべて2文字にそろえる（どの並びも一通りにしか区切れない）。
+ * @note 子音は最大 21 × 26 個、母音は最大 5 × 26 個で、超える分のマスは空にする。
+ */
+std::vector<std::vector<std::string>> generatePhonemeTable(int columns, int vowelRows, double fillRate, unsigned int seed);
+
+/**
+ * @brief 祖語の単語を作る
+ *
+ * @param table 音素表
+ * @param wordCount 単語の数
+ * @param maxSyllables 1単語の最大音節数
+ * @param seed 乱数のシード
+ * @return 重複のない単語（作れなければ空）
+ *
+ * @note 音節は (C)V(V)(C)。音韻変化の音素重複の禁止と同じく、語頭・語末の子音の連続や、同じ種類の音素の3連続を含む単語は作らない。
+ */
+std::vector<std::string> generateProtoLexicon(const std::vector<std::vector<std::string>> &table, int wordCount, int maxSyllables, unsigned int seed);
+
+/**
+ * @brief 格子状の地図を作る
+ *
+ * @param width 幅
+ * @param height 高さ
+ * @return Map.csv と同じ形式の地図（場所名は左上から "0", "1", ...）
+ */
+std::vector<std::vector<std::string>> generateGridMap(int width, int height);
+
+/**
+ * @brief 辺リスト形式の地図を作る
+ *
+ * @param places 場所の数
+ * @param averageDegree 平均の隣接数（2 以上、少なくとも全域木の辺は置く）
+ * @param seed 乱数のシード
+ * @return 辺リスト形式の地図（場所名は "0", "1", ...、重みは 0.5 〜 1.5）
+ *
+ * @note 各場所は番号の近い場所とつなぐ（地理的な近さの代わり）。どの場所も "0" からたどれる。
+ */
+std::vector<std::vector<std::string>> generateGraphMap(int places, double averageDegree, unsigned int seed);
@@ -0,0 +1,314 @@
+#include "Evolution.h"
+#include "Workload.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+
+namespace
+{
+    /**
+     * @brief ベンチマークの語族の設定
+     *
+     */
+    struct BenchmarkFixture
+    {
+        // 場所の数（辺リスト形式の地図、平均の隣接数は 4）
+        int Places = 16;
+        // 祖語の単語の数
+        int Words = 100;
+        // 1単語の最大音節数
+        int MaxSyllables = 2;
+        // 乱数のシード
+        unsigned int Seed = 1;
+    };
+
+    /**
+     * @brief ベンチマークの結果
+     *
+     */
+    struct BenchmarkResult
+    {
+        std::string Name;
+        BenchmarkFixture Fixture;
+        int Iterations = 0;
+        // 1回あたりの時間（ナノ秒）
+        double Min = 0.0;
+        double Median = 0.0;
+        double Mean = 0.0;
+    };
+
+    // 準備した語族と、その差分
+    struct PreparedFixture
+    {
+        LanguageSystem System;
+        std::vector<LanguageDifference> Differences;
+        std::vector<std::string> WordStrings;
+    };
+
+    // 語族を作る（祖語を1か所に置き、全域に広がるまで進めてから、さらに変化させる）
+    PreparedFixture prepareFixture(const BenchmarkFixture &fixture)
+    {
+        PreparedFixture result;
+        setRandomSeed(fixture.Seed);
+        auto &system = result.System;
+        system.SetMap(generateGraphMap(fixture.Places, 4.0, fixture.Seed));
+        system.PhoneticsMap = readCSV("Phonetics.csv");
+        const auto words = generateProtoLexicon(system.PhoneticsMap, fixture.Words, fixture.MaxSyllables, fixture.Seed);
+        system.SetOldLanguageOnMap("0", PhoneticsConverter::Create(system.PhoneticsMap).convertToLanguage(words));
+
+        // 借用の段階は1回に1か所にしか広がらず大きな地図では終わらないので、世代ごとに隣接する空の場所へまとめて複写する
+        const EvolutionParameters parameters = {std::max(1, fixture.Places / 4), 0.3, 0.3, 0.1, 0.1, 0.02, 0.02};
+        std::vector<int> frontier = {system.Graph.FindPlace("0")};
+        std::vector<bool> isReached(system.Graph.Places.size(), false);
+        isReached[frontier[0]] = true;
+        while (!frontier.empty())
+        {
+            std::vector<int> next;
+            for (const int from : frontier)
+            {
+                // 語彙は共有し、どちらかが変更されたときに複製される
+                const Language source = system.LanguageMap.find(system.Graph.Places[from])->second;
+                for (int k = system.Graph.Offsets[from]; k < system.Graph.Offsets[from + 1]; ++k)
+                {
+                    const int to = system.Graph.Neighbors[k];
+                    if (isReached[to])
+                        continue;
+                    isReached[to] = true;
+                    system.LanguageMap[system.Graph.Places[to]] = source;
+                    system.AddDifference(LanguageDifference::CreateCopyLanguage(from, to, system.Section));
+                    next.push_back(to);
+                }
+            }
+            frontier = std::move(next);
+            stepEvolution(system, parameters);
+        }
+        for (int i = 0; i < 20; ++i)
+        {
+            stepEvolution(system, parameters);
+        }
+        system.ForEachDifference([&](const LanguageDifference &diff)
+                                 { result.Differences.push_back(diff); });
+        for (const auto &[place, language] : system.LanguageMap)
+        {
+            const auto placeWords = system.GetWords(place);
+            result.WordStrings.insert(result.WordStrings.end(), placeWords.begin(), placeWords.end());
+        }
+        return result;
+    }
+
+    // 語彙を共有していない複製（書き込み時のコピーを計測に含めない）
+    LanguageSystem copyFixture(const LanguageSystem &system)
+    {
+        LanguageSystem result = system;
+        for (auto &[place, language] : result.LanguageMap.Mutable())
+        {
+            language.Words.Mutable();
+        }
+        return result;
+    }
+
+    /**
+     * @brief 準備と計測を繰り返す
+     *
+     * @param setup 毎回の準備（計測しない）
+     * @param run 計測する処理
+     */
+    template <typename Setup, typename Run>
+    BenchmarkResult measure(const std::string &name, const BenchmarkFixture &fixture, const int iterations, Setup setup, Run run)
+    {
+        std::vector<double> times;
+        for (int i = 0; i < iterations; ++i)
+        {
+            auto state = setup();
+            setRandomSeed(fixture.Seed + i);
+            const auto start = std::chrono::steady_clock::now();
+            run(state);
+            const auto finish = std::chrono::steady_clock::now();
+            times.push_back(std::chrono::duration<double, std::nano>(finish - start).count());
+        }
+        std::sort(times.begin(), times.end());
+        BenchmarkResult result;
+        result.Name = name;
+        result.Fixture = fixture;
+        result.Iterations = iterations;
+        result.Min = times.front();
+        result.Median = times[times.size() / 2];
+        for (const double time : times)
+        {
+            result.Mean += time / times.size();
+        }
+        return result;
+    }
+
+    std::vector<BenchmarkResult> runBenchmarks(const BenchmarkFixture &fixture, const int iterations, const std::string &filter, const std::string &workPath)
+    {
+        std::vector<BenchmarkResult> results;
+        auto isSelected = [&](const std::string &name)
+        {
+            return filter.empty() || name.find(filter) != std::string::npos;
+        };
+        const auto prepared = prepareFixture(fixture);
+        auto copySystem = [&]()
+        {
+            return copyFixture(prepared.System);
+        };
+
+        // 1. 段階
+        const std::vector<std::pair<std::string, std::function<void(LanguageSystem &)>>> stages = {
+            {"ChangeLanguageSound", [](LanguageSystem &system)
+             { system.ChangeLanguageSound(1.0, 0.3); }},
+            {"ChangeLanguageMeaning", [](LanguageSystem &system)
+             { system.ChangeLanguageMeaning(1.0, 0.1); }},
+            {"BollowWord", [&](LanguageSystem &system)
+             { system.BollowWord(fixture.Places, 0.5); }},
+            {"RemoveWordRandom", [](LanguageSystem &system)
+             { system.RemoveWordRandom(1.0); }},
+            {"CreateWord", [](LanguageSystem &system)
+             { system.CreateWord(1.0); }},
+        };
+        for (const auto &[name, stage] : stages)
+        {
+            if (isSelected(name))
+                results.push_back(measure(name, fixture, iterations, copySystem, stage));
+        }
+
+        // 2. 差分の再生
+        if (isSelected("ApplyDifferences"))
+        {
+            results.push_back(measure(
+                "ApplyDifferences", fixture, iterations,
+                [&]()
+                {
+                    LanguageSystem system;
+                    system.Map = prepared.System.Map;
+                    system.Graph = prepared.System.Graph;
+                    system.PhoneticsMap = prepared.System.PhoneticsMap;
+                    return system;
+                },
+                [&](LanguageSystem &system)
+                { system.ApplyDifferences(prepared.Differences); }));
+        }
+
+        // 3. ログの入出力
+        const std::string logPath = workPath + ".log";
+        const std::string binaryLogPath = workPath + ".binlog";
+        if (isSelected("Export"))
+        {
+            results.push_back(measure("Export", fixture, iterations, copySystem, [&](LanguageSystem &system)
+                                      { system.Export(logPath); }));
+        }
+        if (isSelected("ExportBinary"))
+        {
+            results.push_back(measure("ExportBinary", fixture, iterations, copySystem, [&](LanguageSystem &system)
+                                      { system.ExportBinary(binaryLogPath); }));
+        }
+        auto createSystem = []()
+        {
+            return LanguageSystem();
+        };
+        if (isSelected("Import"))
+        {
+            copyFixture(prepared.System).Export(logPath);
+            results.push_back(measure("Import", fixture, iterations, createSystem, [&](LanguageSystem &system)
+                                      { system.Import(logPath); }));
+        }
+        if (isSelected("ImportBinary"))
+        {
+            copyFixture(prepared.System).ExportBinary(binaryLogPath);
+            results.push_back(measure("ImportBinary", fixture, iterations, createSystem, [&](LanguageSystem &system)
+                                      { system.Import(binaryLogPath); }));
+        }
+
+        // 4. 結果の出力と音素列への変換
+        if (isSelected("exportLanguageToCSV"))
+        {
+            results.push_back(measure("exportLanguageToCSV", fixture, iterations, copySystem, [&](LanguageSystem &system)
+                                      { system.ExportLanguageToCSV(workPath + ".csv"); }));
+        }
+        if (isSelected("convertToPhonetics"))
+        {
+            const auto converter = PhoneticsConverter::Create(prepared.System.PhoneticsMap);
+            auto createOutput = []()
+            {
+                return std::pair<std::vector<Phonetics>, std::vector<uint64_t>>();
+            };
+            results.push_back(measure("convertToPhonetics", fixture, iterations, createOutput, [&](auto &output)
+                                      { converter.convertToPhonetics(prepared.WordStrings, output.first, output.second); }));
+        }
+
+        // 作業ファイルを消す
+        std::error_code error;
+        for (const auto &path : {logPath, binaryLogPath, workPath + ".csv"})
+        {
+            std::filesystem::remove(path, error);
+        }
+        return results;
+    }
+
+    // 結果をCSVに出力する
+    bool exportResults(const std::vector<BenchmarkResult> &results, const std::string &filename)
+    {
+        std::ofstream file(filename.c_str());
+        if (!file.is_open())
+        {
+            std::cerr << "Error: ファイルを開けませんでした: " << filename << std::endl;
+            return false;
+        }
+        file << "name,places,words,max_syllables,seed,iterations,min_ns,median_ns,mean_ns\n";
+        file << std::fixed << std::setprecision(0);
+        for (const auto &result : results)
+        {
+            file << result.Name << ","
+                 << result.Fixture.Places << ","
+                 << result.Fixture.Words << ","
+                 << result.Fixture.MaxSyllables << ","
+                 << result.Fixture.Seed << ","
+                 << result.Iterations << ","
+                 << result.Min << ","
+                 << result.Median << ","
+                 << result.Mean << "\n";
+        }
+        return true;
+    }
+}
+
+/**
+ * @brief 各段階のベンチマーク
+ *
+ * @note 引数: [出力CSV] [名前の絞り込み] [繰り返し回数]
+ */
+int main(int argc, char *argv[])
+{
+    const std::string outputPath = argc > 1 ? argv[1] : "ignore/bench.csv";
+    const std::string filter = argc > 2 ? argv[2] : "";
+    const int iterations = argc > 3 ? std::max(1, std::atoi(argv[3])) : 5;
+
+    // 場所の数・語彙の大きさ・単語の長さを変えた語族（最後の2つは大きな入力）
+    const std::vector<BenchmarkFixture> fixtures = {
+        {16, 100, 2, 1},
+        {64, 100, 2, 1},
+        {64, 400, 2, 1},
+        {64, 100, 5, 1},
+        {256, 200, 3, 1},
+        {1024, 1000, 3, 1},
+        {4096, 200, 3, 1},
+    };
+
+    std::vector<BenchmarkResult> results;
+    for (const auto &fixture : fixtures)
+    {
+        for (const auto &result : runBenchmarks(fixture, iterations, filter, outputPath + ".work"))
+        {
+            std::cout << std::left << std::setw(24) << result.Name << std::right
+                      << " places=" << std::setw(4) << result.Fixture.Places
+                      << " words=" << std::setw(4) << result.Fixture.Words
+                      << " syllables=" << std::setw(2) << result.Fixture.MaxSyllables
+                      << " median=" << std::fixed << std::setprecision(3) << std::setw(12) << result.Median / 1e6 << " ms\n";
+            results.push_back(result);
+        }
+    }
+    return exportResults(results, outputPath) ? 0 : 1;
+}
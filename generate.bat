@@ -0,0 +1,12 @@
+@echo off
+setlocal
+
+pushd "%~dp0"
+
+g++ -O2 -o ignore/generate Utility.cpp Workload.cpp generate.cpp -std=c++2a
+
+ignore\generate.exe %*
+
+popd
+
+pause
\ No newline at end of file
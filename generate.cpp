@@ -0,0 +1,67 @@
+#include "Utility.h"
+#include "Workload.h"
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+
+/**
+ * @brief 大きな入力データ（音素表・祖語・地図）を作る
+ *
+ * @note 引数: OUTPUT_DIR [SEED] [WORDS] [MAX_SYLLABLES] [PHONEME_COLUMNS] [VOWEL_ROWS] [MAP_TYPE] [PLACES] [AVERAGE_DEGREE]
+ * @note OUTPUT_DIR に Phonetics.csv・OldTokiPona.csv・Map.csv を書く。MAP_TYPE は grid か graph。
+ */
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Error: 出力先のディレクトリを指定してください" << std::endl;
+        return 1;
+    }
+    const std::filesystem::path outputDirectory = argv[1];
+    const unsigned int seed = argc > 2 ? (unsigned int)std::stoul(argv[2]) : 1;
+    const int words = argc > 3 ? std::stoi(argv[3]) : 10000;
+    const int maxSyllables = argc > 4 ? std::stoi(argv[4]) : 3;
+    const int phonemeColumns = argc > 5 ? std::stoi(argv[5]) : 8;
+    const int vowelRows = argc > 6 ? std::stoi(argv[6]) : 3;
+    const std::string mapType = argc > 7 ? argv[7] : "grid";
+    const int places = argc > 8 ? std::stoi(argv[8]) : 10000;
+    const double averageDegree = argc > 9 ? std::stod(argv[9]) : 4.0;
+
+    std::error_code error;
+    std::filesystem::create_directories(outputDirectory, error);
+
+    // 1. 音素表と祖語
+    const auto table = generatePhonemeTable(phonemeColumns, vowelRows, 0.7, seed);
+    const auto lexicon = generateProtoLexicon(table, words, maxSyllables, seed + 1);
+    if (lexicon.empty())
+    {
+        return 1;
+    }
+
+    // 2. 地図（格子はできるだけ正方形にする）
+    std::vector<std::vector<std::string>> map;
+    if (mapType == "grid")
+    {
+        const int width = std::max(1, (int)std::ceil(std::sqrt((double)places)));
+        map = generateGridMap(width, (places + width - 1) / width);
+    }
+    else if (mapType == "graph")
+    {
+        map = generateGraphMap(places, averageDegree, seed + 2);
+    }
+    else
+    {
+        std::cerr << "Error: 未知の地図の種類です: " << mapType << std::endl;
+        return 1;
+    }
+
+    const bool isWritten = writeCSV((outputDirectory / "Phonetics.csv").string(), table) &&
+                           writeCSV((outputDirectory / "OldTokiPona.csv").string(), {lexicon}) &&
+                           writeCSV((outputDirectory / "Map.csv").string(), map);
+    if (!isWritten)
+    {
+        return 1;
+    }
+    std::cout << "音素: " << getNonEmptyStrings(table).size() << ", 単語: " << lexicon.size() << ", 地図の行: " << map.size() << "\n";
+    return 0;
+}
@@ -0,0 +1,12 @@
+@echo off
+setlocal
+
+pushd "%~dp0"
+
+g++ -O2 -o ignore/regression Utility.cpp Random.cpp Geography.cpp Binary.cpp Language.cpp Snapshot.cpp DifferenceLog.cpp Replay.cpp Compaction.cpp Etymology.cpp Columnar.cpp Distance.cpp Phylogeny.cpp Profile.cpp Arena.cpp regression.cpp -std=c++2a -pthread
+
+ignore\regression.exe %*
+
+popd
+
+pause
\ No newline at end of file
@@ -0,0 +1,537 @@
+#include "Evolution.h"
+#include "Columnar.h"
+#include "Etymology.h"
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+
+namespace
+{
+    /**
+     * @brief 回帰テストの条件
+     *
+     */
+    struct RegressionScenario
+    {
+        std::string Name;
+        unsigned int Seed = 1;
+        EvolutionParameters Parameters;
+        std::string LogFormat = "yaml";
+    };
+
+    /**
+     * @brief 回帰テストの結果（出力ごとのハッシュと時間）
+     *
+     */
+    struct RegressionDigest
+    {
+        std::string Name;
+        // 最終状態の LanguageMap
+        uint64_t LanguageMap = 0;
+        // 出力した CSV
+        uint64_t CSV = 0;
+        // 出力した差分ログ
+        uint64_t Log = 0;
+        // 差分ログを読み込んで再生した LanguageMap
+        uint64_t Replay = 0;
+        // 同じ差分を場所ごとに並列に再生した LanguageMap
+        uint64_t ParallelReplay = 0;
+        // 差分を圧縮してから再生した LanguageMap
+        uint64_t CompactReplay = 0;
+        // 最終状態をスナップショットに保存して読み込み直した LanguageMap
+        uint64_t Snapshot = 0;
+        // 差分ログが影響度を丸めるか（YAML 形式は有効数字 6 桁なので、再生した結果は最終状態と意図して一致しない）
+        bool IsReplayLossy = false;
+        double Seconds = 0.0;
+    };
+
+    // FNV-1a（64bit）
+    class Hasher
+    {
+    public:
+        void Add(const void *data, const size_t size)
+        {
+            const auto *bytes = static_cast<const unsigned char *>(data);
+            for (size_t i = 0; i < size; ++i)
+            {
+                value = (value ^ bytes[i]) * 0x100000001b3ull;
+            }
+        }
+        template <typename T>
+        void Add(const T &value)
+        {
+            static_assert(std::is_arithmetic_v<T>);
+            Add(&value, sizeof(T));
+        }
+        void Add(const std::string &str)
+        {
+            Add(str.size());
+            Add(str.data(), str.size());
+        }
+        void Add(const std::vector<Phonetics> &sounds)
+        {
+            Add(sounds.size());
+            for (const auto &sound : sounds)
+            {
+                Add(sound.Mannar);
+                Add(sound.Place);
+            }
+        }
+        uint64_t Value() const { return value; }
+
+    private:
+        uint64_t value = 0xcbf29ce484222325ull;
+    };
+
+    // 言語の対応表のハッシュ（場所名・影響度・単語の ID・音素列・意味・最も近い祖語の単語）
+    uint64_t hashLanguageMap(const LanguageTable &languages)
+    {
+        Hasher hasher;
+        for (const auto &[place, language] : languages)
+        {
+            hasher.Add(place);
+            hasher.Add(language.Strength);
+            hasher.Add(language.Words.size());
+            for (const auto &[id, word] : language.Words)
+            {
+                hasher.Add(id);
+                hasher.Add(word.Sounds);
+                hasher.Add(word.Meanings.size());
+                for (const auto &[key, weight] : word.Meanings)
+                {
+                    hasher.Add(key);
+                    hasher.Add(weight);
+                }
+                hasher.Add(word.NearestProtoWord);
+            }
+        }
+        return hasher.Value();
+    }
+
+    // ファイルの中身のハッシュ（読めなければ 0）
+    uint64_t hashFile(const std::string &filename)
+    {
+        std::ifstream file(filename.c_str(), std::ios::binary);
+        if (!file.is_open())
+            return 0;
+        Hasher hasher;
+        std::vector<char> buffer(1 << 16);
+        while (file.read(buffer.data(), buffer.size()) || file.gcount() > 0)
+        {
+            hasher.Add(buffer.data(), (size_t)file.gcount());
+        }
+        return hasher.Value();
+    }
+
+    std::string toHex(const uint64_t value)
+    {
+        std::ostringstream stream;
+        stream << std::hex << std::setw(16) << std::setfill('0') << value;
+        return stream.str();
+    }
+
+    RegressionDigest runScenario(const RegressionScenario &scenario, const std::string &outputDirectory)
+    {
+        RegressionDigest digest;
+        digest.Name = scenario.Name;
+        const std::string outputPath = outputDirectory + "/" + scenario.Name + ".csv";
+        const auto &p = scenario.Parameters;
+
+        // 1. シミュレーション
+        setRandomSeed(scenario.Seed);
+        const auto start = std::chrono::steady_clock::now();
+        const auto result = evolution(
+            p.NBorrow, p.PSoundChange, p.PSoundLoss, p.PSemanticShift, p.MaxSemanticShiftRate, p.PWordLoss, p.PWordBirth,
+            "OldTokiPona.csv", "Phonetics.csv", "Map.csv", outputPath, "", 0, scenario.LogFormat);
+        digest.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!result)
+            return digest;
+        digest.LanguageMap = hashLanguageMap(result->LanguageMap);
+        digest.CSV = hashFile(outputPath);
+        digest.Log = hashFile(outputPath + ".log");
+
+        // 2. 差分ログの再生（順に・並列に・圧縮してから）
+        digest.IsReplayLossy = scenario.LogFormat != "binary";
+        LanguageSystem replay;
+        replay.Import(outputPath + ".log");
+        replay.ApplyDifferences(replay.languageDifference);
+        digest.Replay = hashLanguageMap(replay.LanguageMap);
+        LanguageSystem parallelReplay;
+        parallelReplay.Import(outputPath + ".log");
+        // 1コアの環境でも並列の経路を通すように、スレッド数を固定する
+        parallelReplay.ApplyDifferences(parallelReplay.languageDifference, 4);
+        digest.ParallelReplay = hashLanguageMap(parallelReplay.LanguageMap);
+        LanguageSystem compactReplay;
+        compactReplay.Import(outputPath + ".log");
+        compactReplay.CompactDifferences();
+        compactReplay.ApplyDifferences(compactReplay.languageDifference);
+        digest.CompactReplay = hashLanguageMap(compactReplay.LanguageMap);
+
+        // 3. スナップショットの保存と読み込み
+        LanguageSystem snapshot;
+        if (result->SaveSnapshot(outputPath + ".snapshot") && snapshot.LoadSnapshot(outputPath + ".snapshot"))
+            digest.Snapshot = hashLanguageMap(snapshot.LanguageMap);
+        return digest;
+    }
+
+    // 同じ結果になるはずのハッシュの食い違い（空なら一致）
+    std::string getInconsistencies(const RegressionDigest &digest)
+    {
+        std::string inconsistencies;
+        if (digest.ParallelReplay != digest.Replay)
+            inconsistencies += " parallel_replay!=replay";
+        if (digest.CompactReplay != digest.Replay)
+            inconsistencies += " compact_replay!=replay";
+        if (digest.Snapshot != digest.LanguageMap)
+            inconsistencies += " snapshot!=language_map";
+        if (!digest.IsReplayLossy && digest.Replay != digest.LanguageMap)
+            inconsistencies += " replay!=language_map";
+        return inconsistencies;
+    }
+
+    // 語源の最初の差分（言語の複写は複写元をたどる）
+    const LanguageDifference *etymologyRoot(const Etymology &etymology)
+    {
+        if (etymology.Steps.empty())
+            return nullptr;
+        const auto &first = etymology.Steps.front();
+        if (first.Difference.Type == LanguageDifferenceType::CopyLanguage)
+            return first.Sources.empty() ? nullptr : etymologyRoot(first.Sources.front());
+        return &first.Difference;
+    }
+
+    // 借用された単語の語源をたどると、祖語を置いた場所の単語追加（または複合語の追加）に行き着くか
+    bool checkEtymology(const std::string &logPath, std::string &message)
+    {
+        auto log = std::make_shared<BinaryDifferenceLog>();
+        if (!log->Open(logPath))
+        {
+            message = "差分ログを開けません";
+            return false;
+        }
+        const int origin = log->Graph.FindPlace("0");
+        std::set<std::pair<int, int>> borrowed;
+        log->ForEachRecord([&](const DifferenceRecordView &view)
+                           {
+                               const auto diff = view.ToDifference();
+                               if (diff && diff->Type == LanguageDifferenceType::BorrowWord)
+                                   borrowed.emplace(diff->Place, diff->WordID); });
+        const auto index = EtymologyIndex::Build(log);
+        if (!index)
+        {
+            message = "索引を作れません";
+            return false;
+        }
+
+        size_t nAddWord = 0;
+        for (const auto &[place, wordID] : borrowed)
+        {
+            const auto etymology = index->Query(place, wordID);
+            if (!etymology)
+            {
+                message = "語源がありません: " + log->Graph.Places[place] + " " + std::to_string(wordID);
+                return false;
+            }
+            // 今の音素列を作った借用（後の言語の複写で語彙ごと置き換えられていればない）
+            auto step = std::find_if(etymology->Steps.rbegin(), etymology->Steps.rend(), [](const EtymologyStep &s)
+                                     { return s.Difference.Type == LanguageDifferenceType::BorrowWord; });
+            if (step == etymology->Steps.rend())
+                continue;
+            const auto &diff = step->Difference;
+            const LanguageDifference *root = step->Sources.size() == 1 ? etymologyRoot(step->Sources[0]) : nullptr;
+            const bool isValid = step->Sources.size() == 1 &&
+                                 step->Sources[0].Place == diff.Source.Place && step->Sources[0].WordID == diff.Source.WordID &&
+                                 root != nullptr &&
+                                 ((root->Type == LanguageDifferenceType::AddWord && root->Place == origin) ||
+                                  root->Type == LanguageDifferenceType::AddCompoundWord);
+            if (!isValid)
+            {
+                message = "借用元の語源が単語の追加に行き着きません: " + log->Graph.Places[place] + " " + std::to_string(wordID);
+                return false;
+            }
+            if (root->Type == LanguageDifferenceType::AddWord)
+                nAddWord++;
+        }
+        if (nAddWord == 0)
+        {
+            message = "祖語の単語を借用した単語がありません";
+            return false;
+        }
+        message = std::to_string(nAddWord) + " 語";
+        return true;
+    }
+
+    // 列形式の単語が語彙と同じか（単語ID・音素列・意味と重み）
+    bool isSameWords(const ColumnarResult &columns, const ColumnarWords &words, const Vocabulary &vocabulary)
+    {
+        if (words.Size() != vocabulary.size())
+            return false;
+        size_t i = 0;
+        for (const auto &[id, word] : vocabulary)
+        {
+            const auto sounds = words.Sounds(i);
+            const auto keys = words.MeaningKeys(i);
+            const auto weights = words.MeaningWeights(i);
+            if (words.IDs[i] != id || !std::equal(sounds.begin(), sounds.end(), word.Sounds.begin(), word.Sounds.end()) ||
+                keys.size() != word.Meanings.size())
+                return false;
+            size_t m = 0;
+            for (const auto &[key, weight] : word.Meanings)
+            {
+                if (columns.String(keys[m]) != key || weights[m] != weight)
+                    return false;
+                m++;
+            }
+            i++;
+        }
+        return true;
+    }
+
+    // 差分ログを再生した語族を列形式で書き出し、読み込み直して元と比べる
+    bool checkColumnar(const std::string &logPath, const std::string &columnarPath, std::string &message)
+    {
+        LanguageSystem system;
+        system.Import(logPath);
+        system.ApplyDifferences(system.languageDifference);
+        ColumnarResult columns;
+        if (!system.ExportColumnar(columnarPath) || !columns.Open(columnarPath))
+        {
+            message = "書き出し・読み込みに失敗しました";
+            return false;
+        }
+        if (columns.PlaceCount() != system.Graph.Places.size() || columns.LanguageCount() != system.LanguageMap.size() ||
+            !isSameWords(columns, columns.ProtoWords(), system.ProtoLanguage.Words))
+        {
+            message = "場所・言語の数か祖語が違います";
+            return false;
+        }
+        size_t i = 0;
+        for (const auto &[place, language] : system.LanguageMap)
+        {
+            if (columns.Place(columns.LanguagePlaces()[i]) != place || columns.LanguageStrengths()[i] != language.Strength ||
+                !isSameWords(columns, columns.LanguageWords(i), language.Words))
+            {
+                message = "言語が違います: " + place;
+                return false;
+            }
+            i++;
+        }
+        message = std::to_string(columns.Words().Size()) + " 語";
+        return true;
+    }
+
+    // 4つの場所で、言語の広がりと同じ形に推定した木の距離が 0、違う形なら 0 でないか
+    bool checkPhylogeny(std::string &message)
+    {
+        // A から B・C に広がり、B から D に広がる（正しい分割は {A, C} | {B, D}）
+        const std::vector<std::string> places = {"A", "B", "C", "D"};
+        const std::vector<LanguageDifference> diffs = {
+            LanguageDifference::CreateAddWord(0, 0, 0, "a"),
+            LanguageDifference::CreateCopyLanguage(0, 1, 1),
+            LanguageDifference::CreateCopyLanguage(0, 2, 2),
+            LanguageDifference::CreateCopyLanguage(1, 3, 3),
+        };
+        const auto truth = buildSpreadTree(diffs, places);
+        auto score = [&](const double ab, const double ac, const double ad, const double bc, const double bd, const double cd)
+        {
+            DistanceMatrix distances;
+            distances.Places = places;
+            distances.Values = {
+                0.0, ab, ac, ad,
+                ab, 0.0, bc, bd,
+                ac, bc, 0.0, cd,
+                ad, bd, cd, 0.0};
+            return compareTrees(buildNeighborJoiningTree(distances), truth);
+        };
+        const auto same = score(0.6, 0.2, 0.6, 0.6, 0.2, 0.6);
+        const auto different = score(0.2, 0.6, 0.6, 0.6, 0.6, 0.2);
+        message = "RF " + std::to_string(same.RobinsonFoulds) + " / " + std::to_string(different.RobinsonFoulds);
+        return same.CommonLeaves == 4 && same.TrueSplits == 1 && same.RobinsonFoulds == 0 && different.RobinsonFoulds == 2;
+    }
+
+    std::vector<RegressionDigest> readDigests(const std::string &filename)
+    {
+        std::vector<RegressionDigest> digests;
+        const auto rows = readCSV(filename);
+        for (size_t i = 1; i < rows.size(); ++i)
+        {
+            const auto &row = rows[i];
+            if (row.size() < 10)
+                continue;
+            RegressionDigest digest;
+            digest.Name = row[0];
+            digest.LanguageMap = std::stoull(row[1], nullptr, 16);
+            digest.CSV = std::stoull(row[2], nullptr, 16);
+            digest.Log = std::stoull(row[3], nullptr, 16);
+            digest.Replay = std::stoull(row[4], nullptr, 16);
+            digest.ParallelReplay = std::stoull(row[5], nullptr, 16);
+            digest.CompactReplay = std::stoull(row[6], nullptr, 16);
+            digest.Snapshot = std::stoull(row[7], nullptr, 16);
+            digest.IsReplayLossy = row[8] == "1";
+            digest.Seconds = std::stod(row[9]);
+            digests.push_back(digest);
+        }
+        return digests;
+    }
+
+    bool writeDigests(const std::string &filename, const std::vector<RegressionDigest> &digests)
+    {
+        std::vector<std::vector<std::string>> rows = {
+            {"scenario", "language_map", "csv", "log", "replay", "parallel_replay", "compact_replay", "snapshot", "replay_lossy", "seconds"}};
+        for (const auto &digest : digests)
+        {
+            std::ostringstream seconds;
+            seconds << std::fixed << std::setprecision(3) << digest.Seconds;
+            rows.push_back({digest.Name, toHex(digest.LanguageMap), toHex(digest.CSV), toHex(digest.Log), toHex(digest.Replay),
+                            toHex(digest.ParallelReplay), toHex(digest.CompactReplay), toHex(digest.Snapshot),
+                            digest.IsReplayLossy ? "1" : "0", seconds.str()});
+        }
+        return writeCSV(filename, rows);
+    }
+}
+
+/**
+ * @brief 固定したシードでシミュレーションと再生を行い、出力のハッシュを基準と比べる
+ *
+ * @note 引数: [--update] [遅くなったとみなす倍率（既定 1.5）]
+ * @note --update のときは基準（Regression.csv）を書き換える。
+ * @note ハッシュが1つでも違えば 1 を返す。時間が基準の倍率を超えた条件は SLOW と表示する（失敗にはしない）。
+ * @note 同じ結果になるはずのハッシュ（再生の方法どうし、スナップショットと最終状態、丸めのない差分ログの再生と最終状態）が違えば、基準によらず失敗にする。
+ * @note そのあと、ハッシュでは確かめられない機能（語源の索引など）を出力のログで検査する。1つでも失敗すれば 1 を返す。
+ */
+int main(int argc, char *argv[])
+{
+    const std::string goldenPath = "Regression.csv";
+    const std::string outputDirectory = "ignore/regression";
+    bool isUpdate = false;
+    double slowdown = 1.5;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--update")
+            isUpdate = true;
+        else
+            slowdown = std::stod(arg);
+    }
+    std::filesystem::create_directories(outputDirectory);
+
+    // test.cpp と同じパラメータの組を、シードを変えて回す
+    const std::vector<std::pair<std::string, EvolutionParameters>> parameterSets = {
+        {"Base", {1, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0}},
+        {"ChangeSound", {1, 0.1, 0.1, 0.0, 0.0, 0.0, 0.0}},
+        {"ChangeSoundNoRemove", {1, 0.1, 0.0, 0.0, 0.0, 0.0, 0.0}},
+        {"ChangeSoundRemove", {1, 0.1, 1.0, 0.0, 0.0, 0.0, 0.0}},
+        {"ChangeMeaning", {1, 0.0, 0.0, 0.1, 0.1, 0.0, 0.0}},
+        {"RemoveWord", {1, 0.0, 0.0, 0.0, 0.0, 0.1, 0.0}},
+        {"CreateWord", {1, 0.0, 0.0, 0.0, 0.0, 0.0, 0.1}},
+        {"ChangeMeaningAndWordNum", {1, 0.0, 0.0, 0.1, 0.1, 0.1, 0.1}},
+        {"All", {3, 0.3, 0.3, 0.2, 0.2, 0.02, 0.05}},
+    };
+    std::vector<RegressionScenario> scenarios;
+    for (const unsigned int seed : {1u, 2u})
+    {
+        for (const auto &[name, parameters] : parameterSets)
+        {
+            scenarios.push_back({name + "_" + std::to_string(seed), seed, parameters});
+        }
+    }
+    scenarios.push_back({"AllBinaryLog_1", 1, parameterSets.back().second, "binary"});
+
+    std::unordered_map<std::string, RegressionDigest> golden;
+    if (!isUpdate)
+    {
+        for (const auto &digest : readDigests(goldenPath))
+        {
+            golden.emplace(digest.Name, digest);
+        }
+    }
+
+    std::vector<RegressionDigest> digests;
+    int failures = 0;
+    for (const auto &scenario : scenarios)
+    {
+        const auto digest = runScenario(scenario, outputDirectory);
+        digests.push_back(digest);
+        std::cout << std::left << std::setw(28) << digest.Name << std::right << std::fixed << std::setprecision(3) << std::setw(8) << digest.Seconds << "s";
+        const auto inconsistencies = getInconsistencies(digest);
+        if (!inconsistencies.empty())
+        {
+            std::cout << "  INCONSISTENT:" << inconsistencies << "\n";
+            failures++;
+            continue;
+        }
+        if (isUpdate)
+        {
+            std::cout << "\n";
+            continue;
+        }
+        auto it = golden.find(scenario.Name);
+        if (it == golden.end())
+        {
+            std::cout << "  NEW\n";
+            failures++;
+            continue;
+        }
+        const auto &expected = it->second;
+        std::string mismatches;
+        if (digest.LanguageMap != expected.LanguageMap)
+            mismatches += " language_map";
+        if (digest.CSV != expected.CSV)
+            mismatches += " csv";
+        if (digest.Log != expected.Log)
+            mismatches += " log";
+        if (digest.Replay != expected.Replay)
+            mismatches += " replay";
+        if (digest.ParallelReplay != expected.ParallelReplay)
+            mismatches += " parallel_replay";
+        if (digest.CompactReplay != expected.CompactReplay)
+            mismatches += " compact_replay";
+        if (digest.Snapshot != expected.Snapshot)
+            mismatches += " snapshot";
+        if (!mismatches.empty())
+        {
+            std::cout << "  FAIL:" << mismatches;
+            failures++;
+        }
+        else
+        {
+            std::cout << "  OK";
+        }
+        // 短い条件の揺らぎで警告しないよう、0.05 秒未満の差は無視する
+        if (expected.Seconds > 0.0 && digest.Seconds > expected.Seconds * slowdown && digest.Seconds - expected.Seconds > 0.05)
+            std::cout << "  SLOW (" << std::setprecision(2) << digest.Seconds / expected.Seconds << "x)";
+        std::cout << "\n";
+    }
+
+    // ハッシュでは確かめられない機能の検査
+    const std::string binaryLogPath = outputDirectory + "/AllBinaryLog_1.csv.log";
+    const std::vector<std::pair<std::string, std::function<bool(std::string &)>>> checks = {
+        {"Etymology", [&](std::string &message)
+         { return checkEtymology(binaryLogPath, message); }},
+        {"Columnar", [&](std::string &message)
+         { return checkColumnar(binaryLogPath, outputDirectory + "/Columnar.cols", message); }},
+        {"Phylogeny", [&](std::string &message)
+         { return checkPhylogeny(message); }},
+    };
+    for (const auto &[name, check] : checks)
+    {
+        std::string message;
+        const bool isPassed = check(message);
+        std::cout << std::left << std::setw(37) << name << std::right << (isPassed ? "  OK" : "  FAIL");
+        if (!message.empty())
+            std::cout << ": " << message;
+        std::cout << "\n";
+        if (!isPassed)
+            failures++;
+    }
+
+    // 食い違いや検査の失敗がある結果は基準にしない
+    if (isUpdate)
+        return failures == 0 && writeDigests(goldenPath, digests) ? 0 : 1;
+    std::cout << (failures == 0 ? "すべて一致しました" : std::to_string(failures) + " 件が基準と一致しません") << "\n";
+    return failures == 0 ? 0 : 1;
+}
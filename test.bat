@@ -5,7 +5,7 @@ pushd "%~dp0"
 
 del /q "ignore\test_data\*"
 
-g++ -o ignore/a Utility.cpp Random.cpp Language.cpp test.cpp -std=c++2a
+g++ -o ignore/a Utility.cpp Random.cpp Geography.cpp Binary.cpp Language.cpp Snapshot.cpp DifferenceLog.cpp Replay.cpp Compaction.cpp Etymology.cpp Columnar.cpp Distance.cpp Phylogeny.cpp Profile.cpp Arena.cpp test.cpp -std=c++2a -pthread
 
 call time.bat START
 start /wait "" ignore/a.exe